@@ -0,0 +1,62 @@
+//=============================================================================================
+// Átlátszósági kulcs benchmark: az eredeti float-os ciklus és a vektorizált kernel összevetése
+//
+// Futtatás: make bench && out/bench_alpha_key [oldalhossz pixelben]
+//=============================================================================================
+#include "pixelkernels.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double msSince(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// A Texture konstruktor korábbi változata
+static void alphaFromLuminanceFloat(unsigned char* pixels, unsigned int width, unsigned int height) {
+	for (unsigned int y = 0; y < height; ++y) {
+		for (unsigned int x = 0; x < width; ++x) {
+			float sum = 0;
+			for (int c = 0; c < 3; ++c) {
+				sum += pixels[4 * (x + y * width) + c];
+			}
+			pixels[4 * (x + y * width) + 3] = sum / 6;
+		}
+	}
+}
+
+int main(int argc, char* argv[]) {
+	unsigned int side = argc > 1 ? atoi(argv[1]) : 4096;
+	size_t count = (size_t)side * side;
+	std::vector<unsigned char> source(count * 4);
+	srand(1);
+	for (unsigned char& b : source) b = rand() & 0xFF;
+
+	const int runs = 5;
+	double best[3] = { 1e30, 1e30, 1e30 };
+	std::vector<unsigned char> results[3];
+	for (int run = 0; run < runs; run++) {
+		for (int variant = 0; variant < 3; variant++) {
+			std::vector<unsigned char> image = source;
+			Clock::time_point start = Clock::now();
+			switch (variant) {
+			case 0: alphaFromLuminanceFloat(image.data(), side, side); break;
+			case 1: alphaFromLuminanceScalar(image.data(), count); break;
+			case 2: alphaFromLuminance(image.data(), count); break;
+			}
+			double ms = msSince(start);
+			if (ms < best[variant]) best[variant] = ms;
+			results[variant] = std::move(image);
+		}
+	}
+	bool same = results[0] == results[1] && results[0] == results[2];
+	printf("%ux%u RGBA, best of %d\n", side, side, runs);
+	printf("  float loop   %8.2f ms\n", best[0]);
+	printf("  scalar int   %8.2f ms\n", best[1]);
+	printf("  simd         %8.2f ms  (%.1fx, %.2f GB/s)\n", best[2], best[0] / best[2], count * 4 / best[2] / 1e6);
+	printf("  results %s\n", same ? "identical" : "DIFFER");
+	return same ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+//=============================================================================================
+// CRC-32 benchmark: a PNG chunkok ellenőrző összege hardveres (PCLMULQDQ / ARMv8 CRC32) és táblás változattal
+//
+// Futtatás: make bench && out/bench_crc32
+// Különböző puffer méreteken (a kis chunkoktól a nagy IDAT-okig) méri az átviteli sebességet (GB/s),
+// és minden méretre összeveti a két változat eredményét.
+//=============================================================================================
+#include "lodepng.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// Legalább 256 MB feldolgozása, a legjobb futás ideje egy hívásra (ns)
+static double measure(const std::vector<unsigned char>& data, size_t size, unsigned& crc) {
+	size_t calls = (256u << 20) / size + 1;
+	double best = 1e30;
+	for (int run = 0; run < 3; run++) {
+		unsigned sum = 0;
+		Clock::time_point start = Clock::now();
+		for (size_t i = 0; i < calls; i++) sum ^= lodepng_crc32(data.data() + (i & 7), size);
+		double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / calls;
+		if (ns < best) best = ns;
+		crc = sum;
+	}
+	return best;
+}
+
+int main() {
+	const size_t sizes[] = { 13, 64, 1024, 8192, 65536, 1 << 20, 8 << 20 };
+	std::vector<unsigned char> data((8 << 20) + 8);
+	srand(3);
+	for (unsigned char& c : data) c = (unsigned char)rand();
+	bool ok = true;
+	printf("CPU features: 0x%x\n", lodepng_cpu_features());
+	for (size_t size : sizes) {
+		unsigned fast, table;
+		unsigned mask = lodepng_cpu_feature_mask;
+		double fastNs = measure(data, size, fast);
+		lodepng_cpu_feature_mask = 0;
+		double tableNs = measure(data, size, table);
+		lodepng_cpu_feature_mask = mask;
+		printf("  %9zu bytes %7.2f GB/s  table %6.2f GB/s  %.2fx  %s\n", size, size / fastNs, size / tableNs,
+			tableNs / fastNs, fast == table ? "" : "MISMATCH");
+		ok = ok && fast == table;
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+//=============================================================================================
+// PNG kódolás benchmark: a szűrőválasztás ideje stratégiánként, SIMD és hordozható kóddal
+//
+// Futtatás: make bench && out/bench_png_encode [képek...]
+// A tömörítés tárolt (btype 0) blokkokkal fut, így a mért idő nagyrészt a szűrés és a pontozás.
+// Fájlok nélkül szintetikus, fotószerű 2048x2048-as RGB és RGBA képeket használ. A sebesség a nyers
+// képre vonatkozik (MB/s), és a két változat kimenetének bájtra azonosnak kell lennie. Végül a szálankénti
+// sávokra bontott szűrőválasztást méri az összes hardver szálon, szintén az egyszálú kimenettel összevetve,
+// majd a teljes kódolást valódi tömörítéssel, párhuzamos deflate blokkokkal (itt a méret kissé nőhet), végül
+// a tömörítési szinteket (0: az egyedi beállítások, 1: mohó, egyetlen hash próbás út, ..., 9); az 1-9. szintek
+// kimenete szintről szintre kisebb, a 9. szinté a 0.-nál is, különben a benchmark hibával tér vissza.
+//=============================================================================================
+#include "lodepng.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double msSince(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static std::vector<unsigned char> syntheticImage(unsigned width, unsigned height, unsigned channels) {
+	std::vector<unsigned char> image((size_t)width * height * channels);
+	srand(7);
+	for (unsigned y = 0; y < height; y++) {
+		for (unsigned x = 0; x < width; x++) {
+			for (unsigned c = 0; c < channels; c++) {
+				float v = 127 + 60 * sinf(x * 0.011f + c) + 50 * cosf(y * 0.017f - c * 0.5f) + (rand() % 9 - 4);
+				if (c == 3) v = 255 - (x + y) / 32 % 64;
+				image[((size_t)y * width + x) * channels + c] = (unsigned char)(v < 0 ? 0 : v > 255 ? 255 : v);
+			}
+		}
+	}
+	return image;
+}
+
+struct Result {
+	double ms = 1e30;
+	std::vector<unsigned char> png;
+};
+
+static Result encode(const std::vector<unsigned char>& image, unsigned width, unsigned height, LodePNGColorType colorType,
+	LodePNGFilterStrategy strategy, int runs, unsigned threads = 1, unsigned btype = 0, unsigned level = LCL_DEFAULT) {
+	Result result;
+	for (int run = 0; run < runs; run++) {
+		lodepng::State state;
+		state.info_raw.colortype = colorType;
+		state.info_png.color.colortype = colorType;
+		state.encoder.auto_convert = 0;
+		state.encoder.filter_palette_zero = 0;
+		state.encoder.filter_strategy = strategy;
+		state.encoder.zlibsettings.btype = btype;
+		state.encoder.num_threads = threads;
+		state.encoder.zlibsettings.level = level;
+		std::vector<unsigned char> png;
+		Clock::time_point start = Clock::now();
+		unsigned error = lodepng::encode(png, image, width, height, state);
+		double ms = msSince(start);
+		if (error) {
+			printf("encode error %u: %s\n", error, lodepng_error_text(error));
+			return result;
+		}
+		if (ms < result.ms) result.ms = ms;
+		result.png.swap(png);
+	}
+	return result;
+}
+
+// Egy kép kódolása SIMD-del és anélkül; false, ha a kimenetek eltérnek
+static bool compare(const char* name, const std::vector<unsigned char>& image, unsigned width, unsigned height,
+	LodePNGColorType colorType, LodePNGFilterStrategy strategy, int runs) {
+	unsigned mask = lodepng_cpu_feature_mask;
+	Result simd = encode(image, width, height, colorType, strategy, runs);
+	lodepng_cpu_feature_mask = 0;
+	Result scalar = encode(image, width, height, colorType, strategy, runs);
+	lodepng_cpu_feature_mask = mask;
+	double mb = image.size() / 1e6;
+	bool same = simd.png == scalar.png;
+	printf("  %-28s %7.1f MB/s  scalar %7.1f MB/s  %.2fx  %s\n", name, mb / (simd.ms / 1000), mb / (scalar.ms / 1000),
+		scalar.ms / simd.ms, same ? "" : "MISMATCH");
+	return same;
+}
+
+int main(int argc, char* argv[]) {
+	const int runs = 3;
+	const LodePNGFilterStrategy strategies[3] = { LFS_MINSUM, LFS_ENTROPY, LFS_BRUTE_FORCE };
+	const char* strategyNames[3] = { "minsum", "entropy", "brute force" };
+	bool ok = true;
+	printf("CPU features: 0x%x, best of %d\n", lodepng_cpu_features(), runs);
+	if (argc > 1) {
+		for (int i = 1; i < argc; i++) {
+			std::vector<unsigned char> image;
+			unsigned width, height;
+			if (lodepng::decode(image, width, height, argv[i])) {
+				printf("cannot read %s\n", argv[i]);
+				continue;
+			}
+			printf("%s\n", argv[i]);
+			for (int s = 0; s < 2; s++) ok = compare(strategyNames[s], image, width, height, LCT_RGBA, strategies[s], runs) && ok;
+		}
+		return ok ? 0 : 1;
+	}
+
+	const unsigned size = 2048;
+	for (unsigned channels = 3; channels <= 4; channels++) {
+		LodePNGColorType colorType = channels == 4 ? LCT_RGBA : LCT_RGB;
+		std::vector<unsigned char> image = syntheticImage(size, size, channels);
+		printf("%ux%u %s\n", size, size, channels == 4 ? "RGBA" : "RGB");
+		for (int s = 0; s < 2; s++) ok = compare(strategyNames[s], image, size, size, colorType, strategies[s], runs) && ok;
+	}
+	// A brute force minden sorra öt teljes tömörítést futtat, ezért kisebb képen
+	std::vector<unsigned char> image = syntheticImage(256, 256, 4);
+	printf("256x256 RGBA\n");
+	ok = compare(strategyNames[2], image, 256, 256, LCT_RGBA, strategies[2], 1) && ok;
+
+	printf("threads (all hardware threads vs 1)\n");
+	for (int s = 0; s < 3; s++) {
+		unsigned n = s == 2 ? 256 : size;
+		std::vector<unsigned char> rgba = syntheticImage(n, n, 4);
+		Result parallel = encode(rgba, n, n, LCT_RGBA, strategies[s], 1, 0);
+		Result serial = encode(rgba, n, n, LCT_RGBA, strategies[s], 1, 1);
+		bool same = parallel.png == serial.png;
+		printf("  %-28s %8.1f ms  serial %8.1f ms  %.2fx  %s\n", strategyNames[s], parallel.ms, serial.ms,
+			serial.ms / parallel.ms, same ? "" : "MISMATCH");
+		ok = same && ok;
+	}
+
+	printf("full encode, dynamic deflate (all hardware threads vs 1)\n");
+	{
+		std::vector<unsigned char> rgba = syntheticImage(size, size, 4);
+		Result parallel = encode(rgba, size, size, LCT_RGBA, LFS_MINSUM, 1, 0, 2);
+		Result serial = encode(rgba, size, size, LCT_RGBA, LFS_MINSUM, 1, 1, 2);
+		std::vector<unsigned char> decoded;
+		unsigned w, h;
+		bool same = !lodepng::decode(decoded, w, h, parallel.png) && decoded == rgba;
+		printf("  %-28s %8.1f ms  serial %8.1f ms  %.2fx  %zu / %zu bytes  %s\n", "minsum", parallel.ms, serial.ms,
+			serial.ms / parallel.ms, parallel.png.size(), serial.png.size(), same ? "" : "MISMATCH");
+		ok = same && ok;
+	}
+
+	// Az 1-9. szinteken a méretnek szintről szintre csökkennie kell, és a 9. szintnek a 0.-nál is kisebbnek
+	printf("compression levels, 1 thread\n");
+	{
+		std::vector<unsigned char> rgba = syntheticImage(size, size, 4);
+		size_t custom = 0, previous = 0;
+		for (unsigned level = 0; level <= 9; level++) {
+			Result result = encode(rgba, size, size, LCT_RGBA, LFS_MINSUM, 1, 1, 2, level);
+			std::vector<unsigned char> decoded;
+			unsigned w, h;
+			bool same = !lodepng::decode(decoded, w, h, result.png) && decoded == rgba;
+			bool smaller = level < 2 || result.png.size() < previous;
+			if (level == 9 && result.png.size() >= custom) smaller = false;
+			printf("  level %u %20.1f ms  %7.1f MB/s  %9zu bytes  %s%s\n", level, result.ms, rgba.size() / 1e3 / result.ms,
+				result.png.size(), same ? "" : "MISMATCH", smaller ? "" : "NOT SMALLER");
+			if (level == 0) custom = result.png.size();
+			previous = result.png.size();
+			ok = same && smaller && ok;
+		}
+	}
+	return ok ? 0 : 1;
+}
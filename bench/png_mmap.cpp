@@ -0,0 +1,128 @@
+//=============================================================================================
+// PNG fájl dekódolás benchmark: memóriába leképezett (mmap) fájl és helyben kitömörített IDAT adat
+//
+// Futtatás: make bench && out/bench_png_mmap [képek...]
+// Három utat mér ugyanazon a fájlon: a régit (a fájl beolvasása pufferbe, majd az IDAT darabok összemásolása
+// egy pufferbe a kitömörítés előtt, ezt az egyedi zlib függvénnyel kényszeríti ki), a beolvasott fájl helyben
+// kitömörítését, és a lodepng_decode_file_mapped-et, amely leképezi a fájlt és a lapokból tömörít ki. A három kimenetnek
+// egyeznie kell. Fájlok nélkül szintetikus, fotószerű 4096x4096-os RGBA képet ír ideiglenes fájlba, 8K-s (a libpng
+// alapértelmezése), 64K-s és egyetlen IDAT darabbal. Az idő a fájl megnyitásától a kész képig tart (ms).
+//=============================================================================================
+#include "lodepng.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double msSince(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static std::vector<unsigned char> syntheticImage(unsigned width, unsigned height) {
+	std::vector<unsigned char> image((size_t)width * height * 4);
+	srand(7);
+	for (unsigned y = 0; y < height; y++) {
+		for (unsigned x = 0; x < width; x++) {
+			for (unsigned c = 0; c < 4; c++) {
+				float v = 127 + 60 * sinf(x * 0.011f + c) + 50 * cosf(y * 0.017f - c * 0.5f) + (rand() % 9 - 4);
+				if (c == 3) v = 255 - (x + y) / 32 % 64;
+				image[((size_t)y * width + x) * 4 + c] = (unsigned char)(v < 0 ? 0 : v > 255 ? 255 : v);
+			}
+		}
+	}
+	return image;
+}
+
+static unsigned writeFile(void* context, const unsigned char* data, size_t size) {
+	return lodepng_write_file(context, data, size);
+}
+
+enum Path { GATHER, IN_PLACE, MAPPED };
+
+// Egy dekódolás a megadott úton; a hibakód, az idő ms-ban
+static unsigned decode(const char* path, Path how, std::vector<unsigned char>& image, double& ms) {
+	unsigned char* pixels = nullptr;
+	unsigned w = 0, h = 0, error = 0;
+	Clock::time_point start = Clock::now();
+	if (how == MAPPED) {
+		error = lodepng_decode_file_mapped(&pixels, &w, &h, path, LCT_RGBA, 8);
+	} else {
+		unsigned char* file = nullptr;
+		size_t size = 0;
+		error = lodepng_load_file(&file, &size, path);
+		if (!error) {
+			lodepng::State state;
+			// az egyedi zlib függvény az összemásolt IDAT adatot kapja, ahogy korábban minden dekódolás
+			if (how == GATHER) state.decoder.zlibsettings.custom_zlib = lodepng_zlib_decompress;
+			error = lodepng_decode(&pixels, &w, &h, &state, file, size);
+		}
+		free(file);
+	}
+	ms = msSince(start);
+	image.assign(pixels, pixels + (error ? 0 : (size_t)w * h * 4));
+	free(pixels);
+	return error;
+}
+
+// Egy fájl a három úton; false, ha az eredmények eltérnek
+static bool compare(const char* name, const char* path, int runs) {
+	const char* pathNames[3] = { "read + gather", "read + in place", "mmap + in place" };
+	double best[3] = { 1e30, 1e30, 1e30 };
+	std::vector<unsigned char> images[3];
+	for (int run = 0; run < runs; run++) {
+		for (int how = 0; how < 3; how++) {
+			double ms;
+			unsigned error = decode(path, (Path)how, images[how], ms);
+			if (error) {
+				printf("  %-28s %s error %u: %s\n", name, pathNames[how], error, lodepng_error_text(error));
+				return false;
+			}
+			if (ms < best[how]) best[how] = ms;
+		}
+	}
+	bool same = images[0] == images[1] && images[0] == images[2];
+	printf("  %-28s gather %7.1f ms  in place %7.1f ms  mmap %7.1f ms  %.2fx  %s\n", name, best[0], best[1], best[2],
+		best[0] / best[2], same ? "" : "MISMATCH");
+	return same;
+}
+
+int main(int argc, char* argv[]) {
+	const int runs = 5;
+	bool ok = true;
+	printf("RGBA output, best of %d\n", runs);
+	if (argc > 1) {
+		for (int i = 1; i < argc; i++) ok = compare(argv[i], argv[i], runs) && ok;
+		return ok ? 0 : 1;
+	}
+
+	const unsigned size = 4096;
+	std::vector<unsigned char> image = syntheticImage(size, size);
+	std::string path = "bench_png_mmap.tmp.png";
+	printf("%ux%u RGBA\n", size, size);
+	const size_t idatSizes[3] = { 8192, 65536, 2147483647 };
+	const char* idatNames[3] = { "8K IDAT chunks", "64K IDAT chunks", "one IDAT chunk" };
+	for (int i = 0; i < 3; i++) {
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file) {
+			printf("cannot write %s\n", path.c_str());
+			return 1;
+		}
+		lodepng::StreamEncoder encoder(size, size, writeFile, file);
+		encoder.idat_size = idatSizes[i];
+		encoder.state.encoder.zlibsettings.level = LCL_FAST; // a kódolás gyors legyen, a dekódolást mérjük
+		unsigned error = encoder.push(image.data(), size);
+		if (!error) error = encoder.finish();
+		fclose(file);
+		if (error) {
+			printf("encode error %u: %s\n", error, lodepng_error_text(error));
+			return 1;
+		}
+		ok = compare(idatNames[i], path.c_str(), runs) && ok;
+	}
+	remove(path.c_str());
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+//=============================================================================================
+// Soronkénti (streaming) PNG kódolás benchmark: a teljes kódolással összevetve
+//
+// Futtatás: make bench && out/bench_png_stream_encode [képek...]
+// A kódolónak 16 soronként adja a képet, ahogy egy renderelő vagy képfeldolgozó lánc előállítaná, a kész PNG
+// darabokat pedig egy vektorba gyűjti. Az IDAT darabok mérete itt a lehető legnagyobb, így a kimenetnek bájtra
+// egyeznie kell a teljes kódolás (lodepng::encode, egy szálon, auto_convert nélkül) kimenetével. Fájlok nélkül
+// szintetikus, fotószerű 4096x4096-os RGBA képet használ, sima és Adam7 váltottsoros változatban, a gyors és az
+// alapértelmezett tömörítési szinttel. A sebesség a nyers képre vonatkozik (MB/s).
+//=============================================================================================
+#include "lodepng.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double msSince(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static std::vector<unsigned char> syntheticImage(unsigned width, unsigned height) {
+	std::vector<unsigned char> image((size_t)width * height * 4);
+	srand(7);
+	for (unsigned y = 0; y < height; y++) {
+		for (unsigned x = 0; x < width; x++) {
+			for (unsigned c = 0; c < 4; c++) {
+				float v = 127 + 60 * sinf(x * 0.011f + c) + 50 * cosf(y * 0.017f - c * 0.5f) + (rand() % 9 - 4);
+				if (c == 3) v = 255 - (x + y) / 32 % 64;
+				image[((size_t)y * width + x) * 4 + c] = (unsigned char)(v < 0 ? 0 : v > 255 ? 255 : v);
+			}
+		}
+	}
+	return image;
+}
+
+static unsigned collect(void* context, const unsigned char* data, size_t size) {
+	std::vector<unsigned char>* png = (std::vector<unsigned char>*)context;
+	png->insert(png->end(), data, data + size);
+	return 0;
+}
+
+static void setup(LodePNGState& state, unsigned interlace, unsigned level) {
+	state.info_png.interlace_method = interlace;
+	state.encoder.auto_convert = 0;
+	state.encoder.num_threads = 1;
+	state.encoder.zlibsettings.level = level;
+}
+
+// Egy kép soronként és egyben; false, ha a kimenetek eltérnek
+static bool compare(const std::string& name, const std::vector<unsigned char>& image, unsigned width, unsigned height,
+	unsigned interlace, unsigned level) {
+	const unsigned rowsPerPush = 16;
+	lodepng::State state;
+	setup(state, interlace, level);
+	std::vector<unsigned char> full;
+	Clock::time_point start = Clock::now();
+	unsigned error = lodepng::encode(full, image, width, height, state);
+	double fullMs = msSince(start);
+	if (error) {
+		printf("  %-28s encode error %u: %s\n", name.c_str(), error, lodepng_error_text(error));
+		return false;
+	}
+
+	std::vector<unsigned char> png;
+	lodepng::StreamEncoder encoder(width, height, collect, &png);
+	setup(encoder.state, interlace, level);
+	encoder.idat_size = 2147483647; // egyetlen IDAT, ahogy a teljes kódolás írja
+	size_t rowBytes = (size_t)width * 4;
+	start = Clock::now();
+	for (unsigned y = 0; y < height && !error; y += rowsPerPush) {
+		error = encoder.push(&image[y * rowBytes], height - y < rowsPerPush ? height - y : rowsPerPush);
+	}
+	if (!error) error = encoder.finish();
+	double streamMs = msSince(start);
+	if (error) {
+		printf("  %-28s stream error %u: %s\n", name.c_str(), error, lodepng_error_text(error));
+		return false;
+	}
+	double mb = image.size() / 1e6;
+	bool same = png == full;
+	printf("  %-28s %7.1f MB/s  full %7.1f MB/s  %.2fx  %9zu bytes  %s\n", name.c_str(), mb / (streamMs / 1000),
+		mb / (fullMs / 1000), fullMs / streamMs, png.size(), same ? "" : "MISMATCH");
+	return same;
+}
+
+int main(int argc, char* argv[]) {
+	bool ok = true;
+	printf("%u rows per push, RGBA, 1 thread\n", 16);
+	if (argc > 1) {
+		for (int i = 1; i < argc; i++) {
+			std::vector<unsigned char> image;
+			unsigned width, height;
+			if (lodepng::decode(image, width, height, argv[i])) {
+				printf("cannot read %s\n", argv[i]);
+				continue;
+			}
+			ok = compare(argv[i], image, width, height, 0, LCL_DEFAULT) && ok;
+		}
+		return ok ? 0 : 1;
+	}
+
+	const unsigned size = 4096;
+	std::vector<unsigned char> image = syntheticImage(size, size);
+	printf("%ux%u RGBA\n", size, size);
+	const unsigned levels[2] = { LCL_FAST, LCL_DEFAULT };
+	for (unsigned level : levels) {
+		for (unsigned interlace = 0; interlace <= 1; interlace++) {
+			std::string name = std::string(interlace ? "Adam7" : "not interlaced") + ", level " + std::to_string(level);
+			ok = compare(name, image, size, size, interlace, level) && ok;
+		}
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+//=============================================================================================
+// Indulási benchmark: sok shader program szinkron (create) és aszinkron (createAsync) létrehozása
+//
+// Futtatás: make bench && out/bench_shader_startup [programok száma]
+// Mesa alatt a driver saját cache-ét érdemes kikapcsolni: MESA_SHADER_CACHE_DISABLE=true
+//=============================================================================================
+#include "framework.h"
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <memory>
+
+using Clock = std::chrono::steady_clock;
+
+static double msSince(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Minden változat más konstanst kap, hogy a driver ne ismerje fel a korábban fordított forrást
+static std::string variant(const char* stage, int run, int i) {
+	char source[1024];
+	if (stage[0] == 'v') {
+		snprintf(source, sizeof(source), R"(
+			#version 330
+			uniform mat4 MVP;
+			layout(location = 0) in vec3 wP;
+			void main() { gl_Position = MVP * vec4(wP * %d.%d, 1); }
+		)", run, i);
+	}
+	else {
+		snprintf(source, sizeof(source), R"(
+			#version 330
+			uniform vec3 color;
+			out vec4 fragmentColor;
+			void main() {
+				vec3 c = color;
+				for (int k = 0; k < 8; k++) c = sin(c * %d.%d + vec3(k));
+				fragmentColor = vec4(c, 1);
+			}
+		)", run, i);
+	}
+	return source;
+}
+
+int main(int argc, char* argv[]) {
+	int count = argc > 1 ? atoi(argv[1]) : 100;
+	if (!glfwInit()) return 1;
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* window = glfwCreateWindow(64, 64, "shader_startup", NULL, NULL);
+	if (!window) { glfwTerminate(); return 1; }
+	glfwMakeContextCurrent(window);
+	gladLoadGL();
+	loadGLExtensions(glfwGetProcAddress);
+	ProgramBinaryCache::enabled = false; // a fordítást mérjük, nem a cache-t
+
+	printf("%s, parallel shader compile: %s, %d programs\n", (const char*)glGetString(GL_RENDERER),
+		glExt.parallelShaderCompile ? "yes" : "no", count);
+	int run = (int)(std::chrono::system_clock::now().time_since_epoch().count() % 100000);
+
+	std::vector<std::string> vs, fs;
+	for (int i = 0; i < 2 * count; i++) {
+		vs.push_back(variant("v", run, i));
+		fs.push_back(variant("f", run, i));
+	}
+
+	// Szinkron: minden program fordítása és linkelése megvárja az előzőt
+	{
+		std::vector<std::unique_ptr<GPUProgram>> programs;
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < count; i++) {
+			programs.emplace_back(new GPUProgram());
+			programs.back()->create(vs[i].c_str(), fs[i].c_str());
+		}
+		glFinish();
+		printf("create:      all ready %8.2f ms\n", msSince(start));
+	}
+
+	// Aszinkron: először minden program elindul, utána pollozunk, ahogy a főciklus tenné
+	{
+		std::vector<std::unique_ptr<GPUProgram>> programs;
+		Clock::time_point start = Clock::now();
+		for (int i = count; i < 2 * count; i++) {
+			programs.emplace_back(new GPUProgram());
+			programs.back()->createAsync(vs[i].c_str(), fs[i].c_str());
+		}
+		double submitted = msSince(start);
+		int ready = 0, polls = 0;
+		double firstReady = -1;
+		while (ready < count) {
+			ready = 0;
+			for (auto& program : programs) ready += program->isReady() ? 1 : 0;
+			if (ready > 0 && firstReady < 0) firstReady = msSince(start);
+			polls++;
+		}
+		glFinish();
+		printf("createAsync: submitted %8.2f ms, first ready %8.2f ms, all ready %8.2f ms (%d polls)\n",
+			submitted, firstReady, msSince(start), polls);
+	}
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	return 0;
+}
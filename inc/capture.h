@@ -0,0 +1,47 @@
+//=============================================================================================
+// Képernyőkép és videó mentés: PBO gyűrűn keresztüli visszaolvasás, PNG kódolás háttérszálakon
+//=============================================================================================
+#pragma once
+#include <glad/glad.h>
+#include <memory>
+#include <string>
+#include "threadpool.h"
+
+//---------------------------
+class FrameCapture {
+//---------------------------
+	// A glReadPixels egy PBO-ba ír, így nem várja meg a GPU-t. Az eredményt egy-két képkockával később,
+	// a fence jelzése után olvassuk ki, és a kódolást a szálkészlet végzi.
+	struct Slot {
+		GLuint pbo = 0;
+		GLsizeiptr size = 0;			// a PBO lefoglalt mérete
+		GLsync fence = 0;				// 0: a slot szabad
+		int width = 0, height = 0;
+		std::string fileName;
+	};
+	static const int ringSize = 3;
+	Slot slots[ringSize];
+	int next = 0;						// következő írandó slot, egyben a legrégebbi függő is
+	std::unique_ptr<ThreadPool> encoders;
+	std::string screenshotName;			// üres: nincs kérés
+	std::string recordPrefix;
+	bool recording = false;
+	unsigned int recordFrame = 0;
+
+	void collect(bool wait);			// a kész slotok átadása a kódolóknak, sorrendben
+	void resolve(Slot& slot);
+public:
+	void screenshot(const std::string& fileName);		// a következő képkocka mentése
+	void startRecording(const std::string& prefix);	// minden képkocka mentése: prefix_000000.png, ...
+	void stopRecording();
+	bool isRecording() const { return recording; }
+
+	void captureFrame(int width, int height);			// főciklus: rajzolás után, buffercsere előtt; framebuffer méret pixelben
+	void finish();										// minden függő kép kiírása (kilépéskor)
+};
+
+// A keretrendszer közös példánya
+inline FrameCapture& frameCapture() {
+	static FrameCapture capture;
+	return capture;
+}
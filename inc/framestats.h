@@ -0,0 +1,100 @@
+//=============================================================================================
+// Képkocka statisztikák: CPU fázisidők, GPU időmérés, rajzolási hívások
+//=============================================================================================
+#pragma once
+#include <glad/glad.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// CPU oldalon mért fázisok a főciklusban
+enum FramePhase { PHASE_TIME_ELAPSED, PHASE_DISPLAY, PHASE_SWAP, PHASE_COUNT };
+
+// Egy GPU mérési csoport utolsó ismert eredménye
+struct GpuGroupStats {
+	std::string name;
+	double ms = 0;
+};
+
+// Programból olvasható pillanatkép (pl. headless benchmarkhoz)
+struct FrameStatsSnapshot {
+	unsigned long long frames = 0;			// eddig megjelenített képkockák
+	double cpuMs[PHASE_COUNT] = { 0 };		// utolsó képkocka fázisidői
+	double frameMs = 0;						// utolsó két megjelenítés közötti idő
+	double p50Ms = 0, p99Ms = 0;			// gördülő percentilisek a képkockaidőre
+	unsigned int drawCalls = 0;				// rajzolási hívások az onDisplay alatt
+	unsigned long long vertices = 0;		// kirajzolt csúcspontok az onDisplay alatt
+	std::vector<GpuGroupStats> gpu;			// GPU idő csoportonként
+};
+
+//---------------------------
+class FrameStats {
+//---------------------------
+public:
+	using Clock = std::chrono::steady_clock;
+	static const int historySize = 256;		// ennyi képkockából számolunk percentilist
+	static const int maxGpuGroups = 8;
+
+	// Egy fázis CPU idejének mérése a hatókör végéig
+	class CpuTimer {
+		FrameStats& stats;
+		FramePhase phase;
+		Clock::time_point start;
+	public:
+		CpuTimer(FrameStats& _stats, FramePhase _phase) : stats(_stats), phase(_phase), start(Clock::now()) { }
+		~CpuTimer() { stats.addCpuTime(phase, std::chrono::duration<double, std::milli>(Clock::now() - start).count()); }
+	};
+
+	// Egy rajzolási csoport GPU idejének mérése (GL_TIME_ELAPSED nem ágyazható egymásba!)
+	class GpuTimer {
+		FrameStats& stats;
+		bool active;
+	public:
+		GpuTimer(FrameStats& _stats, const char* name) : stats(_stats) { active = stats.beginGpu(name); }
+		~GpuTimer() { if (active) stats.endGpu(); }
+	};
+
+	void beginFrame();						// számlálók nullázása, előző GPU eredmények begyűjtése
+	void endDisplay();						// onDisplay utáni pillanatkép a rajzolási számlálókról
+	void endFrame();						// buffercsere után: képkocka rögzítése az előzményekbe
+	void addCpuTime(FramePhase phase, double ms) { cpuAccum[phase] += ms; }
+	bool beginGpu(const char* name);
+	void endGpu();
+	void countDraw(int vertexCount) { drawCalls++; vertices += vertexCount; }
+	FrameStatsSnapshot snapshot() const;
+
+private:
+	struct GpuGroup {
+		std::string name;
+		GLuint queries[2] = { 0, 0 };		// két készlet: az egyiket írjuk, a másikat olvassuk
+		bool issued[2] = { false, false };
+		double ms = 0;
+	};
+
+	unsigned long long frames = 0;
+	double cpuAccum[PHASE_COUNT] = { 0 };
+	double cpuLast[PHASE_COUNT] = { 0 };
+	unsigned int drawCalls = 0, drawCallsLast = 0;
+	unsigned long long vertices = 0, verticesLast = 0;
+	double history[historySize] = { 0 };
+	int historyCount = 0, historyNext = 0;
+	Clock::time_point lastFrameEnd;
+	bool hasLastFrameEnd = false;
+	std::vector<GpuGroup> gpuGroups;
+	int activeGroup = -1;
+};
+
+// A keretrendszer közös statisztika példánya
+inline FrameStats& frameStats() {
+	static FrameStats stats;
+	return stats;
+}
+
+// glDrawArrays, ami a statisztikában is számolódik
+inline void drawArrays(GLenum mode, GLint first, GLsizei count) {
+	frameStats().countDraw(count);
+	glDrawArrays(mode, first, count);
+}
+
+// A statisztika overlay kirajzolása a bal felső sarokba (framestats.cpp)
+void drawStatsOverlay(int windowWidth, int windowHeight);
@@ -1,6 +1,7 @@
 //=============================================================================================
 // OpenGL keretrendszer
 //=============================================================================================
+#pragma once
 #define GLAD_GL_IMPLEMENTATION
 #include <glad/glad.h>
 #define _USE_MATH_DEFINES		// M_PI
@@ -12,6 +13,12 @@
 #include <string>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include "framestats.h"
+#include "trace.h"
+#include "programcache.h"
+#include "uniformblocks.h"
+#include "texturecompress.h"
+#include "pixelkernels.h"
 
 #define FILE_OPERATIONS
 #ifdef FILE_OPERATIONS
@@ -36,8 +43,16 @@ class GPUProgram {
 //--------------------------
 	GLuint shaderProgramId = 0;
 	bool waitError = true;
+	bool pending = false;					// createAsync után, amíg az isReady() le nem zárja
+	bool linkFailed = false;				// az isReady() hibás programot talált, sosem lesz kész
+	uint64_t pendingKey = 0;
+	std::vector<GLuint> pendingShaders;
+#ifdef FILE_OPERATIONS
+	std::vector<std::pair<GLenum, fs::path>> shaderFiles;	// addShader-rel betöltött fájlok, a hot reload ezeket figyeli
+#endif
+	friend class ShaderHotReload;
 
-	bool checkShader(unsigned int shader, std::string message) { // shader ford�t�si hib�k kezel�se
+	bool checkShader(unsigned int shader, std::string message) { // shader fordítási hibák kezelése
 		GLint infoLogLength = 0, result = 0;
 		glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
 		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLogLength);
@@ -51,7 +66,7 @@ class GPUProgram {
 		return true;
 	}
 
-	bool checkLinking(unsigned int program) { 	// shader szerkeszt�si hib�k kezel�se
+	bool checkLinking(unsigned int program) { 	// shader szerkesztési hibák kezelése
 		GLint infoLogLength = 0, result = 0;
 		glGetProgramiv(program, GL_LINK_STATUS, &result);
 		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLogLength);
@@ -65,29 +80,12 @@ class GPUProgram {
 		return true;
 	}
 
-	int getLocation(const std::string& name) {	// uniform v�ltoz� c�m�nek lek�rdez�se
+	int getLocation(const std::string& name) {	// uniform változó címének lekérdezése
 		int location = glGetUniformLocation(shaderProgramId, name.c_str());
 		if (location < 0) printf("uniform %s cannot be set\n", name.c_str());
 		return location;
 	}
 
-#ifdef FILE_OPERATIONS
-	std::string file2string(const fs::path& _fileName) {
-		std::string shaderCodeOut = "";
-		std::ifstream shaderStream(_fileName);
-		if (!shaderStream.is_open()) {
-			printf("Error while opening shader code file %s!", _fileName.string().c_str());
-			return "";
-		}
-		std::string line = "";
-		while (std::getline(shaderStream, line)) {
-			shaderCodeOut += line + "\n";
-		}
-		shaderStream.close();
-		return shaderCodeOut;
-	}
-#endif
-
 	std::string shaderType2string(GLenum shadeType) {
 		switch (shadeType)
 		{
@@ -102,13 +100,41 @@ class GPUProgram {
 	}
 
 public:
+#ifdef FILE_OPERATIONS
+	// A teljes fájlt egyben olvassa be (a hot reload háttérszála is ezt használja)
+	static std::string file2string(const fs::path& _fileName) {
+		std::ifstream shaderStream(_fileName, std::ios::binary | std::ios::ate);
+		if (!shaderStream.is_open()) {
+			printf("Error while opening shader code file %s!", _fileName.string().c_str());
+			return "";
+		}
+		std::streamoff size = shaderStream.tellg();
+		if (size <= 0) return "";
+		std::string shaderCodeOut((size_t)size, '\0');
+		shaderStream.seekg(0);
+		shaderStream.read(&shaderCodeOut[0], size);
+		shaderCodeOut.resize((size_t)shaderStream.gcount());
+		return shaderCodeOut;
+	}
+#endif
+
 	GPUProgram( ) { }
 	GPUProgram(const char* const vertexShaderSource, const char * const fragmentShaderSource, const char * const geometryShaderSource = nullptr) {
 		create(vertexShaderSource, fragmentShaderSource, geometryShaderSource);
 	}
 
 	void create(const char* const vertexShaderSource, const char * const fragmentShaderSource, const char * const geometryShaderSource = nullptr) {
-		// Program l�trehoz�sa a forr�s sztringb�l
+		TRACE_SCOPE("GPUProgram::create");
+		// Ha van érvényes bináris a lemezen, a fordítás és a linkelés kimarad
+		uint64_t cacheKey = ProgramBinaryCache::key(vertexShaderSource, fragmentShaderSource, geometryShaderSource);
+		shaderProgramId = ProgramBinaryCache::load(cacheKey);
+		if (shaderProgramId) {
+			bindUniformBlocks(shaderProgramId);
+			glUseProgram(shaderProgramId);
+			return;
+		}
+
+		// Program létrehozása a forrás sztringből
 		GLuint  vertexShader = glCreateShader(GL_VERTEX_SHADER);
 		if (!vertexShader) {
 			printf("Error in vertex shader creation\n");
@@ -118,7 +144,7 @@ public:
 		glCompileShader(vertexShader);
 		if (!checkShader(vertexShader, "Vertex shader error")) return;
 
-		// Program l�trehoz�sa a forr�s sztringb�l, ha van geometria �rnyal�
+		// Program létrehozása a forrás sztringből, ha van geometria árnyaló
 		GLuint geometryShader = 0;
 		if (geometryShaderSource != nullptr) {
 			geometryShader = glCreateShader(GL_GEOMETRY_SHADER);
@@ -131,7 +157,7 @@ public:
 			if (!checkShader(geometryShader, "Geometry shader error")) return;
 		}
 
-		// Program l�trehoz�sa a forr�s sztringb�l
+		// Program létrehozása a forrás sztringből
 		GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
 		if (!fragmentShader) {
 			printf("Error in fragment shader creation\n");
@@ -151,8 +177,10 @@ public:
 		glAttachShader(shaderProgramId, fragmentShader);
 		if (geometryShader > 0) glAttachShader(shaderProgramId, geometryShader);
 
-		// Szerkeszt�s
+		// Szerkesztés
+		ProgramBinaryCache::prepare(shaderProgramId);
 		if (!link()) return;
+		ProgramBinaryCache::store(cacheKey, shaderProgramId);
 
 		// Ez fusson
 		glUseProgram(shaderProgramId); 
@@ -186,13 +214,87 @@ public:
 		if (!checkShader(shaderID, shaderType2string(shaderType) + " shader error")) return false;
 		if (shaderProgramId == 0) shaderProgramId = glCreateProgram();
 		glAttachShader(shaderProgramId, shaderID);
+		shaderFiles.push_back({ shaderType, _fileName });
 		return true;
 	}
 #endif
 
+	// Aszinkron létrehozás: a fordítás és a linkelés csak elindul, státuszt nem kérdez le.
+	// Több programnál érdemes előbb mindet elindítani, utána az isReady()-vel pollozni.
+	void createAsync(const char* const vertexShaderSource, const char * const fragmentShaderSource, const char * const geometryShaderSource = nullptr) {
+		TRACE_SCOPE("GPUProgram::createAsync");
+		pendingKey = ProgramBinaryCache::key(vertexShaderSource, fragmentShaderSource, geometryShaderSource);
+		linkFailed = false;
+		shaderProgramId = ProgramBinaryCache::load(pendingKey);
+		if (shaderProgramId) {
+			bindUniformBlocks(shaderProgramId);
+			return;
+		}
+
+		shaderProgramId = glCreateProgram();
+		if (!shaderProgramId) {
+			printf("Error in shader program creation\n");
+			exit(-1);
+		}
+		const char* sources[3] = { vertexShaderSource, geometryShaderSource, fragmentShaderSource };
+		const GLenum types[3] = { GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER };
+		for (int i = 0; i < 3; i++) {
+			if (sources[i] == nullptr) continue;
+			GLuint shader = glCreateShader(types[i]);
+			if (!shader) {
+				printf("Error in %s shader creation\n", shaderType2string(types[i]).c_str());
+				exit(1);
+			}
+			glShaderSource(shader, 1, (const GLchar**)&sources[i], NULL);
+			glCompileShader(shader);
+			glAttachShader(shaderProgramId, shader);
+			pendingShaders.push_back(shader);
+		}
+		ProgramBinaryCache::prepare(shaderProgramId);
+		glLinkProgram(shaderProgramId);
+		pending = true;
+	}
+
+	// Kész-e a program. KHR_parallel_shader_compile mellett nem blokkol, amíg a driver dolgozik;
+	// nélküle az első hívás megvárja a linkelést. Hibás program esetén kiírja a hibát, false marad, és a failed() igaz.
+	bool isReady() {
+		if (!pending) return shaderProgramId != 0;
+		if (glExt.parallelShaderCompile) {
+			GLint completed = 0;
+			glGetProgramiv(shaderProgramId, GL_COMPLETION_STATUS_KHR, &completed);
+			if (!completed) return false;
+		}
+		pending = false;
+
+		GLint linked = 0;
+		glGetProgramiv(shaderProgramId, GL_LINK_STATUS, &linked);
+		if (linked) {
+			bindUniformBlocks(shaderProgramId);
+			ProgramBinaryCache::store(pendingKey, shaderProgramId);
+		}
+		else {
+			for (GLuint shader : pendingShaders) {
+				GLint type = 0;
+				glGetShaderiv(shader, GL_SHADER_TYPE, &type);
+				checkShader(shader, shaderType2string(type) + " shader error");
+			}
+			checkLinking(shaderProgramId);
+			glDeleteProgram(shaderProgramId);
+			shaderProgramId = 0;
+			linkFailed = true;
+		}
+		for (GLuint shader : pendingShaders) glDeleteShader(shader);
+		pendingShaders.clear();
+		return shaderProgramId != 0;
+	}
+
+	bool failed() const { return linkFailed; }	// az aszinkron fordítás vagy linkelés nem sikerült
+
 	bool link() {
 		glLinkProgram(shaderProgramId);
-		return checkLinking(shaderProgramId);
+		if (!checkLinking(shaderProgramId)) return false;
+		bindUniformBlocks(shaderProgramId);
+		return true;
 	}
 
 	void Use() { glUseProgram(shaderProgramId); } 		// make this program run
@@ -227,7 +329,11 @@ public:
 		if (location >= 0) glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
 	}
 
-	~GPUProgram() { if (shaderProgramId > 0) glDeleteProgram(shaderProgramId); }
+	~GPUProgram() {
+		if (glContextDestroyed) return;
+		for (GLuint shader : pendingShaders) glDeleteShader(shader);
+		if (shaderProgramId > 0) glDeleteProgram(shaderProgramId);
+	}
 };
 
 //---------------------------
@@ -252,82 +358,183 @@ public:
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
 		glBufferData(GL_ARRAY_BUFFER, vtx.size() * sizeof(T), &vtx[0], GL_DYNAMIC_DRAW);
 	}
-	void Bind() { glBindVertexArray(vao); glBindBuffer(GL_ARRAY_BUFFER, vbo); } // aktiv�l�s
+	void Bind() { glBindVertexArray(vao); glBindBuffer(GL_ARRAY_BUFFER, vbo); } // aktiválás
 	void Draw(GPUProgram* prog, int type, vec3 color) {
 		if (vtx.size() > 0) {
 			prog->setUniform(color, "color");
 			glBindVertexArray(vao);
-			glDrawArrays(type, 0, (int)vtx.size());
+			drawArrays(type, 0, (int)vtx.size());
 		}
 	}
 	virtual ~Geometry() {
+		if (glContextDestroyed) return;
 		glDeleteBuffers(1, &vbo);
 		glDeleteVertexArrays(1, &vao);
 	}
 };
 
+// Texture jelzők: mipmap lánc, ill. BC1/BC3 tömörítés (ha a driver támogatja, különben tömörítetlen)
+enum TextureFlags { TEXTURE_MIPMAPS = 1, TEXTURE_COMPRESSED = 2 };
+
 //---------------------------
 class Texture {
 //---------------------------
 	unsigned int textureId = 0;
+	int width = 0, height = 0;
+	size_t memory = 0;				// becsült GPU memória bájtban
+	bool ready = true;				// false: az aszinkron betöltés még tart, addig a helyettesítő kép látszik
+	bool failed = false;			// a fájl betöltése nem sikerült, a TextureManager legközelebb újra próbálja
+	bool mipmapped = false;
+
+	friend class TextureLoader;
+	// Helyettesítő: egyetlen szürke texel, a TextureLoader tölti fel később ugyanebbe az azonosítóba
+	Texture() : ready(false) {
+		glGenTextures(1, &textureId);
+		glBindTexture(GL_TEXTURE_2D, textureId);
+		const unsigned char grey[4] = { 128, 128, 128, 255 };
+		memory = sizeof(grey);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+
+	// 8 bites feltöltés a kötött textúrába (channels: 3 vagy 4), mipmapek a GPU-n generálva
+	void upload(const unsigned char* pixels, int w, int h, int channels, int flags) {
+		if (flags & TEXTURE_COMPRESSED && glExt.textureCompressionS3TC) {
+			CompressedImage image;
+			compressImage(pixels, w, h, channels, channels == 4, flags & TEXTURE_MIPMAPS, image);
+			upload(image);
+			return;
+		}
+		GLenum format = channels == 4 ? GL_RGBA : GL_RGB;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // az RGB sorok nem 4 bájtra igazodnak
+		glTexImage2D(GL_TEXTURE_2D, 0, channels == 4 ? GL_RGBA8 : GL_RGB8, w, h, 0, format, GL_UNSIGNED_BYTE, pixels); // GPU-ra
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		width = w;
+		height = h;
+		memory = (size_t)w * h * 4; // az RGB8-at is jellemzően 4 bájton tárolják
+		mipmapped = flags & TEXTURE_MIPMAPS;
+		if (mipmapped) {
+			glGenerateMipmap(GL_TEXTURE_2D);
+			memory += memory / 3;
+		}
+	}
+	// Előre tömörített szintek feltöltése a kötött textúrába
+	void upload(const CompressedImage& image) {
+		int w = image.width, h = image.height;
+		memory = 0;
+		for (size_t level = 0; level < image.levels.size(); level++) {
+			glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, image.format, w, h, 0, (GLsizei)image.levels[level].size(), image.levels[level].data());
+			memory += image.levels[level].size();
+			w = w > 1 ? w / 2 : 1;
+			h = h > 1 ? h / 2 : 1;
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+		width = image.width;
+		height = image.height;
+		mipmapped = image.levels.size() > 1;
+	}
+	// Mipmapek esetén a kicsinyítés a szintek között is szűr
+	void setFilters(int minSampling, int magSampling) {
+		if (mipmapped) minSampling = minSampling == GL_NEAREST ? GL_NEAREST_MIPMAP_NEAREST : GL_LINEAR_MIPMAP_LINEAR;
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minSampling); // szűrés
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magSampling);
+	}
 public:
+	// Átlátszó textúrák: az alfa a világosságból származik, (r + g + b) / 6 (vektorizált, pixelkernels.h)
+	static void alphaFromLuminance(unsigned char* pixels, size_t count) {
+		::alphaFromLuminance(pixels, count);
+	}
+
 #ifdef FILE_OPERATIONS
-	Texture(const fs::path pathname, bool transparent = false, int sampling = GL_LINEAR) {
-		if (textureId == 0) glGenTextures(1, &textureId);  				// azonos�t� gener�l�s
-		glBindTexture(GL_TEXTURE_2D, textureId);    // k�t�s
-		unsigned int width, height;
-		unsigned char* pixels;
-		if (transparent) {
-			lodepng_decode32_file(&pixels, &width, &height, pathname.string().c_str());
-			for (int y = 0; y < height; ++y) {
-				for (int x = 0; x < width; ++x) {
-					float sum = 0;
-					for (int c = 0; c < 3; ++c) {
-						sum += pixels[4 * (x + y * width) + c];
-					}
-					pixels[4 * (x + y * width) + 3] = sum / 6;
-				}
+	// flags: TEXTURE_MIPMAPS, TEXTURE_COMPRESSED (átlátszatlan: BC1, átlátszó: BC3; lemezes gyorsítótárral)
+	Texture(const fs::path pathname, bool transparent = false, int sampling = GL_LINEAR, int flags = 0) {
+		if (textureId == 0) glGenTextures(1, &textureId);  				// azonosító generálás
+		glBindTexture(GL_TEXTURE_2D, textureId);    // kötés
+		if (flags & TEXTURE_COMPRESSED && glExt.textureCompressionS3TC) {
+			uint64_t key = CompressedTextureCache::key(pathname, transparent, flags & TEXTURE_MIPMAPS);
+			CompressedImage image;
+			if (CompressedTextureCache::load(key, image)) { // nem kell dekódolni
+				upload(image);
+				setFilters(sampling, sampling);
+				printf("%s, w: %d, h: %d (cached)\n", pathname.string().c_str(), width, height);
+				return;
 			}
-
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels); // GPU-ra
+		}
+		unsigned int w = 0, h = 0;
+		unsigned char* pixels = nullptr;
+		unsigned error;
+		// A textúrák a programmal szállított fájlok, futás közben senki nem írja őket, így leképezve olvashatók
+		if (transparent) {
+			error = lodepng_decode_file_mapped(&pixels, &w, &h, pathname.string().c_str(), LCT_RGBA, 8);
+			if (!error) alphaFromLuminance(pixels, (size_t)w * h);
+		}
+		else {
+			error = lodepng_decode_file_mapped(&pixels, &w, &h, pathname.string().c_str(), LCT_RGB, 8);
+		}
+		if (error) {
+			printf("Error while loading %s: %s\n", pathname.string().c_str(), lodepng_error_text(error));
+			free(pixels);
+			failed = true;
+			return;
+		}
+		if (flags & TEXTURE_COMPRESSED && glExt.textureCompressionS3TC) {
+			CompressedImage image;
+			compressImage(pixels, w, h, transparent ? 4 : 3, transparent, flags & TEXTURE_MIPMAPS, image);
+			CompressedTextureCache::store(CompressedTextureCache::key(pathname, transparent, flags & TEXTURE_MIPMAPS), image);
+			upload(image);
 		}
 		else {
-			lodepng_decode24_file(&pixels, &width, &height, pathname.string().c_str());
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels); // GPU-ra
+			upload(pixels, w, h, transparent ? 4 : 3, flags);
 		}
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampling); // sz�r�s
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampling);
+		free(pixels); // a lodepng malloc-kal foglal, a GPU-ra feltöltés után már nem kell
+		setFilters(sampling, sampling); // szűrés
 		printf("%s, w: %d, h: %d\n", pathname.string().c_str(), width, height);
 	}
 #endif
-	Texture(int width, int height) {
-		glGenTextures(1, &textureId); // azonos�t� gener�l�sa
-		glBindTexture(GL_TEXTURE_2D, textureId);    // ez az akt�v innent�l
-		// procedur�lis text�ra el��ll�t�sa programmal
-		const vec3 yellow(1, 1, 0), blue(0, 0, 1);
-		std::vector<vec3> image(width * height);
+	Texture(int width, int height, int flags = 0) {
+		glGenTextures(1, &textureId); // azonosító generálása
+		glBindTexture(GL_TEXTURE_2D, textureId);    // ez az aktív innentől
+		// procedurális textúra előállítása programmal
+		const unsigned char yellow[3] = { 255, 255, 0 }, blue[3] = { 0, 0, 255 };
+		std::vector<unsigned char> image(width * height * 3);
 		for (int x = 0; x < width; x++) for (int y = 0; y < height; y++) {
-			image[y * width + x] = (x & 1) ^ (y & 1) ? yellow : blue;
+			memcpy(&image[(y * width + x) * 3], (x & 1) ^ (y & 1) ? yellow : blue, 3);
+		}
+		upload(&image[0], width, height, 3, flags); // To GPU
+		setFilters(GL_NEAREST, GL_LINEAR); // sampling
+	}
+
+	Texture(int width, int height, std::vector<vec3>& image, int flags = 0) {
+		glGenTextures(1, &textureId); // azonosító generálása
+		glBindTexture(GL_TEXTURE_2D, textureId);    // ez az aktív innentől
+		std::vector<unsigned char> bytes(width * height * 3); // RGB8: negyed akkora feltöltés, mint float-tal
+		for (size_t i = 0; i < image.size() && i < (size_t)width * height; i++) {
+			for (int c = 0; c < 3; c++) bytes[3 * i + c] = (unsigned char)(fminf(fmaxf(image[i][c], 0.0f), 1.0f) * 255 + 0.5f);
 		}
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_FLOAT, &image[0]); // To GPU
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); // sampling
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		upload(&bytes[0], width, height, 3, flags); // To GPU
+		setFilters(GL_NEAREST, GL_LINEAR); // sampling
 	}
 
-	Texture(int width, int height, std::vector<vec3>& image) {
-		glGenTextures(1, &textureId); // azonos�t� gener�l�sa
-		glBindTexture(GL_TEXTURE_2D, textureId);    // ez az akt�v innent�l
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_FLOAT, &image[0]); // To GPU
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); // sampling
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	// 8 bites procedurális adat (channels: 3 = RGB8, 4 = RGBA8)
+	Texture(int width, int height, const std::vector<unsigned char>& pixels, int channels, int sampling = GL_LINEAR, int flags = 0) {
+		glGenTextures(1, &textureId);
+		glBindTexture(GL_TEXTURE_2D, textureId);
+		upload(&pixels[0], width, height, channels, flags);
+		setFilters(sampling, sampling);
 	}
 
 	void Bind(int textureUnit) {
-		glActiveTexture(GL_TEXTURE0 + textureUnit); // aktiv�l�s
-		glBindTexture(GL_TEXTURE_2D, textureId); // piros ny�l
+		glActiveTexture(GL_TEXTURE0 + textureUnit); // aktiválás
+		glBindTexture(GL_TEXTURE_2D, textureId); // piros nyíl
 	}
-	~Texture() {
-		if (textureId > 0) glDeleteTextures(1, &textureId);
+	bool isReady() const { return ready; }
+	bool loadFailed() const { return failed; }
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	size_t gpuBytes() const { return memory; }
+	~Texture() { // statikus textúránál a kontextus már megszűnhetett
+		if (textureId > 0 && !glContextDestroyed) glDeleteTextures(1, &textureId);
 	}
 };
 
@@ -340,21 +547,23 @@ class glApp {
 //---------------------------
 public:
 	glApp(const char * caption);
-	glApp(unsigned int major, unsigned int minor,        // K�rt OpenGL major.minor verzi�
-		  unsigned int winWidth, unsigned int winHeight, // Alkalmaz�i ablak felbont�sa
-		  const char * caption);       // Megfog�cs�k sz�vege
-	void refreshScreen(); // Ablak �rv�nytelen�t�se
-	// Esem�nykezel�k
-	virtual void onInitialization() {}    // Inicializ�ci�
-	virtual void onDisplay() {}           // Ablak �rv�nytelen
-	virtual void onKeyboard(int key) {}   // Klaviat�ra gomb lenyom�s
-	virtual void onKeyboardUp(int key) {} // Klaviat�ra gomb elenged
-	// Eg�r gomb lenyom�s/elenged�s
+	glApp(unsigned int major, unsigned int minor,        // Kért OpenGL major.minor verzió
+		  unsigned int winWidth, unsigned int winHeight, // Alkalmazói ablak felbontása
+		  const char * caption);       // Megfogócsík szövege
+	void showStats(bool visible);	// Statisztika overlay ki/be kapcsolása
+	bool statsVisible();
+	void refreshScreen(); // Ablak érvénytelenítése
+	// Eseménykezelők
+	virtual void onInitialization() {}    // Inicializáció
+	virtual void onDisplay() {}           // Ablak érvénytelen
+	virtual void onKeyboard(int key) {}   // Klaviatúra gomb lenyomás
+	virtual void onKeyboardUp(int key) {} // Klaviatúra gomb elenged
+	// Egér gomb lenyomás/elengedés
 	virtual void onMousePressed(MouseButton but, int pX, int pY) {}
 	virtual void onMouseReleased(MouseButton but, int pX, int pY) {}
-	// Eg�r mozgat�s lenyomott gombbal
+	// Egér mozgatás lenyomott gombbal
 	virtual void onMouseMotion(int pX, int pY) {}
-	// Telik az id�
+	// Telik az idő
 	virtual void onTimeElapsed(float startTime, float endTime) {}
 };
 
@@ -0,0 +1,93 @@
+//=============================================================================================
+// GL 3.3 fölötti függvények és kiterjesztések, amiket a glad (gl=3.3, kiterjesztések nélkül) nem tölt be
+//=============================================================================================
+#pragma once
+#include <glad/glad.h>
+#include <string.h>
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+typedef void (*GLExtProc)(void);
+typedef void (APIENTRYP GLExtGetProgramBinary)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP GLExtProgramBinary)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP GLExtProgramParameteri)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP GLExtMaxShaderCompilerThreads)(GLuint count);
+
+//---------------------------
+struct GLExtensions {
+//---------------------------
+	// ARB_get_program_binary (GL 4.1)
+	bool programBinary = false;
+	GLExtGetProgramBinary GetProgramBinary = nullptr;
+	GLExtProgramBinary ProgramBinary = nullptr;
+	GLExtProgramParameteri ProgramParameteri = nullptr;
+	// KHR_parallel_shader_compile / ARB_parallel_shader_compile
+	bool parallelShaderCompile = false;
+	GLExtMaxShaderCompilerThreads MaxShaderCompilerThreads = nullptr;
+	// EXT_texture_compression_s3tc: BC1/BC3 feltöltés glCompressedTexImage2D-vel (új függvény nem kell)
+	bool textureCompressionS3TC = false;
+};
+
+inline GLExtensions glExt;
+
+// A főciklus állítja be a kontextus megszüntetése előtt. Utána a statikus élettartamú GL objektumok
+// destruktorai nem hívhatnak GL függvényt: az objektumok a kontextussal együtt megszűntek.
+inline bool glContextDestroyed = false;
+
+// Támogatja-e az aktuális kontextus a megadott kiterjesztést
+inline bool hasGLExtension(const char* name) {
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++) {
+		const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (ext && strcmp(ext, name) == 0) return true;
+	}
+	return false;
+}
+
+// A kontextus létrehozása és a gladLoadGL után egyszer kell hívni (pl. glfwGetProcAddress-szel)
+inline void loadGLExtensions(GLExtProc (*getProc)(const char*)) {
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	bool gl41 = major > 4 || (major == 4 && minor >= 1);
+
+	if (gl41 || hasGLExtension("GL_ARB_get_program_binary")) {
+		glExt.GetProgramBinary = (GLExtGetProgramBinary)getProc("glGetProgramBinary");
+		glExt.ProgramBinary = (GLExtProgramBinary)getProc("glProgramBinary");
+		glExt.ProgramParameteri = (GLExtProgramParameteri)getProc("glProgramParameteri");
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		glExt.programBinary = glExt.GetProgramBinary && glExt.ProgramBinary && glExt.ProgramParameteri && formats > 0;
+	}
+
+	if (hasGLExtension("GL_KHR_parallel_shader_compile")) {
+		glExt.MaxShaderCompilerThreads = (GLExtMaxShaderCompilerThreads)getProc("glMaxShaderCompilerThreadsKHR");
+	}
+	else if (hasGLExtension("GL_ARB_parallel_shader_compile")) {
+		glExt.MaxShaderCompilerThreads = (GLExtMaxShaderCompilerThreads)getProc("glMaxShaderCompilerThreadsARB");
+	}
+	if (glExt.MaxShaderCompilerThreads) {
+		glExt.parallelShaderCompile = true;
+		glExt.MaxShaderCompilerThreads(0xFFFFFFFF); // a driver annyi szálat használ, amennyit jónak lát
+	}
+
+	glExt.textureCompressionS3TC = hasGLExtension("GL_EXT_texture_compression_s3tc");
+}
@@ -68,6 +68,14 @@ the custom_zlib field of the compress and decompress settings*/
 #define LODEPNG_COMPILE_DISK
 #endif
 
+/*lodepng_decode_file_mapped decodes through a read-only memory mapping of the file instead of reading it into a
+buffer first, where mmap is available (POSIX systems). Elsewhere, or without this, it reads the file like
+lodepng_decode_file. Without LODEPNG_COMPILE_DISK this does nothing*/
+#ifndef LODEPNG_NO_COMPILE_MMAP
+/*pass -DLODEPNG_NO_COMPILE_MMAP to the compiler to disable this, or comment out LODEPNG_COMPILE_MMAP below*/
+#define LODEPNG_COMPILE_MMAP
+#endif
+
 /*support for chunks other than IHDR, IDAT, PLTE, tRNS, IEND: ancillary and unknown chunks*/
 #ifndef LODEPNG_NO_COMPILE_ANCILLARY_CHUNKS
 /*pass -DLODEPNG_NO_COMPILE_ANCILLARY_CHUNKS to the compiler to disable this,
@@ -102,6 +110,22 @@ or comment out LODEPNG_COMPILE_CRC below*/
 #define LODEPNG_COMPILE_CRC
 #endif
 
+/*SIMD versions of the hot loops (SSE2/SSSE3/AVX2/PCLMUL on x86, NEON/CRC32 on ARM), selected at runtime
+by CPU feature detection. The portable code is always compiled as well and used when a feature is missing.*/
+#ifndef LODEPNG_NO_COMPILE_SIMD
+/*pass -DLODEPNG_NO_COMPILE_SIMD to the compiler to disable this, or comment out LODEPNG_COMPILE_SIMD below*/
+#define LODEPNG_COMPILE_SIMD
+#endif
+
+/*multithreaded encoding with std::thread, see num_threads in LodePNGEncoderSettings. Only available when
+compiled as C++11 or newer, as C the encoder always runs on the calling thread.*/
+#if defined(__cplusplus) && (__cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900))
+#ifndef LODEPNG_NO_COMPILE_THREADS
+/*pass -DLODEPNG_NO_COMPILE_THREADS to the compiler to disable this, or comment out LODEPNG_COMPILE_THREADS below*/
+#define LODEPNG_COMPILE_THREADS
+#endif
+#endif
+
 /*compile the C++ version (you can disable the C++ wrapper here even when compiling for C++)*/
 #ifdef __cplusplus
 #ifndef LODEPNG_NO_COMPILE_CPP
@@ -184,6 +208,16 @@ NOTE: Wide-character filenames are not supported, you can use an external method
 to handle such files and decode in-memory.*/
 unsigned lodepng_decode24_file(unsigned char** out, unsigned* w, unsigned* h,
                                const char* filename);
+
+/*Same as lodepng_decode_file, but decodes from a read-only memory mapping of the file (see
+LODEPNG_COMPILE_MMAP), which saves copying the file into a buffer first.
+
+NOTE: if the file is truncated by another process while it is decoded, reading the pages past its new end
+raises SIGBUS instead of returning an error. Only use this for files that nothing else writes to, such as
+assets shipped with the program.*/
+unsigned lodepng_decode_file_mapped(unsigned char** out, unsigned* w, unsigned* h,
+                                    const char* filename,
+                                    LodePNGColorType colortype, unsigned bitdepth);
 #endif /*LODEPNG_COMPILE_DISK*/
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -347,15 +381,38 @@ void lodepng_decompress_settings_init(LodePNGDecompressSettings* settings);
 Settings for zlib compression. Tweaking these settings tweaks the balance
 between speed and compression ratio.
 */
+/*Compression level presets, for LodePNGCompressSettings::level. Any value from 1 to 9 can be used.*/
+typedef enum LodePNGCompressLevel {
+  LCL_CUSTOM = 0, /*use windowsize, minmatch, nicematch and lazymatching as set*/
+  LCL_FAST = 1, /*greedy matching with a single hash probe, for screenshots and other throwaway images*/
+  LCL_DEFAULT = 6,
+  LCL_BEST = 9,
+  /*optimal parsing: the cheapest LZ77 encoding under a cost model taken from the previous pass, and blocks
+  split where that saves bits. About 40 times slower than LCL_BEST for around 6% smaller output: on a corpus of
+  game textures 558 s against 14 s for LCL_BEST. Only for assets that are compressed once*/
+  LCL_OPTIMAL = 10
+} LodePNGCompressLevel;
+
 typedef struct LodePNGCompressSettings LodePNGCompressSettings;
 struct LodePNGCompressSettings /*deflate = compress*/ {
-  /*LZ77 related settings*/
+  /*LZ77 related settings. windowsize, minmatch, nicematch and lazymatching are only used with level LCL_CUSTOM*/
   unsigned btype; /*the block type for LZ (0, 1, 2 or 3, see zlib standard). Should be 2 for proper compression.*/
   unsigned use_lz77; /*whether or not to use LZ77. Should be 1 for proper compression.*/
   unsigned windowsize; /*must be a power of two <= 32768. higher compresses more but is slower. Default value: 2048.*/
   unsigned minmatch; /*minimum lz77 length. 3 is normally best, 6 can be better for some PNGs. Default: 0*/
   unsigned nicematch; /*stop searching if >= this length found. Set to 258 for best compression. Default: 128*/
   unsigned lazymatching; /*use lazy matching: better compression but a bit slower. Default: true*/
+  /*1 (fastest) to 9 (smallest), see LodePNGCompressLevel. Replaces the four LZ77 settings above with tuned
+  presets, which also limit the hash chain search and set the block sizes. LCL_CUSTOM (0) uses the settings
+  above instead, which is slower than level 6 and not smaller. Values above 9 act as LCL_OPTIMAL.
+  Default: LCL_DEFAULT (6)*/
+  unsigned level;
+  unsigned iterations; /*passes of the cost model with LCL_OPTIMAL, more is smaller but slower. Default: 5*/
+  /*Compress the deflate blocks on this many threads (0: one per hardware thread), for inputs over 64 KiB.
+  Each block then ends on a byte boundary and its LZ77 search only sees the 32 KiB window before it, so the
+  output is slightly larger than with 1, but the same for any other value. Only used with
+  LODEPNG_COMPILE_THREADS. When encoding a PNG, a value of 1 here takes the encoder's num_threads. Default: 1*/
+  unsigned num_threads;
 
   /*use custom zlib encoder instead of built in one (default: null)*/
   unsigned (*custom_zlib)(unsigned char**, size_t*,
@@ -923,6 +980,11 @@ typedef struct LodePNGEncoderSettings {
   have to cleanup this buffer, LodePNG will never free it. Don't forget that filter_palette_zero
   must be set to 0 to ensure this is also used on palette or low bitdepth images.*/
   const unsigned char* predefined_filters;
+  /*Threads used to choose the filters with LFS_MINSUM, LFS_ENTROPY and LFS_BRUTE_FORCE, and to compress the
+  image data unless zlibsettings.num_threads is set: the image is split into bands of rows that are filtered
+  in parallel, and into deflate blocks. 0 means one thread per hardware thread. Only used with
+  LODEPNG_COMPILE_THREADS. Default: 1*/
+  unsigned num_threads;
 
   /*force creating a PLTE chunk if colortype is 2 or 6 (= a suggested palette).
   If colortype is 3, PLTE is always created. If color type is explicitely set
@@ -980,6 +1042,48 @@ information is placed in the info_png field of the LodePNGState.
 unsigned lodepng_inspect(unsigned* w, unsigned* h,
                          LodePNGState* state,
                          const unsigned char* in, size_t insize);
+
+#ifdef LODEPNG_COMPILE_ZLIB
+/*
+Receives one row of the image from the streaming decoder: (w * bpp + 7) / 8 bytes in the color mode of
+info_raw (which is the mode of the PNG if color_convert is off), y counts from 0 at the top. The row is only
+valid during the call.
+*/
+typedef void (*LodePNGRowCallback)(void* context, const unsigned char* row, unsigned y);
+
+/*
+Streaming decoder: decodes a PNG that arrives in pieces of any size (from a file, the network, ...) and passes
+on each row as soon as it is decoded, so the whole image never has to be in memory. A non-interlaced image
+only needs two scanlines and the 32K zlib window; an Adam7 interlaced image is only complete at the end, so its
+rows are all passed on at the end and it needs memory for the whole image, like lodepng_decode.
+Usage: lodepng_stream_decoder_init, set the settings and info_raw in state like for lodepng_decode, call
+lodepng_stream_decoder_push with the data, then lodepng_stream_decoder_finish, and finally
+lodepng_stream_decoder_cleanup. width, height and state.info_png are set once the IHDR chunk was pushed.
+The custom_zlib and custom_inflate settings are not used, and without LODEPNG_COMPILE_CRC the CRC of IDAT
+chunks is not checked. The row of an error (e.g. a corrupt zlib stream in the middle) is not passed on, but
+the rows before it were. Errors are found in the order of the data, so for a corrupt PNG the error code can
+differ from lodepng_decode, which checks the CRCs and the Adler-32 before it unfilters any row.
+Other chunks than IDAT are gathered whole before they are read, so ancillary chunks longer than max_chunk_size
+are skipped as they arrive instead: their CRC is not checked and they are not in state.info_png (no text,
+ICC profile or unknown chunk from them).
+*/
+typedef struct LodePNGStreamDecoder {
+  LodePNGState state;
+  unsigned width, height;
+  LodePNGRowCallback callback;
+  void* context; /*passed on to the callback*/
+  size_t max_chunk_size; /*ancillary chunks with more data than this are skipped, see above. Default: 1 MiB*/
+  struct LodePNGStreamInternal* internal; /*the decoding state, private*/
+} LodePNGStreamDecoder;
+
+void lodepng_stream_decoder_init(LodePNGStreamDecoder* decoder, LodePNGRowCallback callback, void* context);
+void lodepng_stream_decoder_cleanup(LodePNGStreamDecoder* decoder);
+/*Decodes the next size bytes of the PNG, calling the callback for the rows completed. Returns error code,
+once there is an error it is returned by all later calls (and is in state.error)*/
+unsigned lodepng_stream_decoder_push(LodePNGStreamDecoder* decoder, const unsigned char* data, size_t size);
+/*Call after the last push: returns an error if the PNG is incomplete, or 0 if all of it was decoded*/
+unsigned lodepng_stream_decoder_finish(LodePNGStreamDecoder* decoder);
+#endif /*LODEPNG_COMPILE_ZLIB*/
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 /*
@@ -1002,6 +1106,46 @@ unsigned lodepng_inspect_chunk(LodePNGState* state, size_t pos,
 unsigned lodepng_encode(unsigned char** out, size_t* outsize,
                         const unsigned char* image, unsigned w, unsigned h,
                         LodePNGState* state);
+
+#ifdef LODEPNG_COMPILE_ZLIB
+/*
+Receives the next size bytes of the PNG from the streaming encoder. The data is only valid during the call.
+Returns 0 if it was written, anything else stops the encoder with error 125.
+*/
+typedef unsigned (*LodePNGWriteCallback)(void* context, const unsigned char* data, size_t size);
+
+/*
+Streaming encoder: encodes a PNG from rows given a few at a time, and passes on the PNG in pieces while they
+are made, so neither the image nor the PNG has to be in memory as a whole. The rows are filtered and compressed
+as they come, and the image data is written in IDAT chunks of idat_size bytes. A non-interlaced image only
+needs two scanlines, the 32K zlib window and one deflate block; an Adam7 interlaced image needs all rows before
+it can be filtered, so it is kept in memory until lodepng_stream_encoder_finish, like lodepng_encode.
+Usage: lodepng_stream_encoder_init, set the settings, info_png and info_raw in state like for lodepng_encode
+(they must not change after the first push), call lodepng_stream_encoder_push with the rows from the top,
+then lodepng_stream_encoder_finish, and finally lodepng_stream_encoder_cleanup.
+Since the whole image is never seen, auto_convert is not used: the PNG has the color mode of info_png, and the
+rows are converted to it from info_raw if they differ. The custom_zlib, custom_deflate and num_threads settings
+are not used for the image data. With the same settings and btype 2 the PNG is the same as the one of
+lodepng_encode with auto_convert off and one thread (except for the division into IDAT chunks).
+*/
+typedef struct LodePNGStreamEncoder {
+  LodePNGState state;
+  unsigned width, height;
+  size_t idat_size; /*the size of the data of the IDAT chunks, the last one may be smaller. Default 65536*/
+  LodePNGWriteCallback write;
+  void* context; /*passed on to the write callback, a FILE* for lodepng_write_file*/
+  struct LodePNGStreamEncoderInternal* internal; /*the encoding state, private*/
+} LodePNGStreamEncoder;
+
+void lodepng_stream_encoder_init(LodePNGStreamEncoder* encoder, unsigned w, unsigned h,
+                                 LodePNGWriteCallback write, void* context);
+void lodepng_stream_encoder_cleanup(LodePNGStreamEncoder* encoder);
+/*Encodes the next count rows of the image: each row has (w * bpp + 7) / 8 bytes in the color mode of info_raw.
+Returns error code, once there is an error it is returned by all later calls (and is in state.error)*/
+unsigned lodepng_stream_encoder_push(LodePNGStreamEncoder* encoder, const unsigned char* rows, unsigned count);
+/*Call after the last row: writes the rest of the PNG, or returns an error if not all rows were pushed*/
+unsigned lodepng_stream_encoder_finish(LodePNGStreamEncoder* encoder);
+#endif /*LODEPNG_COMPILE_ZLIB*/
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
 /*
@@ -1095,10 +1239,30 @@ unsigned lodepng_chunk_create(unsigned char** out, size_t* outsize, size_t lengt
                               const char* type, const unsigned char* data);
 
 
-/*Calculate CRC32 of buffer*/
+/*Calculate CRC32 of buffer. Uses PCLMULQDQ (x86) or the CRC32 instructions (ARMv8) when available.*/
 unsigned lodepng_crc32(const unsigned char* buf, size_t len);
 #endif /*LODEPNG_COMPILE_PNG*/
 
+#ifdef LODEPNG_COMPILE_SIMD
+/*CPU features used by the SIMD code paths*/
+typedef enum LodePNGCPUFeature {
+  LCPU_SSE2 = 1,
+  LCPU_SSSE3 = 2,
+  LCPU_SSE41 = 4,
+  LCPU_AVX2 = 8,
+  LCPU_PCLMUL = 16,
+  LCPU_NEON = 32,
+  LCPU_ARM_CRC32 = 64
+} LodePNGCPUFeature;
+
+/*Bitmask of LodePNGCPUFeature: the features of the running CPU, restricted to lodepng_cpu_feature_mask*/
+unsigned lodepng_cpu_features(void);
+
+/*Clear bits to force the portable code paths, e.g. for benchmarks or to compare outputs. Default: all bits set.
+Not synchronized: change it only while no encoding or decoding is running.*/
+extern unsigned lodepng_cpu_feature_mask;
+#endif /*LODEPNG_COMPILE_SIMD*/
+
 
 #ifdef LODEPNG_COMPILE_ZLIB
 /*
@@ -1177,6 +1341,12 @@ NOTE: Wide-character filenames are not supported, you can use an external method
 to handle such files and encode in-memory
 */
 unsigned lodepng_save_file(const unsigned char* buffer, size_t buffersize, const char* filename);
+
+/*
+Writes data to the FILE* given as file, a LodePNGWriteCallback for the streaming encoder.
+Returns 0 if all of it was written.
+*/
+unsigned lodepng_write_file(void* file, const unsigned char* data, size_t size);
 #endif /*LODEPNG_COMPILE_DISK*/
 
 #ifdef LODEPNG_COMPILE_CPP
@@ -1199,6 +1369,21 @@ unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
 unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
                 State& state,
                 const std::vector<unsigned char>& in);
+
+#ifdef LODEPNG_COMPILE_ZLIB
+/* Streaming decoder, see LodePNGStreamDecoder. The settings are in the state member. */
+class StreamDecoder : public LodePNGStreamDecoder {
+  public:
+    StreamDecoder(LodePNGRowCallback callback, void* context);
+    ~StreamDecoder();
+    unsigned push(const unsigned char* data, size_t size);
+    unsigned push(const std::vector<unsigned char>& data);
+    unsigned finish();
+  private:
+    StreamDecoder(const StreamDecoder& other); /* not copyable */
+    StreamDecoder& operator=(const StreamDecoder& other);
+};
+#endif /*LODEPNG_COMPILE_ZLIB*/
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 #ifdef LODEPNG_COMPILE_ENCODER
@@ -1209,6 +1394,21 @@ unsigned encode(std::vector<unsigned char>& out,
 unsigned encode(std::vector<unsigned char>& out,
                 const std::vector<unsigned char>& in, unsigned w, unsigned h,
                 State& state);
+
+#ifdef LODEPNG_COMPILE_ZLIB
+/* Streaming encoder, see LodePNGStreamEncoder. The settings are in the state member. */
+class StreamEncoder : public LodePNGStreamEncoder {
+  public:
+    StreamEncoder(unsigned w, unsigned h, LodePNGWriteCallback write, void* context);
+    ~StreamEncoder();
+    unsigned push(const unsigned char* rows, unsigned count);
+    unsigned push(const std::vector<unsigned char>& rows); /* as many whole rows as are in the vector */
+    unsigned finish();
+  private:
+    StreamEncoder(const StreamEncoder& other); /* not copyable */
+    StreamEncoder& operator=(const StreamEncoder& other);
+};
+#endif /*LODEPNG_COMPILE_ZLIB*/
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
 #ifdef LODEPNG_COMPILE_DISK
@@ -1551,8 +1751,11 @@ can encode the colors of all pixels without information loss.
    compression.
 *) use_lz77: whether or not to use LZ77 for compressed block types. Should be
    true for proper compression.
-*) windowsize: the window size used by the LZ77 encoder (1 - 32768). Has value
-   2048 by default, but can be set to 32768 for better, but slow, compression.
+*) level: the compression level, from 1 (fastest) to 9 (smallest), LCL_DEFAULT (6)
+   by default. Picks the LZ77 settings below, see LodePNGCompressLevel.
+*) windowsize: the window size used by the LZ77 encoder (1 - 32768), only with
+   level LCL_CUSTOM. Has value 2048 by default, but can be set to 32768 for
+   better, but slow, compression.
 *) force_palette: if colortype is 2 or 6, you can make the encoder write a PLTE
    chunk if force_palette is true. This can used as suggested palette to convert
    to by viewers that don't support more than 256 colors (if those still exist)
@@ -1971,14 +2174,18 @@ For encoding:
 
 state.encoder.zlibsettings.btype: disable compression by setting it to 0
 state.encoder.zlibsettings.use_lz77: use LZ77 in compression
-state.encoder.zlibsettings.windowsize: tweak LZ77 windowsize
-state.encoder.zlibsettings.minmatch: tweak min LZ77 length to match
-state.encoder.zlibsettings.nicematch: tweak LZ77 match where to stop searching
-state.encoder.zlibsettings.lazymatching: try one more LZ77 matching
+state.encoder.zlibsettings.windowsize: tweak LZ77 windowsize, with level LCL_CUSTOM
+state.encoder.zlibsettings.minmatch: tweak min LZ77 length to match, with level LCL_CUSTOM
+state.encoder.zlibsettings.nicematch: tweak LZ77 match where to stop searching, with level LCL_CUSTOM
+state.encoder.zlibsettings.lazymatching: try one more LZ77 matching, with level LCL_CUSTOM
+state.encoder.zlibsettings.level: compression level preset (default 6), replaces the LZ77 settings above
+state.encoder.zlibsettings.iterations: passes of the optimal parser, for level LCL_OPTIMAL
+state.encoder.zlibsettings.num_threads: compress the deflate blocks in parallel
 state.encoder.zlibsettings.custom_...: use custom deflate function
 state.encoder.auto_convert: choose optimal PNG color type, if 0 uses info_png
 state.encoder.filter_palette_zero: PNG filter strategy for palette
 state.encoder.filter_strategy: PNG filter strategy to encode with
+state.encoder.num_threads: threads used for filtering and compressing the image data
 state.encoder.force_palette: add palette even if not encoding to one
 state.encoder.add_id: add LodePNG identifier and version as a text chunk
 state.encoder.text_compression: use compressed text chunks for metadata
@@ -0,0 +1,10 @@
+//=============================================================================================
+// Képpont műveletek vektorizált változatai (SSE2/AVX2, NEON), futásidejű kiválasztással
+//=============================================================================================
+#pragma once
+#include <stddef.h>
+
+// RGBA8 képen az alfa a világosságból: a = (r + g + b) / 6, lefelé kerekítve (a float-os képlettel azonos)
+void alphaFromLuminance(unsigned char* rgba, size_t count);
+// Skalár referencia, a vektoros változatok ellenőrzéséhez
+void alphaFromLuminanceScalar(unsigned char* rgba, size_t count);
@@ -0,0 +1,115 @@
+//=============================================================================================
+// Lemezen tárolt shader program binárisok (glGetProgramBinary), hogy ne kelljen minden induláskor fordítani
+//=============================================================================================
+#pragma once
+#include "glextensions.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+//---------------------------
+class ProgramBinaryCache {
+//---------------------------
+	static const uint32_t magic = 0x31425047; // "GPB1"
+
+	static void hash(uint64_t& h, const char* s) {
+		// FNV-1a, a lezáró nulla is belekerül, így a források határa is számít
+		if (s == nullptr) s = "";
+		do {
+			h ^= (unsigned char)*s;
+			h *= 0x100000001b3ULL;
+		} while (*s++);
+	}
+
+public:
+	static inline std::filesystem::path directory = "shadercache";
+	static inline bool enabled = true;
+
+	// Kulcs: a források és a driver azonosítói, így driver frissítés után sem töltünk be rossz binárist
+	static uint64_t key(const char* vertexSource, const char* fragmentSource, const char* geometrySource) {
+		uint64_t h = 0xcbf29ce484222325ULL;
+		hash(h, (const char*)glGetString(GL_VENDOR));
+		hash(h, (const char*)glGetString(GL_RENDERER));
+		hash(h, (const char*)glGetString(GL_VERSION));
+		hash(h, vertexSource);
+		hash(h, fragmentSource);
+		hash(h, geometrySource);
+		return h;
+	}
+
+	static std::filesystem::path fileName(uint64_t key) {
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+		return directory / name;
+	}
+
+	// Visszaad egy linkelt programot a cache-ből, vagy 0-t, ha nincs (vagy a driver elutasítja)
+	static GLuint load(uint64_t key) {
+		if (!enabled || !glExt.programBinary) return 0;
+		std::filesystem::path path = fileName(key);
+		FILE* file = fopen(path.string().c_str(), "rb");
+		if (!file) return 0;
+		uint32_t header[2] = { 0, 0 }; // magic, binaryFormat
+		std::vector<char> binary;
+		bool ok = fread(header, sizeof(header), 1, file) == 1 && header[0] == magic;
+		if (ok) {
+			fseek(file, 0, SEEK_END);
+			long size = ftell(file) - (long)sizeof(header);
+			fseek(file, sizeof(header), SEEK_SET);
+			ok = size > 0;
+			if (ok) {
+				binary.resize(size);
+				ok = fread(binary.data(), 1, binary.size(), file) == binary.size();
+			}
+		}
+		fclose(file);
+
+		GLuint program = 0;
+		if (ok) {
+			program = glCreateProgram();
+			glExt.ProgramBinary(program, (GLenum)header[1], binary.data(), (GLsizei)binary.size());
+			GLint linked = 0;
+			glGetProgramiv(program, GL_LINK_STATUS, &linked);
+			if (!linked) {
+				glDeleteProgram(program);
+				program = 0;
+			}
+		}
+		if (!program) {
+			std::error_code ec;
+			std::filesystem::remove(path, ec); // elavult vagy sérült bejegyzés, a következő fordítás felülírja
+		}
+		return program;
+	}
+
+	// Linkelés előtt kell hívni, hogy a driver megtartsa a binárist
+	static void prepare(GLuint program) {
+		if (enabled && glExt.programBinary) glExt.ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	// Sikeres linkelés után elmenti a program binárisát
+	static void store(uint64_t key, GLuint program) {
+		if (!enabled || !glExt.programBinary) return;
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) return;
+		std::vector<char> binary(length);
+		GLenum format = 0;
+		glExt.GetProgramBinary(program, length, nullptr, &format, binary.data());
+
+		std::error_code ec;
+		std::filesystem::create_directories(directory, ec);
+		std::filesystem::path path = fileName(key);
+		std::filesystem::path tmp = path;
+		tmp += ".tmp";
+		FILE* file = fopen(tmp.string().c_str(), "wb");
+		if (!file) return;
+		uint32_t header[2] = { magic, (uint32_t)format };
+		bool ok = fwrite(header, sizeof(header), 1, file) == 1 && fwrite(binary.data(), 1, binary.size(), file) == binary.size();
+		fclose(file);
+		if (ok) std::filesystem::rename(tmp, path, ec); // párhuzamosan futó példányok se lássanak félkész fájlt
+		else std::filesystem::remove(tmp, ec);
+	}
+};
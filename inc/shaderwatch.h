@@ -0,0 +1,58 @@
+//=============================================================================================
+// Shader hot reload: a fájlokból (addShader) épített programok forrásait figyeli, és változáskor
+// a háttérben újrafordítja őket. Siker esetén cseréli a programot, hiba esetén a régi marad.
+//=============================================================================================
+#pragma once
+#include "framework.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+//---------------------------
+class ShaderWatcher {
+//---------------------------
+	// Háttérszál: Linuxon inotify, máshol a módosítási idő pollozása. A változott fájlt rögtön be is olvassa.
+	std::thread thread;
+	std::atomic<bool> running{ false };
+	std::mutex mutex;
+	std::vector<fs::path> files;								// figyelt fájlok (kanonikus útvonal)
+	std::vector<std::pair<fs::path, std::string>> changes;		// beolvasott új források, a főszál veszi ki
+	int inotifyFd = -1;
+	std::map<int, fs::path> watchedDirs;						// inotify watch descriptor -> könyvtár
+	std::map<fs::path, fs::file_time_type> writeTimes;			// pollozós változathoz
+
+	void run();
+	void fileChanged(const fs::path& file);
+public:
+	void watch(const fs::path& file);
+	bool poll(fs::path& file, std::string& source);			// nem blokkol
+	~ShaderWatcher();
+};
+
+//---------------------------
+class ShaderHotReload {
+//---------------------------
+	struct Entry {
+		GPUProgram* program;
+		std::vector<std::pair<GLenum, fs::path>> files;			// kanonikus útvonalak
+		std::unique_ptr<GPUProgram> staging;					// épülő új változat
+		bool dirty = false;
+	};
+	ShaderWatcher watcher;
+	std::vector<Entry> entries;
+	std::map<fs::path, std::string> sources;					// legutóbb beolvasott források
+
+	void startBuild(Entry& entry);
+public:
+	void add(GPUProgram* program);			// a program addShader-rel betöltött fájljait figyeli
+	void remove(GPUProgram* program);
+	void update();							// képkockánként a GL szálon; soha nem vár a fordításra
+};
+
+// A keretrendszer közös példánya, a főciklus frissíti
+inline ShaderHotReload& shaderHotReload() {
+	static ShaderHotReload hotReload;
+	return hotReload;
+}
@@ -0,0 +1,87 @@
+//=============================================================================================
+// Textúra atlasz és textúra tömb: sok kis kép egyetlen textúrában, hogy a rajzolások összevonhatók legyenek
+//
+// A TextureAtlas a képeket betöltéskor csomagolja (polcos elrendezés egy 2D textúrában, vagy rétegenként
+// egy kép egy 2D textúra tömbben), az eredményt a lemezre menti, és a következő indításkor onnan tölti.
+// A SpriteBatch az atlasz képeiből álló négyszögeket gyűjti, és egyetlen rajzolással jeleníti meg.
+//=============================================================================================
+#pragma once
+#include "framework.h"
+
+enum AtlasLayout {
+	ATLAS_SHELF,	// egyetlen GL_TEXTURE_2D, a képek polcokra rendezve (sampler2D)
+	ATLAS_ARRAY		// GL_TEXTURE_2D_ARRAY, rétegenként egy kép (sampler2DArray)
+};
+
+// Egy kép helye az atlaszban: textúra koordináták (bal felső, jobb alsó) és a réteg
+struct AtlasRegion {
+	vec2 uvMin, uvMax;
+	int layer = 0;
+	int width = 0, height = 0;		// a kép mérete pixelben
+};
+
+//---------------------------
+class TextureAtlas {
+//---------------------------
+	struct Source {
+		fs::path path;
+		bool transparent;
+	};
+	std::vector<Source> sources;
+	std::vector<AtlasRegion> regions;
+	std::vector<unsigned char> pixels;		// csomagolt RGBA8 kép (rétegek egymás után), a feltöltésig
+	unsigned int textureId = 0;
+	AtlasLayout layout = ATLAS_SHELF;
+	int width = 0, height = 0, layers = 0;
+	size_t memory = 0;
+
+	uint64_t cacheKey(int maxSize, int padding) const;
+	bool loadCache(uint64_t key);
+	void storeCache(uint64_t key) const;
+	bool pack(std::vector<std::vector<unsigned char>>& images, int maxSize, int padding);
+	void upload(int sampling, int flags);
+public:
+	static inline fs::path cacheDirectory = "texturecache";
+	static inline bool cacheEnabled = true;
+
+	// A kép indexe, ezzel kérdezhető le a helye a build után
+	int add(const fs::path& path, bool transparent = false);
+	// Dekódolás (párhuzamosan), csomagolás és feltöltés; false, ha a képek nem férnek el maxSize-ban
+	bool build(AtlasLayout layout = ATLAS_SHELF, int maxSize = 4096, int padding = 2, int sampling = GL_LINEAR, int flags = 0);
+
+	const AtlasRegion& region(int image) const { return regions[image]; }
+	int imageCount() const { return (int)sources.size(); }
+	GLenum target() const { return layout == ATLAS_ARRAY ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D; }
+	size_t gpuBytes() const { return memory; }
+	void Bind(int textureUnit) {
+		glActiveTexture(GL_TEXTURE0 + textureUnit);
+		glBindTexture(target(), textureId);
+	}
+	~TextureAtlas() {
+		if (textureId > 0 && !glContextDestroyed) glDeleteTextures(1, &textureId);
+	}
+};
+
+// Sprite csúcspont: pozíció és textúra koordináta (x, y, u, v), valamint a tömb réteg
+struct SpriteVertex {
+	vec4 vtx;
+	float layer;
+};
+
+// A SpriteBatch-hez illő shaderek (a FrameConstants blokk viewProjection mátrixával)
+extern const char* const spriteVertexSource;
+extern const char* const spriteFragmentSource;			// ATLAS_SHELF
+extern const char* const spriteArrayFragmentSource;		// ATLAS_ARRAY
+
+//---------------------------
+class SpriteBatch : public Geometry<SpriteVertex> {
+//---------------------------
+	TextureAtlas* atlas;
+public:
+	SpriteBatch(TextureAtlas* _atlas);
+	void clear() { vtx.clear(); }
+	// Tengelyekkel párhuzamos négyszög (két háromszög) az atlasz image képével
+	void add(int image, vec2 min, vec2 max);
+	// Egyetlen kötés és egyetlen rajzolás az összes négyszögre
+	void Draw(GPUProgram* prog, int textureUnit = 0, vec3 tint = vec3(1, 1, 1));
+};
@@ -0,0 +1,46 @@
+//=============================================================================================
+// Textúra tömörítés a CPU-n: BC1 (DXT1, átlátszatlan) és BC3 (DXT5, alfával) kódoló, mipmap lánc,
+// és a tömörített eredmények lemezes gyorsítótára
+//=============================================================================================
+#pragma once
+#include "glextensions.h"
+#include <stdint.h>
+#include <vector>
+#include <filesystem>
+
+//---------------------------
+struct CompressedImage {
+//---------------------------
+	GLenum format = 0;							// GL_COMPRESSED_RGB_S3TC_DXT1_EXT vagy GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+	int width = 0, height = 0;					// a 0. szint mérete
+	std::vector<std::vector<unsigned char>> levels;
+
+	size_t bytes() const {
+		size_t sum = 0;
+		for (const auto& level : levels) sum += level.size();
+		return sum;
+	}
+};
+
+// 4x4-es blokkok; a kép széle a szélső pixelek ismétlésével egészül ki. channels: 3 (RGB) vagy 4 (RGBA)
+void compressBC1(const unsigned char* pixels, int width, int height, int channels, unsigned char* out);
+void compressBC3(const unsigned char* pixels, int width, int height, unsigned char* out);
+// Fél méretű kép 2x2-es doboz szűrővel (páratlan méretnél a szélső oszlop/sor ismétlődik)
+std::vector<unsigned char> downsample(const unsigned char* pixels, int width, int height, int channels);
+// alpha: BC3, különben BC1; mipmaps: a teljes lánc 1x1-ig
+void compressImage(const unsigned char* pixels, int width, int height, int channels, bool alpha, bool mipmaps, CompressedImage& image);
+
+//---------------------------
+class CompressedTextureCache {
+//---------------------------
+	// Egy bejegyzés: "GTC1", formátum, szélesség, magasság, szintszám, majd szintenként méret és adat
+	static const uint32_t magic = 0x31435447; // "GTC1"
+public:
+	static inline std::filesystem::path directory = "texturecache";
+	static inline bool enabled = true;
+
+	// Kulcs: a forrásfájl útvonala, mérete és módosítási ideje, valamint a tömörítés paraméterei
+	static uint64_t key(const std::filesystem::path& file, bool alpha, bool mipmaps);
+	static bool load(uint64_t key, CompressedImage& image);
+	static void store(uint64_t key, const CompressedImage& image);
+};
@@ -0,0 +1,58 @@
+//=============================================================================================
+// Aszinkron textúra betöltés: PNG dekódolás háttérszálakon, feltöltés PBO-n keresztül,
+// képkockánként korlátozott adagokban a GL szálon
+//=============================================================================================
+#pragma once
+#include "framework.h"
+#include "threadpool.h"
+#include <deque>
+#include <memory>
+#include <mutex>
+
+//---------------------------
+class TextureLoader {
+//---------------------------
+	// A load() azonnal visszaad egy helyettesítő textúrát, a dekódolás a szálkészleten fut. Az update()
+	// a kész képeket soronként, legfeljebb uploadBudget bájtnyit képkockánként tölti fel ugyanabba az
+	// azonosítóba, így a kiosztott textúra mindvégig köthető, és a betöltés végén érvényes lesz.
+	struct Job {
+		std::shared_ptr<Texture> texture;
+		fs::path path;
+		bool transparent;
+		int sampling;
+		int flags;
+		bool compress;						// BC1/BC3: a kódolás is a háttérszálon történik
+		unsigned char* pixels = nullptr;	// lodepng foglalja (malloc), feltöltés után felszabadul
+		unsigned int width = 0, height = 0;
+		unsigned error = 0;
+		unsigned int uploadedRows = 0;
+		CompressedImage compressed;
+		size_t uploadedLevels = 0;
+		~Job() { free(pixels); }
+	};
+	std::unique_ptr<ThreadPool> decoders;
+	std::mutex mutex;
+	std::deque<std::shared_ptr<Job>> decoded;		// dekódolók -> GL szál
+	std::deque<std::shared_ptr<Job>> uploading;		// csak a GL szál használja
+	GLuint pbo = 0;
+	size_t pending = 0;								// betöltés alatt álló textúrák (GL szál)
+
+	static void decode(Job& job);
+	void* stage(size_t bytes);						// a PBO leképezése írásra, nullptr ha nem sikerül
+	bool upload(Job& job, size_t& budget);			// true: a textúra elkészült
+	bool uploadLevel(Job& job, size_t& budget);		// tömörített szintenként
+public:
+	size_t uploadBudget = 4 << 20;					// képkockánként feltöltött bájtok felső korlátja
+
+	std::shared_ptr<Texture> load(const fs::path& path, bool transparent = false, int sampling = GL_LINEAR, int flags = 0);
+	int update();									// főciklus: az elkészült textúrák száma
+	void finish();									// minden függő textúra betöltése (blokkol)
+	size_t pendingCount() const { return pending; }
+	~TextureLoader();
+};
+
+// A keretrendszer közös példánya
+inline TextureLoader& textureLoader() {
+	static TextureLoader loader;
+	return loader;
+}
@@ -0,0 +1,45 @@
+//=============================================================================================
+// Textúra gyorsítótár: útvonal és betöltési paraméterek szerint megosztott textúrák,
+// GPU memória keret és LRU kiürítés
+//=============================================================================================
+#pragma once
+#include "framework.h"
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+//---------------------------
+class TextureManager {
+//---------------------------
+	// A kulcs a kanonikus útvonal, az átlátszóság, a szűrés és a formátum jelzők. A hivatkozásokat a shared_ptr számolja:
+	// amíg valaki tartja a textúrát, az nem üríthető ki, így a keret túllépésekor csak a már senki által
+	// nem használt bejegyzések közül a legrégebben kértek törlődnek. Egy sikertelen betöltés bejegyzését
+	// a következő get() eldobja és újratölti a fájlt.
+	struct Entry {
+		std::string key;
+		std::shared_ptr<Texture> texture;
+	};
+	std::list<Entry> entries;											// elöl a legutóbb használt
+	std::unordered_map<std::string, std::list<Entry>::iterator> index;
+	size_t hits = 0, misses = 0;
+
+	static std::string makeKey(const fs::path& path, bool transparent, int sampling, int flags);
+public:
+	size_t budget = (size_t)256 << 20;		// GPU memória keret bájtban
+	bool async = true;						// a textureLoader()-rel tölt, különben szinkron
+
+	std::shared_ptr<Texture> get(const fs::path& path, bool transparent = false, int sampling = GL_LINEAR, int flags = 0);
+	void trim();							// LRU kiürítés a keret alá, amennyire lehet
+	void clear();							// minden nem használt bejegyzés törlése
+	size_t residentBytes() const;
+	size_t size() const { return entries.size(); }
+	size_t hitCount() const { return hits; }
+	size_t missCount() const { return misses; }
+};
+
+// A keretrendszer közös példánya
+inline TextureManager& textureManager() {
+	static TextureManager manager;
+	return manager;
+}
@@ -0,0 +1,98 @@
+//=============================================================================================
+// Egyszerű szálkészlet korlátos várakozási sorral
+//=============================================================================================
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//---------------------------
+class ThreadPool {
+//---------------------------
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable jobAvailable;	// dolgozóknak: van új feladat vagy leállunk
+	std::condition_variable slotAvailable;	// beküldőnek: felszabadult hely a sorban
+	std::condition_variable idle;			// wait()-nek: minden feladat elkészült
+	size_t maxQueued;						// 0: korlátlan
+	size_t running = 0;
+	bool stopping = false;
+
+	void work() {
+		for (;;) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+				if (jobs.empty()) return; // leállás, és nincs több munka
+				job = std::move(jobs.front());
+				jobs.pop_front();
+				running++;
+			}
+			slotAvailable.notify_one();
+			job();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				running--;
+				if (jobs.empty() && running == 0) idle.notify_all();
+			}
+		}
+	}
+
+public:
+	// threads = 0: a magok száma - 1 (legalább 1), a hívó szál a saját munkáját végzi
+	ThreadPool(unsigned int threads = 0, size_t _maxQueued = 0) : maxQueued(_maxQueued) {
+		if (threads == 0) {
+			unsigned int cores = std::thread::hardware_concurrency();
+			threads = cores > 1 ? cores - 1 : 1;
+		}
+		for (unsigned int i = 0; i < threads; i++) workers.emplace_back(&ThreadPool::work, this);
+	}
+
+	size_t size() const { return workers.size(); }
+
+	// Ha a sor tele van, a hívó megvárja, amíg hely szabadul (visszanyomás, nem dob el munkát)
+	void submit(std::function<void()> job) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			slotAvailable.wait(lock, [this] { return maxQueued == 0 || jobs.size() < maxQueued; });
+			jobs.push_back(std::move(job));
+		}
+		jobAvailable.notify_one();
+	}
+
+	// Nem blokkol: false, ha a sor tele van
+	bool trySubmit(std::function<void()> job) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (maxQueued != 0 && jobs.size() >= maxQueued) return false;
+			jobs.push_back(std::move(job));
+		}
+		jobAvailable.notify_one();
+		return true;
+	}
+
+	size_t queued() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return jobs.size() + running;
+	}
+
+	// Megvárja az összes beküldött feladatot
+	void wait() {
+		std::unique_lock<std::mutex> lock(mutex);
+		idle.wait(lock, [this] { return jobs.empty() && running == 0; });
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		jobAvailable.notify_all();
+		for (std::thread& worker : workers) worker.join();
+	}
+};
@@ -0,0 +1,62 @@
+//=============================================================================================
+// CPU profilozás: hatókör alapú mérések chrome://tracing formátumban
+//
+// Használat: TRACE_SCOPE("nev"); a hatókör végéig mér. Csak ENABLE_TRACING mellett fordul be
+// (make trace=1), egyébként a makrók üresek és a mérés teljesen kiesik a kódból.
+//=============================================================================================
+#pragma once
+
+#ifdef ENABLE_TRACING
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+struct TraceEvent {
+	const char* name;		// statikus élettartamú sztring (literál)
+	uint64_t beginNs;
+	uint64_t endNs;
+};
+
+//---------------------------
+class TraceBuffer {
+//---------------------------
+	// Szálanként egy gyűrűbuffer: csak a tulajdonos szál ír bele, a kiíró csak olvas, így nem kell zár.
+public:
+	static const uint64_t capacity = 1 << 16;	// kettő hatványa
+	TraceEvent events[capacity];
+	std::atomic<uint64_t> written{ 0 };			// eddig beírt események száma
+	unsigned int threadId = 0;
+
+	void push(const TraceEvent& e) {
+		uint64_t n = written.load(std::memory_order_relaxed);
+		events[n & (capacity - 1)] = e;
+		written.store(n + 1, std::memory_order_release);
+	}
+};
+
+TraceBuffer& traceThreadBuffer();			// a hívó szál buffere, első híváskor regisztrálódik
+uint64_t traceNow();						// nanoszekundum a program indulása óta
+
+//---------------------------
+class TraceScope {
+//---------------------------
+	const char* name;
+	uint64_t begin;
+public:
+	TraceScope(const char* _name) : name(_name), begin(traceNow()) { }
+	~TraceScope() { traceThreadBuffer().push({ name, begin, traceNow() }); }
+};
+
+bool traceDump(const char* fileName);		// az összes szál eseményeinek kiírása JSON-ba
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_DUMP(fileName) traceDump(fileName)
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_DUMP(fileName) ((void)0)
+
+#endif
@@ -0,0 +1,95 @@
+//=============================================================================================
+// Uniform bufferek: képkockánként egyszer írt közös konstansok és objektumonkénti dinamikus blokk
+//
+// A shaderekben (std140):
+//	uniform FrameConstants { mat4 view; mat4 projection; mat4 viewProjection; vec4 viewport; float time; };
+//	uniform ObjectConstants { mat4 model; vec4 color; };
+// A blokkokat a GPUProgram linkelés után a rögzített kötési pontokra köti.
+//=============================================================================================
+#pragma once
+#include <glad/glad.h>
+#include "glextensions.h"
+#include <glm/glm.hpp>
+#include <vector>
+#include <string.h>
+
+enum UniformBinding { FRAME_CONSTANTS_BINDING = 0, OBJECT_CONSTANTS_BINDING = 1 };
+
+// A program blokkjainak hozzárendelése a rögzített kötési pontokhoz (GLSL 330-ban nincs layout(binding))
+inline void bindUniformBlocks(GLuint program) {
+	GLuint frameIndex = glGetUniformBlockIndex(program, "FrameConstants");
+	if (frameIndex != GL_INVALID_INDEX) glUniformBlockBinding(program, frameIndex, FRAME_CONSTANTS_BINDING);
+	GLuint objectIndex = glGetUniformBlockIndex(program, "ObjectConstants");
+	if (objectIndex != GL_INVALID_INDEX) glUniformBlockBinding(program, objectIndex, OBJECT_CONSTANTS_BINDING);
+}
+
+// std140 elrendezés: a mat4 és a vec4 16 bájtra igazodik, a végén kitöltés
+struct FrameConstants {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::vec4 viewport;		// x, y, szélesség, magasság pixelben
+	float time;				// másodperc
+	float padding[3];
+};
+
+struct ObjectConstants {
+	glm::mat4 model;
+	glm::vec4 color;
+};
+
+//---------------------------
+class FrameUniforms {
+//---------------------------
+	GLuint ubo = 0;
+public:
+	FrameUniforms() {
+		glGenBuffers(1, &ubo);
+		glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameConstants), nullptr, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_BINDING, ubo);
+	}
+	// Képkockánként egyszer, az első rajzolás előtt
+	void update(const FrameConstants& constants) {
+		glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameConstants), &constants);
+		glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_BINDING, ubo);
+	}
+	~FrameUniforms() { if (!glContextDestroyed) glDeleteBuffers(1, &ubo); }
+};
+
+//---------------------------
+class ObjectUniforms {
+//---------------------------
+	// Az objektumok konstansai egy CPU oldali tömbbe gyűlnek, a képkockában egyetlen feltöltéssel
+	// kerülnek a GPU-ra, rajzoláskor pedig csak a megfelelő tartomány kötődik (glBindBufferRange).
+	GLuint ubo = 0;
+	size_t stride;				// sizeof(ObjectConstants) felfelé kerekítve az offset igazításra
+	size_t capacity = 0;		// a GPU buffer mérete bájtban
+	std::vector<unsigned char> staging;
+public:
+	ObjectUniforms() {
+		GLint alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		stride = (sizeof(ObjectConstants) + alignment - 1) / alignment * alignment;
+		glGenBuffers(1, &ubo);
+	}
+	void reset() { staging.clear(); }				// képkocka elején
+	GLintptr push(const ObjectConstants& constants) {	// visszaadja a rajzoláskor kötendő offsetet
+		size_t offset = staging.size();
+		staging.resize(offset + stride);
+		memcpy(&staging[offset], &constants, sizeof(ObjectConstants));
+		return (GLintptr)offset;
+	}
+	void upload() {									// az összes push után, a rajzolások előtt
+		if (staging.empty()) return;
+		glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+		if (staging.size() > capacity) capacity = staging.size() * 2;
+		glBufferData(GL_UNIFORM_BUFFER, capacity, nullptr, GL_STREAM_DRAW); // orphaning: nem várunk az előző képkockára
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, staging.size(), staging.data());
+	}
+	void bind(GLintptr offset) {
+		glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_CONSTANTS_BINDING, ubo, offset, sizeof(ObjectConstants));
+	}
+	~ObjectUniforms() { if (!glContextDestroyed) glDeleteBuffers(1, &ubo); }
+};
@@ -1,32 +1,49 @@
 //=============================================================================================
-// Z�ld h�romsz�g: A framework.h oszt�lyait felhaszn�l� megold�s
+// Zöld háromszög: A framework.h osztályait felhasználó megoldás
 //=============================================================================================
 #include "../inc/framework.h"
+#include "../inc/capture.h"
+#ifdef SHADER_HOT_RELOAD
+#include "../inc/shaderwatch.h"
+#endif
 #include <math.h>
 
-// cs�cspont �rnyal�
+// csúcspont árnyaló
 const char * vertSource = R"(
 	#version 330				
     precision highp float;
 
-	uniform mat4 MVP;
+	layout(std140) uniform FrameConstants {	// képkockánként egyszer írva
+		mat4 view;
+		mat4 projection;
+		mat4 viewProjection;
+		vec4 viewport;
+		float time;
+	};
+	layout(std140) uniform ObjectConstants {	// objektumonként
+		mat4 model;
+		vec4 color;
+	};
 	layout(location = 0) in vec3 wP;	// 0. bemeneti regiszter
 
 	void main() {
-		gl_Position = MVP * vec4(wP.x, wP.y, wP.z, 1);
+		gl_Position = viewProjection * model * vec4(wP.x, wP.y, wP.z, 1);
 	}
 )";
 
-// pixel �rnyal�
+// pixel árnyaló
 const char * fragSource = R"(
 	#version 330
     precision highp float;
 
-	uniform vec3 color;			// konstans sz�n
-	out vec4 fragmentColor;		// pixel sz�n
+	layout(std140) uniform ObjectConstants {
+		mat4 model;
+		vec4 color;				// konstans szín
+	};
+	out vec4 fragmentColor;		// pixel szín
 
 	void main() {
-		fragmentColor = vec4(color, 1); // RGB -> RGBA
+		fragmentColor = color;
 	}
 )";
 
@@ -129,6 +146,7 @@ public:
 	 * @return vec3 t paraméterhez tartozó pont helyvektora világ koordinátákban.
 	 */
 	vec3 wR(float t) {
+		TRACE_SCOPE("Spline::wR");
 		if (wControlPoints.size() < 2) {
 			return vec3(NAN);
 		}
@@ -250,6 +268,7 @@ public:
 	 * Szinkronizálja a GPU-n és CPU-n tárolt adatokat.
 	 */
 	void sync() {
+		TRACE_SCOPE("Spline::sync");
 		// Görbék kiszámítása
 		if (wControlPoints.size() >= 2) {
 			wCurvePoints.clear();
@@ -274,25 +293,34 @@ public:
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
 	}
 
+	/**
+	 * Beírja a görbe és a kontrollpontok objektum konstansait a képkocka uniform bufferébe.
+	 * 
+	 * @param objectUniforms Objektumonkénti uniform buffer, a draw előtt töltődik fel.
+	 */
+	void prepare(ObjectUniforms* objectUniforms) {
+		curveConstants = objectUniforms->push({ mat4(1.0f), vec4(1.0f, 1.0f, 0.0f, 1.0f) }); // yellow
+		controlPointConstants = objectUniforms->push({ mat4(1.0f), vec4(1.0f, 0.0f, 0.0f, 1.0f) }); // red
+	}
+
 	/**
 	 * Kirajzolja a GPU-n tárolt állapotot.
 	 * 
-	 * @param gpuProgram Shader program, amin beállítja a szín uniformot.
+	 * @param gpuProgram Shader program.
+	 * @param objectUniforms Feltöltött objektumonkénti uniform buffer, ebből köti a prepare-ben kapott tartományokat.
 	 */
-	void draw(GPUProgram* gpuProgram, mat4 MVP) {
+	void draw(GPUProgram* gpuProgram, ObjectUniforms* objectUniforms) {
+		gpuProgram->Use();
+
 		// Görbe
 		bindCurvePoints();
-		gpuProgram->Use();
-		gpuProgram->setUniform(vec3(1.0f, 1.0f, 0.0f), "color"); // yellow
-		gpuProgram->setUniform(MVP, "MVP");
-		glDrawArrays(GL_LINE_STRIP, 0, wCurvePoints.size());
+		objectUniforms->bind(curveConstants);
+		drawArrays(GL_LINE_STRIP, 0, wCurvePoints.size());
 		
 		// Kontroll pontok
 		bindControlPoints();		
-		gpuProgram->Use();
-		gpuProgram->setUniform(vec3(1.0f, 0.0f, 0.0f), "color"); // red
-		gpuProgram->setUniform(MVP, "MVP");		
-		glDrawArrays(GL_POINTS, 0, wControlPoints.size());
+		objectUniforms->bind(controlPointConstants);
+		drawArrays(GL_POINTS, 0, wControlPoints.size());
 	}
 
 private:
@@ -304,6 +332,8 @@ private:
 	std::vector<vec3> wControlPoints;
 	std::vector<vec3> wCurvePoints;
 	std::vector<float> knotValues;
+	GLintptr curveConstants = 0;
+	GLintptr controlPointConstants = 0;
 
 	/**
 	 * Kiszámolja a sebesség vektort a sorszámmal megadott kontroll ponthoz.
@@ -506,6 +536,7 @@ public:
 	 * @param dt Idő paraméter
 	 */
 	void move(float dt) {
+		TRACE_SCOPE("Wheel::move");
 		if (state != WheelState::MOVING && state != WheelState::FALLING) {
 			return;
 		}
@@ -583,24 +614,33 @@ public:
 		return state;
 	}
 
+	/**
+	 * Beírja a kerék objektum konstansait (modell mátrix és színek) a képkocka uniform bufferébe.
+	 * 
+	 * @param objectUniforms Objektumonkénti uniform buffer, a draw előtt töltődik fel.
+	 */
+	void prepare(ObjectUniforms* objectUniforms) {
+		mat4 M = model();
+		fillConstants = objectUniforms->push({ M, vec4(0.0f, 0.0f, 1.0f, 1.0f) }); // blue
+		outlineConstants = objectUniforms->push({ M, vec4(1.0f, 1.0f, 1.0f, 1.0f) }); // white
+	}
+
 	/**
 	 * Megrajzolja a kereket.
 	 */
-	void draw(GPUProgram* gpuProgram, mat4 MVP) {		
-		MVP = MVP * model();
+	void draw(GPUProgram* gpuProgram, ObjectUniforms* objectUniforms) {
 		gpuProgram->Use();
-		gpuProgram->setUniform(MVP, "MVP");
 
-		gpuProgram->setUniform(vec3(0.0f, 0.0f, 1.0f), "color"); // blue
+		objectUniforms->bind(fillConstants);
 		bindFill();
-		glDrawArrays(GL_TRIANGLE_FAN, 0, mCirclePoints.size());
+		drawArrays(GL_TRIANGLE_FAN, 0, mCirclePoints.size());
 		
-		gpuProgram->setUniform(vec3(1.0f, 1.0f, 1.0f), "color"); // white
+		objectUniforms->bind(outlineConstants);
 		bindOutlines();
-		glDrawArrays(GL_LINE_LOOP, 0, mOutlinePoints.size());
+		drawArrays(GL_LINE_LOOP, 0, mOutlinePoints.size());
 
 		bindSpokes();
-		glDrawArrays(GL_LINES, 0, mSpokePoints.size());
+		drawArrays(GL_LINES, 0, mSpokePoints.size());
 	}
 
 private:
@@ -626,6 +666,9 @@ private:
 	unsigned int fillVAO;
 	unsigned int fillVBO;		
 	std::vector<vec3> mCirclePoints;
+	// Objektum konstansok helye a képkocka uniform bufferében
+	GLintptr fillConstants = 0;
+	GLintptr outlineConstants = 0;
 
 	/**
 	 * Bindolja a körvonal és a küllők VAO és VBO-ját.
@@ -663,25 +706,54 @@ private:
 
 const int winWidth = 600, winHeight = 600;
 
+#ifdef SHADER_HOT_RELOAD
+// A beépített forrást a shaders könyvtárba írja, ha még nincs ott; futás közben az ott szerkesztett fájl töltődik újra
+static fs::path shaderFile(const char* name, const char* source) {
+	fs::path path = fs::path("shaders") / name;
+	std::error_code ec;
+	if (!fs::exists(path, ec)) {
+		fs::create_directories(path.parent_path(), ec);
+		std::ofstream(path, std::ios::binary) << source;
+	}
+	return path;
+}
+#endif
+
 class SpileAndWheelApp : public glApp {
 	GPUProgram* gpuProgram;
 	Camera* camera;
 	Spline* spline;
 	Wheel* wheel;
-	mat4 MVP;
+	FrameUniforms* frameUniforms;
+	ObjectUniforms* objectUniforms;
 	mat4 invMVP;
 	float time;
 public:
 	SpileAndWheelApp() : glApp("Lab2") { }
 
 	void onInitialization() override {
-		gpuProgram = new GPUProgram(vertSource, fragSource);		
+		gpuProgram = new GPUProgram();
+#ifdef SHADER_HOT_RELOAD
+		// Fájlokból épül, hogy a hot reload figyelhesse; ha nem sikerül, marad a beépített forrás
+		if (gpuProgram->addShader(shaderFile("app.vert", vertSource)) && gpuProgram->addShader(shaderFile("app.frag", fragSource)) &&
+			gpuProgram->link()) {
+			shaderHotReload().add(gpuProgram);
+		}
+		else {
+			delete gpuProgram;
+			gpuProgram = new GPUProgram();
+			gpuProgram->createAsync(vertSource, fragSource);
+		}
+#else
+		gpuProgram->createAsync(vertSource, fragSource);	// az első képkocka nem várja meg a fordítást
+#endif
 		spline = new Spline();
 		wheel = new Wheel(spline);
 		camera = new Camera(vec3(10.0f, 10.0f, 1.0f), 20.0f, 20.0f);
+		frameUniforms = new FrameUniforms();
+		objectUniforms = new ObjectUniforms();
 
 		time = 0.0f;
-		MVP = camera->projection() * camera->view();
 		invMVP = camera->invView() * camera->invProjection();
 
 		glLineWidth(3);
@@ -693,10 +765,37 @@ public:
 		glClear(GL_COLOR_BUFFER_BIT);
 		glViewport(0, 0, winWidth, winHeight);
 
+		if (!gpuProgram->isReady()) {
+			if (gpuProgram->failed()) exit(-1); // a hibát az isReady() már kiírta, a program sosem lesz kész
+			refreshScreen(); // a következő képkockában újra megnézzük
+			return;
+		}
+
+		// Közös konstansok: képkockánként egyetlen feltöltés
+		FrameConstants frame = {};
+		frame.view = camera->view();
+		frame.projection = camera->projection();
+		frame.viewProjection = frame.projection * frame.view;
+		frame.viewport = vec4(0.0f, 0.0f, (float)winWidth, (float)winHeight);
+		frame.time = time;
+		frameUniforms->update(frame);
+
+		// Objektum konstansok: előbb mindenki beírja a sajátját, utána egy feltöltés
 		wheel->sync();
-		wheel->draw(gpuProgram, MVP);
 		spline->sync();
-		spline->draw(gpuProgram, MVP);
+		objectUniforms->reset();
+		wheel->prepare(objectUniforms);
+		spline->prepare(objectUniforms);
+		objectUniforms->upload();
+
+		{
+			FrameStats::GpuTimer timer(frameStats(), "wheel");
+			wheel->draw(gpuProgram, objectUniforms);
+		}
+		{
+			FrameStats::GpuTimer timer(frameStats(), "spline");
+			spline->draw(gpuProgram, objectUniforms);
+		}
 	}
 
 	void onMousePressed(MouseButton but, int pX, int pY) override {
@@ -731,12 +830,31 @@ public:
 				wheel->start();
 				break;
 
+			case 'h':
+				showStats(!statsVisible());
+				break;
+
+			case 't':
+				TRACE_DUMP("trace.json");
+				break;
+
+			case 'c':
+				frameCapture().screenshot("screenshot.png");
+				refreshScreen();
+				break;
+
+			case 'v':
+				if (frameCapture().isRecording()) frameCapture().stopRecording();
+				else frameCapture().startRecording("capture");
+				break;
+
 			default:
 				break;
 		}
 	}
 	
 	void onTimeElapsed(float startTime, float endTime) override {
+		time = endTime;
 		if (wheel->getState() != WheelState::MOVING && wheel->getState() != WheelState::FALLING) {
 			return;
 		}
@@ -0,0 +1,126 @@
+//=============================================================================================
+// Képernyőkép és videó mentés
+//=============================================================================================
+#include "capture.h"
+#include "lodepng.h"
+#include "trace.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+void FrameCapture::screenshot(const std::string& fileName) {
+	screenshotName = fileName;
+}
+
+void FrameCapture::startRecording(const std::string& prefix) {
+	recordPrefix = prefix;
+	recordFrame = 0;
+	recording = true;
+}
+
+void FrameCapture::stopRecording() {
+	recording = false;
+}
+
+void FrameCapture::resolve(Slot& slot) {
+	TRACE_SCOPE("FrameCapture::resolve");
+	GLsizeiptr size = (GLsizeiptr)slot.width * slot.height * 4;
+	std::vector<unsigned char> pixels(size);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+	if (mapped) {
+		memcpy(pixels.data(), mapped, size);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glDeleteSync(slot.fence);
+	slot.fence = 0;
+	if (!mapped) {
+		printf("Error while mapping capture buffer for %s\n", slot.fileName.c_str());
+		return;
+	}
+
+	if (!encoders) {
+		// A sor korlátos: ha a kódolók lemaradnak, a főciklus megvárja őket, és nem dobunk el képkockát
+		unsigned int cores = std::thread::hardware_concurrency();
+		unsigned int threads = cores > 1 ? cores - 1 : 1;
+		encoders.reset(new ThreadPool(threads, 2 * threads));
+	}
+	int width = slot.width, height = slot.height;
+	std::string fileName = slot.fileName;
+	encoders->submit([pixels = std::move(pixels), width, height, fileName]() mutable {
+		TRACE_SCOPE("FrameCapture::encode");
+		// Az OpenGL alulról felfelé olvas, a PNG felülről lefelé tárol
+		size_t rowBytes = (size_t)width * 4;
+		std::vector<unsigned char> row(rowBytes);
+		for (int y = 0; y < height / 2; y++) {
+			unsigned char* top = &pixels[y * rowBytes];
+			unsigned char* bottom = &pixels[(height - 1 - y) * rowBytes];
+			memcpy(row.data(), top, rowBytes);
+			memcpy(top, bottom, rowBytes);
+			memcpy(bottom, row.data(), rowBytes);
+		}
+		for (size_t i = 3; i < pixels.size(); i += 4) pixels[i] = 255; // a framebuffer alfája nem kell
+		// Futás közben a sebesség a fontos, nem az utolsó néhány százalék a méretből: mohó, 1-es szint
+		lodepng::State state;
+		state.encoder.zlibsettings.level = LCL_FAST;
+		std::vector<unsigned char> png;
+		unsigned error = lodepng::encode(png, pixels, width, height, state);
+		if (!error) error = lodepng::save_file(png, fileName);
+		if (error) printf("Error while saving %s: %s\n", fileName.c_str(), lodepng_error_text(error));
+	});
+}
+
+void FrameCapture::collect(bool wait) {
+	for (int i = 0; i < ringSize; i++) {
+		Slot& slot = slots[(next + i) % ringSize];	// a legrégebbitől kezdve
+		if (!slot.fence) continue;
+		GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break; // a sorrend megmarad
+		resolve(slot);
+	}
+}
+
+void FrameCapture::captureFrame(int width, int height) {
+	collect(false);
+
+	std::string fileName;
+	if (!screenshotName.empty()) {
+		fileName = screenshotName;
+		screenshotName.clear();
+	}
+	else if (recording) {
+		char name[32];
+		snprintf(name, sizeof(name), "_%06u.png", recordFrame++);
+		fileName = recordPrefix + name;
+	}
+	if (fileName.empty()) return;
+
+	TRACE_SCOPE("FrameCapture::captureFrame");
+	Slot& slot = slots[next];
+	if (slot.fence) {
+		// Mindhárom PBO foglalt: a legrégebbit meg kell várni
+		glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		resolve(slot);
+	}
+	GLsizeiptr size = (GLsizeiptr)width * height * 4;
+	if (!slot.pbo) glGenBuffers(1, &slot.pbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	if (slot.size != size) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+		slot.size = size;
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr); // aszinkron: a PBO-ba ír
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.width = width;
+	slot.height = height;
+	slot.fileName = fileName;
+	next = (next + 1) % ringSize;
+}
+
+void FrameCapture::finish() {
+	collect(true);
+	if (encoders) encoders->wait();
+}
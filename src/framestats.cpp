@@ -0,0 +1,234 @@
+//=============================================================================================
+// Képkocka statisztikák és a hozzájuk tartozó szöveges overlay
+//=============================================================================================
+#include "framework.h"
+#include "framestats.h"
+#include <algorithm>
+#include <string.h>
+
+void FrameStats::beginFrame() {
+	// Az ebben a képkockában újra használt készlet két képkockával ezelőtti eredménye
+	int set = (int)(frames % 2);
+	for (GpuGroup& group : gpuGroups) {
+		if (!group.issued[set]) continue;
+		GLint available = 0;
+		glGetQueryObjectiv(group.queries[set], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available) {
+			GLuint64 ns = 0;
+			glGetQueryObjectui64v(group.queries[set], GL_QUERY_RESULT, &ns);
+			group.ms = ns / 1.0e6;
+		}
+		group.issued[set] = false;
+	}
+	drawCalls = 0;
+	vertices = 0;
+}
+
+void FrameStats::endDisplay() {
+	drawCallsLast = drawCalls;
+	verticesLast = vertices;
+}
+
+void FrameStats::endFrame() {
+	Clock::time_point now = Clock::now();
+	if (hasLastFrameEnd) {
+		history[historyNext] = std::chrono::duration<double, std::milli>(now - lastFrameEnd).count();
+		historyNext = (historyNext + 1) % historySize;
+		if (historyCount < historySize) historyCount++;
+	}
+	lastFrameEnd = now;
+	hasLastFrameEnd = true;
+	for (int i = 0; i < PHASE_COUNT; i++) {
+		cpuLast[i] = cpuAccum[i];
+		cpuAccum[i] = 0;
+	}
+	frames++;
+}
+
+bool FrameStats::beginGpu(const char* name) {
+	if (activeGroup >= 0) return false; // GL_TIME_ELAPSED lekérdezések nem ágyazhatók egymásba
+	int index = -1;
+	for (int i = 0; i < (int)gpuGroups.size(); i++) {
+		if (gpuGroups[i].name == name) { index = i; break; }
+	}
+	if (index < 0) {
+		if ((int)gpuGroups.size() >= maxGpuGroups) return false;
+		gpuGroups.emplace_back();
+		gpuGroups.back().name = name;
+		glGenQueries(2, gpuGroups.back().queries);
+		index = (int)gpuGroups.size() - 1;
+	}
+	int set = (int)(frames % 2);
+	glBeginQuery(GL_TIME_ELAPSED, gpuGroups[index].queries[set]);
+	gpuGroups[index].issued[set] = true;
+	activeGroup = index;
+	return true;
+}
+
+void FrameStats::endGpu() {
+	glEndQuery(GL_TIME_ELAPSED);
+	activeGroup = -1;
+}
+
+FrameStatsSnapshot FrameStats::snapshot() const {
+	FrameStatsSnapshot s;
+	s.frames = frames;
+	for (int i = 0; i < PHASE_COUNT; i++) s.cpuMs[i] = cpuLast[i];
+	s.drawCalls = drawCallsLast;
+	s.vertices = verticesLast;
+	if (historyCount > 0) {
+		s.frameMs = history[(historyNext + historySize - 1) % historySize];
+		std::vector<double> sorted(history, history + historyCount);
+		std::sort(sorted.begin(), sorted.end());
+		s.p50Ms = sorted[(size_t)(0.50 * (historyCount - 1) + 0.5)];
+		s.p99Ms = sorted[(size_t)(0.99 * (historyCount - 1) + 0.5)];
+	}
+	for (const GpuGroup& group : gpuGroups) s.gpu.push_back({ group.name, group.ms });
+	return s;
+}
+
+//---------------------------
+// Beépített 5x7-es bitmap font (oszloponként egy bájt, legalsó bit a legfelső sor)
+//---------------------------
+static const struct { char c; unsigned char columns[5]; } fontGlyphs[] = {
+	{ '0', { 0x3E, 0x51, 0x49, 0x45, 0x3E } }, { '1', { 0x00, 0x42, 0x7F, 0x40, 0x00 } },
+	{ '2', { 0x42, 0x61, 0x51, 0x49, 0x46 } }, { '3', { 0x21, 0x41, 0x45, 0x4B, 0x31 } },
+	{ '4', { 0x18, 0x14, 0x12, 0x7F, 0x10 } }, { '5', { 0x27, 0x45, 0x45, 0x45, 0x39 } },
+	{ '6', { 0x3C, 0x4A, 0x49, 0x49, 0x30 } }, { '7', { 0x01, 0x71, 0x09, 0x05, 0x03 } },
+	{ '8', { 0x36, 0x49, 0x49, 0x49, 0x36 } }, { '9', { 0x06, 0x49, 0x49, 0x29, 0x1E } },
+	{ 'A', { 0x7E, 0x11, 0x11, 0x11, 0x7E } }, { 'B', { 0x7F, 0x49, 0x49, 0x49, 0x36 } },
+	{ 'C', { 0x3E, 0x41, 0x41, 0x41, 0x22 } }, { 'D', { 0x7F, 0x41, 0x41, 0x22, 0x1C } },
+	{ 'E', { 0x7F, 0x49, 0x49, 0x49, 0x41 } }, { 'F', { 0x7F, 0x09, 0x09, 0x09, 0x01 } },
+	{ 'G', { 0x3E, 0x41, 0x49, 0x49, 0x7A } }, { 'H', { 0x7F, 0x08, 0x08, 0x08, 0x7F } },
+	{ 'I', { 0x00, 0x41, 0x7F, 0x41, 0x00 } }, { 'J', { 0x20, 0x40, 0x41, 0x3F, 0x01 } },
+	{ 'K', { 0x7F, 0x08, 0x14, 0x22, 0x41 } }, { 'L', { 0x7F, 0x40, 0x40, 0x40, 0x40 } },
+	{ 'M', { 0x7F, 0x02, 0x0C, 0x02, 0x7F } }, { 'N', { 0x7F, 0x04, 0x08, 0x10, 0x7F } },
+	{ 'O', { 0x3E, 0x41, 0x41, 0x41, 0x3E } }, { 'P', { 0x7F, 0x09, 0x09, 0x09, 0x06 } },
+	{ 'Q', { 0x3E, 0x41, 0x51, 0x21, 0x5E } }, { 'R', { 0x7F, 0x09, 0x19, 0x29, 0x46 } },
+	{ 'S', { 0x46, 0x49, 0x49, 0x49, 0x31 } }, { 'T', { 0x01, 0x01, 0x7F, 0x01, 0x01 } },
+	{ 'U', { 0x3F, 0x40, 0x40, 0x40, 0x3F } }, { 'V', { 0x1F, 0x20, 0x40, 0x20, 0x1F } },
+	{ 'W', { 0x3F, 0x40, 0x38, 0x40, 0x3F } }, { 'X', { 0x63, 0x14, 0x08, 0x14, 0x63 } },
+	{ 'Y', { 0x07, 0x08, 0x70, 0x08, 0x07 } }, { 'Z', { 0x61, 0x51, 0x49, 0x45, 0x43 } },
+	{ '.', { 0x00, 0x60, 0x60, 0x00, 0x00 } }, { ':', { 0x00, 0x36, 0x36, 0x00, 0x00 } },
+	{ '%', { 0x23, 0x13, 0x08, 0x64, 0x62 } }, { '/', { 0x20, 0x10, 0x08, 0x04, 0x02 } },
+	{ '-', { 0x08, 0x08, 0x08, 0x08, 0x08 } }, { '(', { 0x00, 0x1C, 0x22, 0x41, 0x00 } },
+	{ ')', { 0x00, 0x41, 0x22, 0x1C, 0x00 } }, { '=', { 0x14, 0x14, 0x14, 0x14, 0x14 } },
+	{ '_', { 0x40, 0x40, 0x40, 0x40, 0x40 } }, { '|', { 0x00, 0x00, 0x7F, 0x00, 0x00 } },
+};
+
+// overlay szöveg csúcspont árnyaló: xy = normalizált eszközkoordináta, zw = textúra koordináta
+static const char * overlayVertSource = R"(
+	#version 330
+	precision highp float;
+
+	layout(location = 0) in vec4 vtx;
+	out vec2 texCoord;
+
+	void main() {
+		texCoord = vtx.zw;
+		gl_Position = vec4(vtx.xy, 0, 1);
+	}
+)";
+
+// overlay szöveg pixel árnyaló: a font textúra vörös csatornája adja a maszkot
+static const char * overlayFragSource = R"(
+	#version 330
+	precision highp float;
+
+	uniform sampler2D fontTexture;
+	uniform vec3 color;
+	in vec2 texCoord;
+	out vec4 fragmentColor;
+
+	void main() {
+		if (texture(fontTexture, texCoord).r < 0.5) discard;
+		fragmentColor = vec4(color, 1);
+	}
+)";
+
+//---------------------------
+class StatsOverlay {
+//---------------------------
+	static const int cellWidth = 6, cellHeight = 8;		// egy karakter cella a font textúrában
+	static const int columns = 16, rows = 6;			// ASCII 32..127
+	static const int pixelScale = 2;					// képernyő pixel / font pixel
+
+	GPUProgram program;
+	Texture* font;
+	Geometry<vec4> quads;
+
+	static Texture* createFontTexture() {
+		int width = columns * cellWidth, height = rows * cellHeight;
+		std::vector<vec3> image(width * height, vec3(0, 0, 0));
+		for (const auto& glyph : fontGlyphs) {
+			int cell = glyph.c - 32;
+			int x0 = (cell % columns) * cellWidth, y0 = (cell / columns) * cellHeight;
+			for (int x = 0; x < 5; x++) for (int y = 0; y < 7; y++) {
+				if (glyph.columns[x] & (1 << y)) image[(y0 + y) * width + x0 + x] = vec3(1, 1, 1);
+			}
+		}
+		return new Texture(width, height, image);
+	}
+
+	void addText(const std::string& text, int px, int py, int windowWidth, int windowHeight) {
+		float texW = 1.0f / columns, texH = 1.0f / rows;
+		float w = 2.0f * cellWidth * pixelScale / windowWidth, h = 2.0f * cellHeight * pixelScale / windowHeight;
+		float x = 2.0f * px / windowWidth - 1, y = 1 - 2.0f * py / windowHeight;
+		for (char c : text) {
+			if (c >= 'a' && c <= 'z') c += 'A' - 'a';
+			if (c > 32 && c < 127) {
+				int cell = c - 32;
+				float u = (cell % columns) * texW, v = (cell / columns) * texH;
+				vec4 tl(x, y, u, v), tr(x + w, y, u + texW, v);
+				vec4 bl(x, y - h, u, v + texH), br(x + w, y - h, u + texW, v + texH);
+				std::vector<vec4>& vtx = quads.Vtx();
+				vtx.push_back(tl); vtx.push_back(bl); vtx.push_back(tr);
+				vtx.push_back(tr); vtx.push_back(bl); vtx.push_back(br);
+			}
+			x += w;
+		}
+	}
+
+public:
+	StatsOverlay() : program(overlayVertSource, overlayFragSource) {
+		font = createFontTexture();
+	}
+
+	void draw(const FrameStatsSnapshot& s, int windowWidth, int windowHeight) {
+		std::vector<std::string> lines;
+		char line[256];
+		snprintf(line, sizeof(line), "FPS %.1f  P50 %.2f MS  P99 %.2f MS", s.frameMs > 0 ? 1000.0 / s.frameMs : 0.0, s.p50Ms, s.p99Ms);
+		lines.push_back(line);
+		snprintf(line, sizeof(line), "CPU ANIM %.2f  DISPLAY %.2f  SWAP %.2f MS",
+			s.cpuMs[PHASE_TIME_ELAPSED], s.cpuMs[PHASE_DISPLAY], s.cpuMs[PHASE_SWAP]);
+		lines.push_back(line);
+		std::string gpu = "GPU";
+		for (const GpuGroupStats& group : s.gpu) {
+			snprintf(line, sizeof(line), "  %s %.3f", group.name.c_str(), group.ms);
+			gpu += line;
+		}
+		lines.push_back(gpu + " MS");
+		snprintf(line, sizeof(line), "DRAWS %u  VERTS %llu", s.drawCalls, s.vertices);
+		lines.push_back(line);
+
+		quads.Vtx().clear();
+		for (size_t i = 0; i < lines.size(); i++) {
+			addText(lines[i], 8, 8 + (int)i * (cellHeight + 2) * pixelScale, windowWidth, windowHeight);
+		}
+		if (quads.Vtx().empty()) return;
+		quads.updateGPU();
+
+		glViewport(0, 0, windowWidth, windowHeight);
+		program.Use();
+		font->Bind(0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST); // éles pixelek
+		program.setUniform(0, "fontTexture");
+		quads.Draw(&program, GL_TRIANGLES, vec3(0.2f, 1.0f, 0.2f));
+	}
+};
+
+void drawStatsOverlay(int windowWidth, int windowHeight) {
+	static StatsOverlay* overlay = nullptr; // első használatkor jön létre, amikor már van GL kontextus
+	if (!overlay) overlay = new StatsOverlay();
+	overlay->draw(frameStats().snapshot(), windowWidth, windowHeight);
+}
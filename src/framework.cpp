@@ -1,19 +1,24 @@
 //=============================================================================================
-// OpenGL keretrendszer: GLFW �s GLAD alap� implement�ci�
+// OpenGL keretrendszer: GLFW és GLAD alapú implementáció
 //=============================================================================================
 #include "framework.h"
+#include "shaderwatch.h"
+#include "capture.h"
+#include "textureloader.h"
+#include "texturemanager.h"
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
-// Keretrendszer �llapota
+// Keretrendszer állapota
 static int minorNumber = 3, majorNumber = 3;
 static int windowWidth = 600, windowHeight = 600;
 static const char * windowCaption = "Grafika";
 static GLFWwindow* window;
 static bool screenRefresh = true;
+static bool statsOverlay = false;
 static glApp * pApp = nullptr;
 
-// Esem�nykezel�k
+// Eseménykezelők
 static void error_callback(int error, const char* description) {
 	fprintf(stderr, "Error: %s\n", description);
 }
@@ -47,7 +52,7 @@ static void cursor_position_callback(GLFWwindow* window, double xpos, double ypo
 	pApp->onMouseMotion((int)xpos, (int)ypos);
 }
 
-// Applik�ci� konstruktora
+// Applikáció konstruktora
 glApp::glApp(unsigned int _majorNumber, unsigned int _minorNumber, unsigned int _windowWidth, unsigned int _windowHeight, const char * _windowCaption) {
 	majorNumber = _majorNumber;
 	minorNumber = _minorNumber;
@@ -57,7 +62,7 @@ glApp::glApp(unsigned int _majorNumber, unsigned int _minorNumber, unsigned int
 	pApp = this;
 }
 
-// Applik�ci� konstruktora
+// Applikáció konstruktora
 glApp::glApp(const char * _windowCaption) {
 	majorNumber = 3;
 	minorNumber = 3;
@@ -67,18 +72,28 @@ glApp::glApp(const char * _windowCaption) {
 	pApp = this;
 }
 
-// Rajzold �jra az alkalmaz�si ablakot
+// Rajzold újra az alkalmazási ablakot
 void glApp::refreshScreen() {
 	screenRefresh = true;
 }
 
-// Lek�rdez�ses klaviat�ra kezel�s
+// Statisztika overlay ki/be kapcsolása
+void glApp::showStats(bool visible) {
+	statsOverlay = visible;
+	screenRefresh = true;
+}
+
+bool glApp::statsVisible() {
+	return statsOverlay;
+}
+
+// Lekérdezéses klaviatúra kezelés
 bool pollKey(int key) {
 	return (glfwGetKey(window, key) == GLFW_PRESS);
 }
 
 int main(void) {
-	// Alkalmaz�i ablak l�trehoz�sa
+	// Alkalmazói ablak létrehozása
 	glfwSetErrorCallback(error_callback);
 	if (!glfwInit()) exit(EXIT_FAILURE);
 
@@ -92,7 +107,7 @@ int main(void) {
 		exit(EXIT_FAILURE);
 	}
 
-	// Esem�nykezel�k regisztr�l�sa
+	// Eseménykezelők regisztrálása
 	//glfwSetKeyCallback(window, key_callback);
 	glfwSetCharCallback(window, character_callback);
 	glfwSetMouseButtonCallback(window, mouse_button_callback);
@@ -101,26 +116,58 @@ int main(void) {
 
 	glfwMakeContextCurrent(window);
 	gladLoadGL();
+	loadGLExtensions(glfwGetProcAddress);
 	glfwSwapInterval(1);
 
-	// Applik�ci� inicializ�l�sa
+	// Applikáció inicializálása
 	pApp->onInitialization();
 	float startTime = 0;
 
-	// �zenetkezel� hurok
+	// Üzenetkezelő hurok
 	while (!glfwWindowShouldClose(window)) {
-		glfwPollEvents(); // esem�nyek lek�rdez�se �s reakci�
+		TRACE_SCOPE("frame");
+		glfwPollEvents(); // események lekérdezése és reakció
+
+		shaderHotReload().update(); // megváltozott shader fájlok cseréje, ha elkészült a fordításuk
+		if (textureLoader().update() > 0) { // betöltött textúrák következő adagja
+			screenRefresh = true;
+			textureManager().trim(); // a kész textúrák mérete most derült ki
+		}
 
-		float endTime = (float)glfwGetTime();    // id� lek�rdez�se
-		pApp->onTimeElapsed(startTime, endTime); // anim�ci�
+		float endTime = (float)glfwGetTime();    // idő lekérdezése
+		{
+			FrameStats::CpuTimer timer(frameStats(), PHASE_TIME_ELAPSED);
+			TRACE_SCOPE("onTimeElapsed");
+			pApp->onTimeElapsed(startTime, endTime); // animáció
+		}
 		startTime = endTime;
 
+		if (statsOverlay || frameCapture().isRecording()) screenRefresh = true; // folyamatos frissítés
 		if (screenRefresh) {
-			pApp->onDisplay();       // rajzol�s
-			glfwSwapBuffers(window); // buffercsere
-			screenRefresh = false;
+			screenRefresh = false; // az onDisplay-ből kért újabb frissítés is érvényes legyen
+			frameStats().beginFrame();
+			{
+				FrameStats::CpuTimer timer(frameStats(), PHASE_DISPLAY);
+				TRACE_SCOPE("onDisplay");
+				pApp->onDisplay();       // rajzolás
+			}
+			frameStats().endDisplay();
+			int framebufferWidth, framebufferHeight; // HiDPI kijelzőn nagyobb, mint az ablak mérete
+			glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+			frameCapture().captureFrame(framebufferWidth, framebufferHeight); // az overlay nélkül
+			if (statsOverlay) drawStatsOverlay(windowWidth, windowHeight);
+			{
+				FrameStats::CpuTimer timer(frameStats(), PHASE_SWAP);
+				TRACE_SCOPE("swap");
+				glfwSwapBuffers(window); // buffercsere
+			}
+			frameStats().endFrame();
 		}
 	}
+	frameCapture().finish();
+	TRACE_DUMP("trace.json");
+	textureManager().clear(); // a gyorsítótár textúrái még élő kontextusban törlődnek
+	glContextDestroyed = true; // a később futó (statikus) destruktorok már ne hívjanak GL-t
 	glfwDestroyWindow(window);
 	glfwTerminate();
 	exit(EXIT_SUCCESS);
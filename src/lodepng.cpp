@@ -33,12 +33,32 @@ Rename this file to lodepng.cpp to use it for C++, or to lodepng.c to use it for
 #ifdef LODEPNG_COMPILE_DISK
 #include <limits.h> /* LONG_MAX */
 #include <stdio.h> /* file handling */
+#if defined(LODEPNG_COMPILE_MMAP) && defined(LODEPNG_COMPILE_PNG) && defined(LODEPNG_COMPILE_DECODER) &&\
+    (defined(__unix__) || defined(__APPLE__))
+#define LODEPNG_MMAP /*files to decode are mapped rather than read*/
+#include <fcntl.h> /* open */
+#include <sys/mman.h> /* mmap, madvise */
+#include <sys/stat.h> /* fstat */
+#include <unistd.h> /* close */
+#endif /* LODEPNG_COMPILE_MMAP */
 #endif /* LODEPNG_COMPILE_DISK */
 
 #ifdef LODEPNG_COMPILE_ALLOCATORS
 #include <stdlib.h> /* allocations */
 #endif /* LODEPNG_COMPILE_ALLOCATORS */
 
+#ifdef LODEPNG_COMPILE_THREADS
+#include <atomic>
+#include <thread> /* parallel encoding */
+#include <vector>
+#endif /* LODEPNG_COMPILE_THREADS */
+
+#if defined(__cplusplus) && defined(ENABLE_TRACING)
+#include "trace.h" /* profiling scopes of the host application */
+#else
+#define TRACE_SCOPE(name)
+#endif /* ENABLE_TRACING */
+
 #if defined(_MSC_VER) && (_MSC_VER >= 1310) /*Visual Studio: A few warning types are not desired here.*/
 #pragma warning( disable : 4244 ) /*implicit conversions: not warned by gcc -Wall -Wextra and requires too much casts*/
 #pragma warning( disable : 4996 ) /*VS does not like fopen, but fopen_s is not standard C so unusable here*/
@@ -141,6 +161,69 @@ static size_t lodepng_strlen(const char* a) {
 #define LODEPNG_MAX(a, b) (((a) > (b)) ? (a) : (b))
 #define LODEPNG_MIN(a, b) (((a) < (b)) ? (a) : (b))
 
+/* ////////////////////////////////////////////////////////////////////////// */
+/* / SIMD support: runtime CPU feature detection                            / */
+/* ////////////////////////////////////////////////////////////////////////// */
+
+#ifdef LODEPNG_COMPILE_SIMD
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define LODEPNG_SIMD_X86
+#include <immintrin.h>
+/*each kernel is compiled for its own instruction set, and only called after the runtime check*/
+#define LODEPNG_TARGET(isa) __attribute__((target(isa)))
+#elif defined(__ARM_NEON) && (defined(__aarch64__) || defined(__arm__))
+#define LODEPNG_SIMD_NEON
+#include <arm_neon.h>
+/*the CRC32 instructions are optional in ARMv8.0: compiled for them, and detected at runtime on Linux*/
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_CRC32) || (defined(__GNUC__) && defined(__linux__)))
+#define LODEPNG_SIMD_ARM_CRC32
+#include <arm_acle.h>
+#ifdef __linux__
+#include <sys/auxv.h> /* getauxval */
+#endif
+#define LODEPNG_TARGET(isa) __attribute__((target(isa)))
+#ifdef __clang__
+#define LODEPNG_TARGET_ARM_CRC32 "crc"
+#else
+#define LODEPNG_TARGET_ARM_CRC32 "+crc"
+#endif
+#endif
+#endif
+
+unsigned lodepng_cpu_feature_mask = ~0u;
+
+unsigned lodepng_cpu_features(void) {
+  static int detected = -1; /*benign race: every thread computes the same value*/
+  if(detected < 0) {
+    unsigned features = 0;
+#if defined(LODEPNG_SIMD_X86)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse2")) features |= LCPU_SSE2;
+    if(__builtin_cpu_supports("ssse3")) features |= LCPU_SSSE3;
+    if(__builtin_cpu_supports("sse4.1")) features |= LCPU_SSE41;
+    if(__builtin_cpu_supports("avx2")) features |= LCPU_AVX2;
+    if(__builtin_cpu_supports("pclmul")) features |= LCPU_PCLMUL;
+#elif defined(LODEPNG_SIMD_NEON)
+    features |= LCPU_NEON; /*NEON is part of the target when __ARM_NEON is defined*/
+#if defined(__ARM_FEATURE_CRC32)
+    features |= LCPU_ARM_CRC32;
+#elif defined(LODEPNG_SIMD_ARM_CRC32)
+    if(getauxval(AT_HWCAP) & (1ul << 7)) features |= LCPU_ARM_CRC32; /*HWCAP_CRC32*/
+#endif
+#endif
+    detected = (int)features;
+  }
+  return (unsigned)detected & lodepng_cpu_feature_mask;
+}
+#endif /*LODEPNG_COMPILE_SIMD*/
+
+#if defined(LODEPNG_COMPILE_THREADS) && defined(LODEPNG_COMPILE_ENCODER)
+/*the num_threads settings of the encoder: 0 means one thread per hardware thread*/
+static unsigned lodepng_num_threads(unsigned requested) {
+  return requested ? requested : LODEPNG_MAX(1u, std::thread::hardware_concurrency());
+}
+#endif /*LODEPNG_COMPILE_THREADS && LODEPNG_COMPILE_ENCODER*/
+
 #if defined(LODEPNG_COMPILE_PNG) || defined(LODEPNG_COMPILE_DECODER)
 /* Safely check if adding two integers will overflow (no undefined
 behavior, compiler removing the code, etc...) and output result. */
@@ -385,6 +468,46 @@ unsigned lodepng_save_file(const unsigned char* buffer, size_t buffersize, const
   return 0;
 }
 
+#ifdef LODEPNG_MMAP
+/*Maps the whole file read-only into memory, to be read once from start to end. An empty file gives no mapping.
+Returns error code.*/
+static unsigned lodepng_map_file(const unsigned char** out, size_t* outsize, const char* filename) {
+  struct stat st;
+  void* map;
+  int fd = open(filename, O_RDONLY);
+  *out = 0;
+  *outsize = 0;
+  if(fd < 0) return 78;
+  /*only regular files can be mapped, and the size must fit in memory*/
+  if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (off_t)(size_t)st.st_size != st.st_size) {
+    close(fd);
+    return 78;
+  }
+  if(st.st_size == 0) {
+    close(fd);
+    return 0;
+  }
+  map = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); /*the mapping stays valid without the file descriptor*/
+  if(map == MAP_FAILED) return 78;
+#ifdef MADV_SEQUENTIAL /*not declared for strict ANSI C*/
+  /*only a hint: read ahead further, and drop the pages once they were read*/
+  madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif /*MADV_SEQUENTIAL*/
+  *out = (const unsigned char*)map;
+  *outsize = (size_t)st.st_size;
+  return 0;
+}
+
+static void lodepng_unmap_file(const unsigned char* data, size_t size) {
+  if(data) munmap((void*)data, size);
+}
+#endif /*LODEPNG_MMAP*/
+
+unsigned lodepng_write_file(void* file, const unsigned char* data, size_t size) {
+  return fwrite(data, 1, size, (FILE*)file) != size;
+}
+
 #endif /*LODEPNG_COMPILE_DISK*/
 
 /* ////////////////////////////////////////////////////////////////////////// */
@@ -406,37 +529,37 @@ static void LodePNGBitWriter_init(LodePNGBitWriter* writer, ucvector* data) {
   writer->bp = 0;
 }
 
-/*TODO: this ignores potential out of memory errors*/
-#define WRITEBIT(writer, bit){\
-  /* append new byte */\
-  if(((writer->bp) & 7u) == 0) {\
-    if(!ucvector_resize(writer->data, writer->data->size + 1)) return;\
-    writer->data->data[writer->data->size - 1] = 0;\
-  }\
-  (writer->data->data[writer->data->size - 1]) |= (bit << ((writer->bp) & 7u));\
-  ++writer->bp;\
-}
-
-/* LSB of value is written first, and LSB of bytes is used first */
+/* LSB of value is written first, and LSB of bytes is used first. nbits is at most 24.
+The output grows once per call, and the bits go in a byte at a time.
+TODO: this ignores potential out of memory errors */
 static void writeBits(LodePNGBitWriter* writer, unsigned value, size_t nbits) {
-  if(nbits == 1) { /* compiler should statically compile this case if nbits == 1 */
-    WRITEBIT(writer, value);
-  } else {
-    /* TODO: increase output size only once here rather than in each WRITEBIT */
-    size_t i;
-    for(i = 0; i != nbits; ++i) {
-      WRITEBIT(writer, (unsigned char)((value >> i) & 1));
-    }
+  unsigned used = writer->bp & 7u; /*bits already used in the last byte, 0 if a new byte is needed*/
+  size_t pos = used ? writer->data->size - 1u : writer->data->size;
+  size_t newsize = pos + ((used + nbits + 7u) >> 3u);
+  size_t i;
+  if(nbits == 0) return;
+  if(newsize > writer->data->size) {
+    size_t oldsize = writer->data->size;
+    if(!ucvector_resize(writer->data, newsize)) return;
+    for(i = oldsize; i != newsize; ++i) writer->data->data[i] = 0;
+  }
+  value &= (1u << nbits) - 1u;
+  value <<= used;
+  for(i = pos; i != newsize; ++i) {
+    writer->data->data[i] |= (unsigned char)(value & 255u);
+    value >>= 8u;
   }
+  writer->bp = (unsigned char)(writer->bp + nbits);
 }
 
-/* This one is to use for adding huffman symbol, the value bits are written MSB first */
+/* This one is to use for adding huffman symbol, the value bits are written MSB first. nbits is at most 16. */
 static void writeBitsReversed(LodePNGBitWriter* writer, unsigned value, size_t nbits) {
-  size_t i;
-  for(i = 0; i != nbits; ++i) {
-    /* TODO: increase output size only once here rather than in each WRITEBIT */
-    WRITEBIT(writer, (unsigned char)((value >> (nbits - 1u - i)) & 1u));
-  }
+  /*reverse the lowest 16 bits, then the nbits of interest are at the bottom*/
+  value = ((value >> 1u) & 0x5555u) | ((value & 0x5555u) << 1u);
+  value = ((value >> 2u) & 0x3333u) | ((value & 0x3333u) << 2u);
+  value = ((value >> 4u) & 0x0f0fu) | ((value & 0x0f0fu) << 4u);
+  value = ((value >> 8u) & 0x00ffu) | ((value & 0x00ffu) << 8u);
+  writeBits(writer, value >> (16u - nbits), nbits);
 }
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
@@ -563,11 +686,13 @@ static LODEPNG_INLINE unsigned readBits(LodePNGBitReader* reader, size_t nbits)
 }
 #endif /*LODEPNG_COMPILE_DECODER*/
 
+/*reverses the lowest num bits of bits, num is at most 16*/
 static unsigned reverseBits(unsigned bits, unsigned num) {
-  /*TODO: implement faster lookup table based version when needed*/
-  unsigned i, result = 0;
-  for(i = 0; i < num; i++) result |= ((bits >> (num - i - 1u)) & 1u) << i;
-  return result;
+  bits = ((bits >> 1u) & 0x5555u) | ((bits & 0x5555u) << 1u);
+  bits = ((bits >> 2u) & 0x3333u) | ((bits & 0x3333u) << 2u);
+  bits = ((bits >> 4u) & 0x0f0fu) | ((bits & 0x0f0fu) << 4u);
+  bits = ((bits >> 8u) & 0x00ffu) | ((bits & 0x00ffu) << 8u);
+  return num ? bits >> (16u - num) : 0u;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
@@ -1219,35 +1344,262 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
   return error;
 }
 
-/*inflate a block with dynamic of fixed Huffman tree. btype must be 1 or 2.*/
-static unsigned inflateHuffmanBlock(ucvector* out, LodePNGBitReader* reader,
-                                    unsigned btype, size_t max_output_size) {
+/*
+Room kept free at the end of the output buffer of inflate: the longest match plus the bytes that the word copies of
+the fast path may write past its end. Reserving it with the expected size also avoids the final reallocation.
+*/
+#define INFLATE_FAST_SLACK 288u
+
+/*
+The fast inflate path keeps a 64-bit bit buffer in a size_t, refilled with little endian word loads, so it is only
+compiled where size_t has 64 bits and the byte order is little endian. Elsewhere all blocks use the bit reader.
+*/
+#if (defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) &&\
+     defined(__SIZEOF_SIZE_T__) && (__SIZEOF_SIZE_T__ == 8)) || (defined(_MSC_VER) && defined(_WIN64))
+#define LODEPNG_INFLATE_FAST
+
+/*
+Bits of the first lookup of the fast path. The table is built per block from the HuffmanTree tables, each entry
+holds what one lookup decodes: bits 0-7 the amount of bits it consumes, bits 8-10 its kind, and bits 16-31 the
+literal(s), or for a length symbol the base length with its amount of extra bits in bits 11-15.
+*/
+#define FASTBITS 11u
+#define FAST_LITERAL 0u /*one literal*/
+#define FAST_LITERAL2 1u /*two literals whose codes together fit in FASTBITS*/
+#define FAST_LENGTH 2u
+#define FAST_END 3u
+#define FAST_SUBTABLE 4u /*code longer than FASTBITS, decoded with the tables of the HuffmanTree*/
+#define FAST_INVALID 5u
+#define FAST_KIND(entry) (((entry) >> 8u) & 7u)
+
+static unsigned inflateFastEntry(unsigned symbol, unsigned len) {
+  if(symbol <= 255) return len | (FAST_LITERAL << 8u) | (symbol << 16u);
+  if(symbol == 256) return len | (FAST_END << 8u);
+  if(symbol <= LAST_LENGTH_CODE_INDEX) {
+    unsigned index = symbol - FIRST_LENGTH_CODE_INDEX;
+    return len | (FAST_LENGTH << 8u) | (LENGTHEXTRA[index] << 11u) | (LENGTHBASE[index] << 16u);
+  }
+  return len | (FAST_INVALID << 8u); /*INVALIDSYMBOL, or the unused codes 286 and 287*/
+}
+
+/*like huffmanDecodeSymbol, for the bit buffer of the fast path. Returns the symbol and its length in len*/
+static LODEPNG_INLINE unsigned huffmanDecodeFast(const HuffmanTree* codetree, size_t bits, unsigned* len) {
+  unsigned code = (unsigned)bits & ((1u << FIRSTBITS) - 1u);
+  unsigned l = codetree->table_len[code];
+  unsigned value = codetree->table_value[code];
+  if(l > FIRSTBITS) {
+    value += (unsigned)(bits >> FIRSTBITS) & ((1u << (l - FIRSTBITS)) - 1u);
+    l = codetree->table_len[value];
+    value = codetree->table_value[value];
+  }
+  *len = l;
+  return value;
+}
+
+/*fast must have 1 << FASTBITS entries*/
+static void inflateFastTable(unsigned* fast, const HuffmanTree* tree_ll) {
+  unsigned i;
+  for(i = 0; i != (1u << FASTBITS); ++i) {
+    unsigned len, symbol = huffmanDecodeFast(tree_ll, i, &len);
+    /*the bits after FASTBITS are taken as 0 here, only correct if the code fits*/
+    fast[i] = len <= FASTBITS ? inflateFastEntry(symbol, len) : (FAST_SUBTABLE << 8u);
+  }
+  /*a literal followed by another literal whose code fits in the remaining bits becomes one entry. Going down,
+  fast[i >> l] still holds the single symbol entry, since i >> l < i (or i itself when it is 0)*/
+  for(i = (1u << FASTBITS); i-- > 0;) {
+    unsigned first = fast[i], second, len;
+    if(FAST_KIND(first) != FAST_LITERAL) continue;
+    second = fast[i >> (first & 255u)];
+    len = (first & 255u) + (second & 255u);
+    if(FAST_KIND(second) != FAST_LITERAL || len > FASTBITS) continue;
+    fast[i] = len | (FAST_LITERAL2 << 8u) | (first & 0xff0000u) | ((second & 0xff0000u) << 8u);
+  }
+}
+
+/*
+Copies a match of length bytes from distance bytes back to o, a word or two at a time. May write up to 15 bytes
+past the end of the match. Below 8 bytes distance, the first 8 bytes are copied one by one, after which the same
+word repeats every step bytes, the largest multiple of the distance up to 8.
+*/
+static LODEPNG_INLINE void inflateCopyMatch(unsigned char* o, size_t distance, size_t length) {
+  const unsigned char* src = o - distance;
+  const unsigned char* end = o + length;
+  size_t w0, w1;
+  if(distance >= 16) {
+    do {
+      lodepng_memcpy(&w0, src, 8);
+      lodepng_memcpy(&w1, src + 8, 8);
+      lodepng_memcpy(o, &w0, 8);
+      lodepng_memcpy(o + 8, &w1, 8);
+      src += 16;
+      o += 16;
+    } while(o < end);
+  } else if(distance >= 8) {
+    do {
+      lodepng_memcpy(&w0, src, 8);
+      lodepng_memcpy(o, &w0, 8);
+      src += 8;
+      o += 8;
+    } while(o < end);
+  } else {
+    size_t i, step = 8 - 8 % distance;
+    for(i = 0; i != 8; ++i) o[i] = src[i];
+    lodepng_memcpy(&w0, o, 8);
+    for(o += step; o < end; o += step) lodepng_memcpy(o, &w0, 8);
+  }
+}
+
+/*refills the bit buffer to 56-63 bits with one word load, needs 8 readable bytes at in*/
+#define INFLATE_REFILL() {\
+  size_t word;\
+  lodepng_memcpy(&word, in, 8);\
+  bitbuf |= word << bitsleft;\
+  in += (63u - bitsleft) >> 3u;\
+  bitsleft |= 56u;\
+}
+
+#define INFLATE_CONSUME(nbits) {\
+  bitbuf >>= (nbits);\
+  bitsleft -= (nbits);\
+}
+
+/*
+Decodes symbols of a Huffman block while at least 16 input bytes are left, with a bit buffer that is refilled
+once per literal/length symbol and once more before a distance. Each refill gives at least 56 bits: two literal
+lookups and a long length code with its extra bits need at most 11 + 15 + 5, a distance 15 + 13. The output
+keeps INFLATE_FAST_SLACK bytes free, so literals and matches are written without checks. Stops at the end code
+(setting done), near the end of the input or once the output reaches out_limit bytes, the bit reader then
+continues where it stopped. fast is the table of inflateFastTable for tree_ll.
+*/
+static unsigned inflateHuffmanFast(ucvector* out, LodePNGBitReader* reader, const unsigned* fast,
+                                   const HuffmanTree* tree_ll, const HuffmanTree* tree_d,
+                                   size_t out_limit, size_t max_output_size, int* done) {
   unsigned error = 0;
-  HuffmanTree tree_ll; /*the huffman tree for literal and length codes*/
-  HuffmanTree tree_d; /*the huffman tree for distance codes*/
-  const size_t reserved_size = 260; /* must be at least 258 for max length, and a few extra for adding a few extra literals */
-  int done = 0;
+  const unsigned char* in;
+  const unsigned char* in_end = reader->data + reader->size;
+  unsigned char* o;
+  unsigned char* o_end;
+  size_t bitbuf = 0;
+  unsigned bitsleft = 0;
+
+  if((reader->bp >> 3u) >= reader->size || reader->size - (reader->bp >> 3u) < 16) return 0;
+  in = reader->data + (reader->bp >> 3u);
+  INFLATE_REFILL();
+  INFLATE_CONSUME(reader->bp & 7u);
+  o = out->data + out->size;
+  o_end = out->data + out->allocsize;
+
+  while((size_t)(in_end - in) >= 16 && (size_t)(o - out->data) < out_limit) {
+    unsigned entry;
+    if((size_t)(o_end - o) < INFLATE_FAST_SLACK) {
+      out->size = (size_t)(o - out->data);
+      if(max_output_size && out->size > max_output_size) ERROR_BREAK(109); /*error, larger than max size*/
+      if(!ucvector_reserve(out, out->size + INFLATE_FAST_SLACK)) ERROR_BREAK(83); /*alloc fail*/
+      o = out->data + out->size;
+      o_end = out->data + out->allocsize;
+    }
+    INFLATE_REFILL();
+    entry = fast[bitbuf & ((1u << FASTBITS) - 1u)];
+    if(FAST_KIND(entry) <= FAST_LITERAL2) {
+      /*the second byte is past the end for a single literal, the slack allows writing it anyway*/
+      o[0] = (unsigned char)(entry >> 16u);
+      o[1] = (unsigned char)(entry >> 24u);
+      o += FAST_KIND(entry) + 1u;
+      INFLATE_CONSUME(entry & 255u);
+      entry = fast[bitbuf & ((1u << FASTBITS) - 1u)];
+      if(FAST_KIND(entry) <= FAST_LITERAL2) {
+        o[0] = (unsigned char)(entry >> 16u);
+        o[1] = (unsigned char)(entry >> 24u);
+        o += FAST_KIND(entry) + 1u;
+        INFLATE_CONSUME(entry & 255u);
+        continue;
+      }
+    }
+    if(FAST_KIND(entry) == FAST_SUBTABLE) {
+      unsigned len, symbol = huffmanDecodeFast(tree_ll, bitbuf, &len);
+      entry = inflateFastEntry(symbol, len);
+      if(FAST_KIND(entry) == FAST_LITERAL) {
+        *o++ = (unsigned char)symbol;
+        INFLATE_CONSUME(len);
+        continue;
+      }
+    }
+    if(FAST_KIND(entry) == FAST_LENGTH) {
+      unsigned len, code_d, numextrabits_d;
+      unsigned numextrabits_l = (entry >> 11u) & 31u;
+      size_t length, distance;
+      INFLATE_CONSUME(entry & 255u);
+      length = (entry >> 16u) + ((unsigned)bitbuf & ((1u << numextrabits_l) - 1u));
+      INFLATE_CONSUME(numextrabits_l);
 
-  if(!ucvector_reserve(out, out->size + reserved_size)) return 83; /*alloc fail*/
+      INFLATE_REFILL();
+      code_d = huffmanDecodeFast(tree_d, bitbuf, &len);
+      if(code_d > 29) {
+        if(code_d <= 31) {
+          ERROR_BREAK(18); /*error: invalid distance code (30-31 are never used)*/
+        } else /* if(code_d == INVALIDSYMBOL) */{
+          ERROR_BREAK(16); /*error: tried to read disallowed huffman symbol*/
+        }
+      }
+      INFLATE_CONSUME(len);
+      numextrabits_d = DISTANCEEXTRA[code_d];
+      distance = DISTANCEBASE[code_d] + ((unsigned)bitbuf & ((1u << numextrabits_d) - 1u));
+      INFLATE_CONSUME(numextrabits_d);
+
+      if(distance > (size_t)(o - out->data)) ERROR_BREAK(52); /*too long backward distance*/
+      inflateCopyMatch(o, distance, length);
+      o += length;
+    } else if(FAST_KIND(entry) == FAST_END) {
+      INFLATE_CONSUME(entry & 255u);
+      *done = 1;
+      break;
+    } else /*if(FAST_KIND(entry) == FAST_INVALID)*/ {
+      ERROR_BREAK(16); /*error: tried to read disallowed huffman symbol*/
+    }
+  }
 
-  HuffmanTree_init(&tree_ll);
-  HuffmanTree_init(&tree_d);
+  out->size = (size_t)(o - out->data);
+  reader->bp = (size_t)(in - reader->data) * 8u - bitsleft;
+  return error;
+}
 
-  if(btype == 1) error = getTreeInflateFixed(&tree_ll, &tree_d);
-  else /*if(btype == 2)*/ error = getTreeInflateDynamic(&tree_ll, &tree_d, reader);
+#undef INFLATE_REFILL
+#undef INFLATE_CONSUME
+#endif /*LODEPNG_INFLATE_FAST*/
 
+/*
+Decodes symbols of a Huffman block until its end code (setting done), until fewer than margin bytes of input are
+left, or until the output reaches out_limit bytes. With margin 0 it decodes to the end of the input, where reading
+past it is an error. fast is the table of inflateFastTable for tree_ll, or 0 without LODEPNG_INFLATE_FAST.
+*/
+static unsigned inflateHuffmanSymbols(ucvector* out, LodePNGBitReader* reader, const unsigned* fast,
+                                      const HuffmanTree* tree_ll, const HuffmanTree* tree_d, size_t margin,
+                                      size_t out_limit, size_t max_output_size, int* done) {
+  unsigned error = 0;
+  const size_t reserved_size = 260; /* must be at least 258 for max length, and a few extra for adding a few extra literals */
 
-  while(!error && !done) /*decode all symbols until end reached, breaks at end code*/ {
+  if(!ucvector_reserve(out, out->size + reserved_size)) return 83; /*alloc fail*/
+#ifdef LODEPNG_INFLATE_FAST
+  /*most of the block, this loop only decodes the last symbols near the end of the input*/
+  error = inflateHuffmanFast(out, reader, fast, tree_ll, tree_d, out_limit, max_output_size, done);
+  if(!error && !*done && out->allocsize - out->size < reserved_size) {
+    if(!ucvector_reserve(out, out->size + reserved_size)) error = 83; /*alloc fail*/
+  }
+#endif /*LODEPNG_INFLATE_FAST*/
+  (void)fast;
+
+  while(!error && !*done) /*decode all symbols until end reached, breaks at end code*/ {
     /*code_ll is literal, length or end code*/
     unsigned code_ll;
+    if(out->size >= out_limit || reader->size - (reader->bp >> 3u) < margin) break;
     /* ensure enough bits for 2 huffman code reads (15 bits each): if the first is a literal, a second literal is read at once. This
     appears to be slightly faster, than ensuring 20 bits here for 1 huffman symbol and the potential 5 extra bits for the length symbol.*/
     ensureBits32(reader, 30);
-    code_ll = huffmanDecodeSymbol(reader, &tree_ll);
+    code_ll = huffmanDecodeSymbol(reader, tree_ll);
     if(code_ll <= 255) {
       /*slightly faster code path if multiple literals in a row*/
       out->data[out->size++] = (unsigned char)code_ll;
-      code_ll = huffmanDecodeSymbol(reader, &tree_ll);
+      code_ll = huffmanDecodeSymbol(reader, tree_ll);
     }
     if(code_ll <= 255) /*literal symbol*/ {
       out->data[out->size++] = (unsigned char)code_ll;
@@ -1269,7 +1621,7 @@ static unsigned inflateHuffmanBlock(ucvector* out, LodePNGBitReader* reader,
 
       /*part 3: get distance code*/
       ensureBits32(reader, 28); /* up to 15 for the huffman symbol, up to 13 for the extra bits */
-      code_d = huffmanDecodeSymbol(reader, &tree_d);
+      code_d = huffmanDecodeSymbol(reader, tree_d);
       if(code_d > 29) {
         if(code_d <= 31) {
           ERROR_BREAK(18); /*error: invalid distance code (30-31 are never used)*/
@@ -1303,7 +1655,7 @@ static unsigned inflateHuffmanBlock(ucvector* out, LodePNGBitReader* reader,
         lodepng_memcpy(out->data + start, out->data + backward, length);
       }
     } else if(code_ll == 256) {
-      done = 1; /*end code, finish the loop*/
+      *done = 1; /*end code, finish the loop*/
     } else /*if(code_ll == INVALIDSYMBOL)*/ {
       ERROR_BREAK(16); /*error: tried to read disallowed huffman symbol*/
     }
@@ -1322,6 +1674,34 @@ static unsigned inflateHuffmanBlock(ucvector* out, LodePNGBitReader* reader,
     }
   }
 
+  return error;
+}
+
+/*inflate a block with dynamic of fixed Huffman tree. btype must be 1 or 2.*/
+static unsigned inflateHuffmanBlock(ucvector* out, LodePNGBitReader* reader,
+                                    unsigned btype, size_t max_output_size) {
+  unsigned error = 0;
+  HuffmanTree tree_ll; /*the huffman tree for literal and length codes*/
+  HuffmanTree tree_d; /*the huffman tree for distance codes*/
+  unsigned* fast = 0;
+  int done = 0;
+
+  HuffmanTree_init(&tree_ll);
+  HuffmanTree_init(&tree_d);
+
+  if(btype == 1) error = getTreeInflateFixed(&tree_ll, &tree_d);
+  else /*if(btype == 2)*/ error = getTreeInflateDynamic(&tree_ll, &tree_d, reader);
+
+#ifdef LODEPNG_INFLATE_FAST
+  if(!error) {
+    fast = (unsigned*)lodepng_malloc((1u << FASTBITS) * sizeof(unsigned));
+    if(!fast) error = 83; /*alloc fail*/
+    else inflateFastTable(fast, &tree_ll);
+  }
+#endif /*LODEPNG_INFLATE_FAST*/
+  if(!error) error = inflateHuffmanSymbols(out, reader, fast, &tree_ll, &tree_d, 0, (size_t)(-1), max_output_size, &done);
+
+  lodepng_free(fast);
   HuffmanTree_cleanup(&tree_ll);
   HuffmanTree_cleanup(&tree_d);
 
@@ -1426,20 +1806,32 @@ static unsigned inflatev(ucvector* out, const unsigned char* in, size_t insize,
 
 static const unsigned MAX_SUPPORTED_DEFLATE_LENGTH = 258;
 
-/*search the index in the array, that has the largest value smaller than or equal to the given value,
-given array must be sorted (if no value is smaller, it returns the size of the given array)*/
-static size_t searchCodeIndex(const unsigned* array, size_t array_size, size_t value) {
-  /*binary search (only small gain over linear). TODO: use CPU log2 instruction for getting symbols instead*/
-  size_t left = 1;
-  size_t right = array_size - 1;
+/*index of the highest set bit, i must be nonzero and below 65536*/
+static unsigned highBit16(unsigned i) {
+  unsigned result = 0;
+  if(i >= 256u) { result += 8u; i >>= 8u; }
+  if(i >= 16u) { result += 4u; i >>= 4u; }
+  if(i >= 4u) { result += 2u; i >>= 2u; }
+  if(i >= 2u) { result += 1u; }
+  return result;
+}
 
-  while(left <= right) {
-    size_t mid = (left + right) >> 1;
-    if(array[mid] >= value) right = mid - 1;
-    else left = mid + 1;
-  }
-  if(left >= array_size || array[left] > value) left--;
-  return left;
+/*the index in LENGTHBASE of the code for a length of 3-258: past the first 8 codes, every power of two range
+of length - 3 is split into 4 codes*/
+static unsigned lengthCode(size_t length) {
+  unsigned x = (unsigned)length - 3u, n;
+  if(length == 258) return 28;
+  if(x < 8u) return x;
+  n = highBit16(x);
+  return 4u * (n - 1u) + ((x >> (n - 2u)) & 3u);
+}
+
+/*the index in DISTANCEBASE of the code for a distance of 1-32768, 2 codes per power of two range*/
+static unsigned distanceCode(size_t distance) {
+  unsigned x = (unsigned)distance - 1u, n;
+  if(x < 4u) return x;
+  n = highBit16(x);
+  return 2u * n + ((x >> (n - 1u)) & 1u);
 }
 
 static void addLengthDistance(uivector* values, size_t length, size_t distance) {
@@ -1449,9 +1841,9 @@ static void addLengthDistance(uivector* values, size_t length, size_t distance)
   257-285: length/distance pair (length code, followed by extra length bits, distance code, extra distance bits)
   286-287: invalid*/
 
-  unsigned length_code = (unsigned)searchCodeIndex(LENGTHBASE, 29, length);
+  unsigned length_code = lengthCode(length);
   unsigned extra_length = (unsigned)(length - LENGTHBASE[length_code]);
-  unsigned dist_code = (unsigned)searchCodeIndex(DISTANCEBASE, 30, distance);
+  unsigned dist_code = distanceCode(distance);
   unsigned extra_distance = (unsigned)(distance - DISTANCEBASE[dist_code]);
 
   size_t pos = values->size;
@@ -1465,8 +1857,7 @@ static void addLengthDistance(uivector* values, size_t length, size_t distance)
   }
 }
 
-/*3 bytes of data get encoded into two bytes. The hash cannot use more than 3
-bytes as input because 3 is the minimum match length for deflate*/
+/*3 bytes of data get hashed into two bytes, see getHash (4 bytes for level 1, see getHash4)*/
 static const unsigned HASH_NUM_VALUES = 65536;
 static const unsigned HASH_BIT_MASK = 65535; /*HASH_NUM_VALUES - 1, but C90 does not like that as initializer*/
 
@@ -1483,8 +1874,9 @@ typedef struct Hash {
   unsigned short* zeros; /*length of zeros streak, used as a second hash chain*/
 } Hash;
 
+static void hash_reset(Hash* hash, unsigned windowsize);
+
 static unsigned hash_init(Hash* hash, unsigned windowsize) {
-  unsigned i;
   hash->head = (int*)lodepng_malloc(sizeof(int) * HASH_NUM_VALUES);
   hash->val = (int*)lodepng_malloc(sizeof(int) * windowsize);
   hash->chain = (unsigned short*)lodepng_malloc(sizeof(unsigned short) * windowsize);
@@ -1497,6 +1889,14 @@ static unsigned hash_init(Hash* hash, unsigned windowsize) {
     return 83; /*alloc fail*/
   }
 
+  hash_reset(hash, windowsize);
+  return 0;
+}
+
+/*empties the hash table, as if nothing was encoded yet*/
+static void hash_reset(Hash* hash, unsigned windowsize) {
+  unsigned i;
+
   /*initialize hash table*/
   for(i = 0; i != HASH_NUM_VALUES; ++i) hash->head[i] = -1;
   for(i = 0; i != windowsize; ++i) hash->val[i] = -1;
@@ -1504,8 +1904,6 @@ static unsigned hash_init(Hash* hash, unsigned windowsize) {
 
   for(i = 0; i <= MAX_SUPPORTED_DEFLATE_LENGTH; ++i) hash->headz[i] = -1;
   for(i = 0; i != windowsize; ++i) hash->chainz[i] = i; /*same value as index indicates uninitialized*/
-
-  return 0;
 }
 
 static void hash_cleanup(Hash* hash) {
@@ -1520,16 +1918,20 @@ static void hash_cleanup(Hash* hash) {
 
 
 
+/*multiplicative hash of the 4 bytes at data: the top half of the product depends on all of them*/
+static unsigned getHash4(const unsigned char* data) {
+  unsigned word = (unsigned)data[0] | ((unsigned)data[1] << 8u) | ((unsigned)data[2] << 16u) | ((unsigned)data[3] << 24u);
+  return ((word * 2654435761u) >> 16u) & HASH_BIT_MASK;
+}
+
 static unsigned getHash(const unsigned char* data, size_t size, size_t pos) {
   unsigned result = 0;
   if(pos + 2 < size) {
-    /*A simple shift and xor hash is used. Since the data of PNGs is dominated
-    by zeroes due to the filters, a better hash does not have a significant
-    effect on speed in traversing the chain, and causes more time spend on
-    calculating the hash.*/
-    result ^= ((unsigned)data[pos + 0] << 0u);
-    result ^= ((unsigned)data[pos + 1] << 4u);
-    result ^= ((unsigned)data[pos + 2] << 8u);
+    /*the 3 bytes of the minimum match length, so every match of length 3 is on the chain. A multiplicative hash
+    like getHash4 uses all 16 bits, a shift and xor of the bytes only had 4096 values and crowded the chains with
+    unrelated positions. Only zeros hash to 0, apart from collisions, which the zeros chains rely on.*/
+    unsigned word = (unsigned)data[pos] | ((unsigned)data[pos + 1] << 8u) | ((unsigned)data[pos + 2] << 16u);
+    return ((word * 2654435761u) >> 16u) & HASH_BIT_MASK;
   } else {
     size_t amount, i;
     if(pos >= size) return 0;
@@ -1539,14 +1941,49 @@ static unsigned getHash(const unsigned char* data, size_t size, size_t pos) {
   return result & HASH_BIT_MASK;
 }
 
+/*the byte index of the lowest set byte of a nonzero word, when words are loaded little endian*/
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define LODEPNG_LOWEST_BYTE(x) ((size_t)__builtin_ctzll(x) >> 3u)
+#endif
+
+/*
+The number of equal bytes at a and b, at most end - a. Most candidates on a hash chain differ early while a
+match that is taken tends to be long, so the bytes are compared a word at a time, and the first differing byte
+is found from the XOR of the words. b may be before a and overlap it.
+*/
+static LODEPNG_INLINE size_t matchLength(const unsigned char* a, const unsigned char* b,
+                                         const unsigned char* end) {
+  const unsigned char* start = a;
+  while((size_t)(end - a) >= sizeof(size_t)) {
+    size_t x, y;
+    lodepng_memcpy(&x, a, sizeof(size_t));
+    lodepng_memcpy(&y, b, sizeof(size_t));
+    if(x != y) {
+#ifdef LODEPNG_LOWEST_BYTE
+      return (size_t)(a - start) + LODEPNG_LOWEST_BYTE(x ^ y);
+#else
+      break;
+#endif
+    }
+    a += sizeof(size_t);
+    b += sizeof(size_t);
+  }
+  while(a != end && *a == *b) {
+    ++a;
+    ++b;
+  }
+  return (size_t)(a - start);
+}
+
+/*compared against by countZeros*/
+static const unsigned char LZ77_ZEROS[258] = {0};
+
 static unsigned countZeros(const unsigned char* data, size_t size, size_t pos) {
   const unsigned char* start = data + pos;
   const unsigned char* end = start + MAX_SUPPORTED_DEFLATE_LENGTH;
   if(end > data + size) end = data + size;
-  data = start;
-  while(data != end && *data == 0) ++data;
-  /*subtracting two addresses returned as 32-bit number (max value is MAX_SUPPORTED_DEFLATE_LENGTH)*/
-  return (unsigned)(data - start);
+  /*returned as 32-bit number (max value is MAX_SUPPORTED_DEFLATE_LENGTH)*/
+  return (unsigned)matchLength(start, LZ77_ZEROS, end);
 }
 
 /*wpos = pos & (windowsize - 1)*/
@@ -1560,6 +1997,107 @@ static void updateHashChain(Hash* hash, size_t wpos, unsigned hashval, unsigned
   hash->headz[numzeros] = (int)wpos;
 }
 
+/*the LZ77 and block parameters, from the compression level or from the individual settings*/
+typedef struct DeflateParams {
+  unsigned use_lz77, windowsize, minmatch, nicematch, lazymatching;
+  unsigned maxchainlength; /*how many positions of the hash chain are tried*/
+  unsigned maxlazymatch; /*a match of at least this length is taken without trying the next position*/
+  unsigned greedy; /*level 1: a single probe per position, see encodeLZ77Greedy*/
+  unsigned optimal; /*LCL_OPTIMAL: the number of optimal parsing passes, see encodeLZ77Optimal. 0 otherwise*/
+  size_t minblocksize, maxblocksize; /*dynamic blocks are an 8th of the input, within these limits*/
+} DeflateParams;
+
+static void deflateParams(DeflateParams* params, const LodePNGCompressSettings* settings) {
+  /*per level: max chain length, nicematch, max lazy match (0: no lazy matching). Every level uses the full 32 KiB
+  window: with a limited chain it costs little time, and a smaller window made some levels larger than the one
+  below them. The output gets smaller with every level, see bench/png_encode.cpp*/
+  static const unsigned presets[10][3] = {
+    {0, 0, 0}, {0, 0, 0}, {4, 16, 0}, {8, 32, 0}, {16, 32, 0},
+    {16, 32, 8}, {32, 64, 16}, {64, 128, 32}, {256, 258, 64}, {4096, 258, 258}
+  };
+  params->use_lz77 = settings->use_lz77;
+  params->greedy = 0;
+  params->optimal = 0;
+  params->minblocksize = 65536;
+  params->maxblocksize = 262144;
+  if(settings->level) {
+    unsigned level = LODEPNG_MIN(settings->level, 9u);
+    params->windowsize = 32768;
+    params->minmatch = 3;
+    params->maxchainlength = presets[level][0];
+    params->nicematch = presets[level][1];
+    params->lazymatching = presets[level][2] != 0;
+    params->maxlazymatch = presets[level][2];
+    params->greedy = level == 1;
+    if(level <= 2) {
+      /*fewer trees to build, at most a few percent larger*/
+      params->minblocksize = 262144;
+      params->maxblocksize = 1048576;
+    }
+    if(settings->level > 9) {
+      /*the chain is searched much further, every match length is an option. Each block is split further by
+      deflateOptimal itself, so they only bound the memory used and are the unit of parallelism*/
+      params->maxchainlength = 8192;
+      params->nicematch = MAX_SUPPORTED_DEFLATE_LENGTH;
+      params->optimal = settings->iterations ? settings->iterations : 1;
+      params->minblocksize = 262144;
+      params->maxblocksize = 1048576;
+    }
+  } else {
+    params->windowsize = settings->windowsize;
+    params->minmatch = settings->minmatch;
+    params->nicematch = settings->nicematch;
+    params->lazymatching = settings->lazymatching;
+    /*for large window lengths, assume the user wants no compression loss. Otherwise, max hash chain length speedup.*/
+    params->maxchainlength = settings->windowsize >= 8192 ? settings->windowsize : settings->windowsize / 8u;
+    params->maxlazymatch = settings->windowsize >= 8192 ? MAX_SUPPORTED_DEFLATE_LENGTH : 64;
+  }
+}
+
+static size_t deflateBlockSize(size_t insize, const DeflateParams* params) {
+  /*on PNGs, deflate blocks of 65-262k seem to give most dense encoding*/
+  size_t blocksize = insize / 8u + 8;
+  if(blocksize < params->minblocksize) blocksize = params->minblocksize;
+  if(blocksize > params->maxblocksize) blocksize = params->maxblocksize;
+  return blocksize;
+}
+
+/*
+The fast path of compression level 1: only the most recent position with the same 4 byte hash is tried, the match
+is taken as it is (no lazy matching), and the positions inside a match are not hashed. Only hash->head is used.
+Old entries may point to any position within the window: the bytes are compared, so they only cost a miss.
+*/
+static unsigned encodeLZ77Greedy(uivector* out, Hash* hash, const unsigned char* in, size_t inpos, size_t insize,
+                                 unsigned windowsize) {
+  size_t pos = inpos;
+  while(pos < insize) {
+    size_t length = 0, distance = 0;
+    if(pos + 4 <= insize) {
+      unsigned hashval = getHash4(&in[pos]);
+      size_t wpos = pos & (windowsize - 1u);
+      int candidate = hash->head[hashval];
+      hash->head[hashval] = (int)wpos;
+      if(candidate >= 0) {
+        distance = (wpos - (size_t)candidate) & (windowsize - 1u);
+        if(distance == 0) distance = windowsize;
+        if(distance <= pos) {
+          const unsigned char* back = &in[pos - distance];
+          size_t maxlength = LODEPNG_MIN(insize - pos, (size_t)MAX_SUPPORTED_DEFLATE_LENGTH);
+          length = matchLength(&in[pos], back, &in[pos + maxlength]);
+        }
+      }
+    }
+    if(length >= 4) {
+      addLengthDistance(out, length, distance);
+      pos += length;
+    } else {
+      if(!uivector_push_back(out, in[pos])) return 83; /*alloc fail*/
+      ++pos;
+    }
+  }
+  return 0;
+}
+
 /*
 LZ77-encode the data. Return value is error code. The input are raw bytes, the output
 is in the form of unsigned integers with codes representing for example literal bytes, or
@@ -1570,13 +2108,15 @@ the "dictionary". A brute force search through all possible distances would be s
 this hash technique is one out of several ways to speed this up.
 */
 static unsigned encodeLZ77(uivector* out, Hash* hash,
-                           const unsigned char* in, size_t inpos, size_t insize, unsigned windowsize,
-                           unsigned minmatch, unsigned nicematch, unsigned lazymatching) {
+                           const unsigned char* in, size_t inpos, size_t insize, const DeflateParams* params) {
   size_t pos;
   unsigned i, error = 0;
-  /*for large window lengths, assume the user wants no compression loss. Otherwise, max hash chain length speedup.*/
-  unsigned maxchainlength = windowsize >= 8192 ? windowsize : windowsize / 8u;
-  unsigned maxlazymatch = windowsize >= 8192 ? MAX_SUPPORTED_DEFLATE_LENGTH : 64;
+  unsigned windowsize = params->windowsize;
+  unsigned minmatch = params->minmatch;
+  unsigned nicematch = params->nicematch;
+  unsigned lazymatching = params->lazymatching;
+  unsigned maxchainlength = params->maxchainlength;
+  unsigned maxlazymatch = params->maxlazymatch;
 
   unsigned usezeros = 1; /*not sure if setting it to false for windowsize < 8192 is better or worse*/
   unsigned numzeros = 0;
@@ -1595,6 +2135,7 @@ static unsigned encodeLZ77(uivector* out, Hash* hash,
   if((windowsize & (windowsize - 1)) != 0) return 90; /*error: must be power of two*/
 
   if(nicematch > MAX_SUPPORTED_DEFLATE_LENGTH) nicematch = MAX_SUPPORTED_DEFLATE_LENGTH;
+  if(params->greedy) return encodeLZ77Greedy(out, hash, in, inpos, insize, windowsize);
 
   for(pos = inpos; pos < insize; ++pos) {
     size_t wpos = pos & (windowsize - 1); /*position for in 'circular' hash buffers*/
@@ -1640,10 +2181,8 @@ static unsigned encodeLZ77(uivector* out, Hash* hash,
           foreptr += skip;
         }
 
-        while(foreptr != lastptr && *backptr == *foreptr) /*maximum supported length by deflate is max length*/ {
-          ++backptr;
-          ++foreptr;
-        }
+        /*maximum supported length by deflate is max length*/
+        foreptr += matchLength(foreptr, backptr, lastptr);
         current_length = (unsigned)(foreptr - &in[pos]);
 
         if(current_length > length) {
@@ -1758,12 +2297,41 @@ write the lz77-encoded data, which has lit, len and dist codes, to compressed st
 tree_ll: the tree for lit and len codes.
 tree_d: the tree for distance codes.
 */
-static void writeLZ77data(LodePNGBitWriter* writer, const uivector* lz77_encoded,
-                          const HuffmanTree* tree_ll, const HuffmanTree* tree_d) {
-  size_t i = 0;
+/*Writes the symbols with the given trees. This is the bulk of the output, so instead of going through writeBits
+for every code, the bits are collected in a local accumulator and stored a byte at a time into memory reserved
+up front: a literal takes at most 15 bits and a length/distance pair (4 values) at most 48, so 2 bytes per value
+is enough. Returns error code.*/
+static unsigned writeLZ77data(LodePNGBitWriter* writer, const uivector* lz77_encoded,
+                              const HuffmanTree* tree_ll, const HuffmanTree* tree_d) {
+  unsigned codes_ll[NUM_DEFLATE_CODE_SYMBOLS];
+  unsigned codes_d[NUM_DISTANCE_SYMBOLS];
+  unsigned used = writer->bp & 7u; /*bits already used in the last byte, 0 if a new byte is needed*/
+  size_t pos = used ? writer->data->size - 1u : writer->data->size;
+  unsigned bits = used ? writer->data->data[pos] : 0u; /*bits not yet stored, the lowest come first*/
+  unsigned numbits = used;
+  unsigned char* data;
+  size_t i;
+
+  if(lz77_encoded->size == 0) return 0;
+  if(!ucvector_reserve(writer->data, pos + lz77_encoded->size * 2u + 8u)) return 83; /*alloc fail*/
+  data = writer->data->data;
+  for(i = 0; i != tree_ll->numcodes; ++i) codes_ll[i] = reverseBits(tree_ll->codes[i], tree_ll->lengths[i]);
+  for(i = 0; i != tree_d->numcodes; ++i) codes_d[i] = reverseBits(tree_d->codes[i], tree_d->lengths[i]);
+
+/*numbits is below 8 between uses, so with at most 16 bits added the accumulator never overflows*/
+#define LZ77_PUT_BITS(value, nbits) {\
+  bits |= (unsigned)(value) << numbits;\
+  numbits += (nbits);\
+  while(numbits >= 8u) {\
+    data[pos++] = (unsigned char)(bits & 255u);\
+    bits >>= 8u;\
+    numbits -= 8u;\
+  }\
+}
+
   for(i = 0; i != lz77_encoded->size; ++i) {
     unsigned val = lz77_encoded->data[i];
-    writeBitsReversed(writer, tree_ll->codes[val], tree_ll->lengths[val]);
+    LZ77_PUT_BITS(codes_ll[val], tree_ll->lengths[val]);
     if(val > 256) /*for a length code, 3 more things have to be added*/ {
       unsigned length_index = val - FIRST_LENGTH_CODE_INDEX;
       unsigned n_length_extra_bits = LENGTHEXTRA[length_index];
@@ -1775,41 +2343,59 @@ static void writeLZ77data(LodePNGBitWriter* writer, const uivector* lz77_encoded
       unsigned n_distance_extra_bits = DISTANCEEXTRA[distance_index];
       unsigned distance_extra_bits = lz77_encoded->data[++i];
 
-      writeBits(writer, length_extra_bits, n_length_extra_bits);
-      writeBitsReversed(writer, tree_d->codes[distance_code], tree_d->lengths[distance_code]);
-      writeBits(writer, distance_extra_bits, n_distance_extra_bits);
+      LZ77_PUT_BITS(length_extra_bits, n_length_extra_bits);
+      LZ77_PUT_BITS(codes_d[distance_code], tree_d->lengths[distance_code]);
+      LZ77_PUT_BITS(distance_extra_bits, n_distance_extra_bits);
     }
   }
+#undef LZ77_PUT_BITS
+
+  if(numbits) data[pos++] = (unsigned char)bits;
+  writer->data->size = pos;
+  writer->bp = (unsigned char)numbits;
+  return 0;
 }
 
 /*Deflate for a block of type "dynamic", that is, with freely, optimally, created huffman trees*/
-static unsigned deflateDynamic(LodePNGBitWriter* writer, Hash* hash,
-                               const unsigned char* data, size_t datapos, size_t dataend,
-                               const LodePNGCompressSettings* settings, unsigned final) {
-  unsigned error = 0;
-
-  /*
-  A block is compressed as follows: The PNG data is lz77 encoded, resulting in
-  literal bytes and length/distance pairs. This is then huffman compressed with
-  two huffman trees. One huffman tree is used for the lit and len values ("ll"),
-  another huffman tree is used for the dist values ("d"). These two trees are
-  stored using their code lengths, and to compress even more these code lengths
-  are also run-length encoded and huffman compressed. This gives a huffman tree
-  of code lengths "cl". The code lengths used to describe this third tree are
-  the code length code lengths ("clcl").
-  */
+/*counts the lit/len and dist codes of lz77 encoded data, plus the one end code*/
+static void lz77Frequencies(unsigned* frequencies_ll, unsigned* frequencies_d, const unsigned* lz77, size_t size) {
+  size_t i;
+  lodepng_memset(frequencies_ll, 0, 286 * sizeof(*frequencies_ll));
+  lodepng_memset(frequencies_d, 0, 30 * sizeof(*frequencies_d));
+  for(i = 0; i != size; ++i) {
+    unsigned symbol = lz77[i];
+    ++frequencies_ll[symbol];
+    if(symbol > 256) {
+      unsigned dist = lz77[i + 2];
+      ++frequencies_d[dist];
+      i += 3;
+    }
+  }
+  frequencies_ll[256] = 1; /*there will be exactly 1 end code, at the end of the block*/
+}
+
+/*makes both huffman trees of a dynamic block, one for the lit and len codes, one for the dist codes*/
+static unsigned makeDynamicTrees(HuffmanTree* tree_ll, HuffmanTree* tree_d,
+                                 const unsigned* frequencies_ll, const unsigned* frequencies_d) {
+  unsigned error = HuffmanTree_makeFromFrequencies(tree_ll, frequencies_ll, 257, 286, 15);
+  /*2, not 1, is chosen for mincodes: some buggy PNG decoders require at least 2 symbols in the dist tree*/
+  if(!error) error = HuffmanTree_makeFromFrequencies(tree_d, frequencies_d, 2, 30, 15);
+  return error;
+}
 
-  /*The lz77 encoded data, represented with integers since there will also be length and distance codes in it*/
-  uivector lz77_encoded;
-  HuffmanTree tree_ll; /*tree for lit,len values*/
-  HuffmanTree tree_d; /*tree for distance codes*/
+/*
+Writes the header of a dynamic block: BFINAL, BTYPE and the two trees. These are stored using their code lengths,
+and to compress even more these code lengths are also run-length encoded and huffman compressed. This gives a
+huffman tree of code lengths "cl". The code lengths used to describe this third tree are the code length code
+lengths ("clcl").
+*/
+static unsigned writeDynamicHeader(LodePNGBitWriter* writer, const HuffmanTree* tree_ll, const HuffmanTree* tree_d,
+                                   unsigned final) {
+  unsigned error = 0;
   HuffmanTree tree_cl; /*tree for encoding the code lengths representing tree_ll and tree_d*/
-  unsigned* frequencies_ll = 0; /*frequency of lit,len codes*/
-  unsigned* frequencies_d = 0; /*frequency of dist codes*/
   unsigned* frequencies_cl = 0; /*frequency of code length codes*/
   unsigned* bitlen_lld = 0; /*lit,len,dist code lengths (int bits), literally (without repeat codes).*/
   unsigned* bitlen_lld_e = 0; /*bitlen_lld encoded with repeat codes (this is a rudimentary run length compression)*/
-  size_t datasize = dataend - datapos;
 
   /*
   If we could call "bitlen_cl" the the code length code lengths ("clcl"), that is the bit lengths of codes to represent
@@ -1825,54 +2411,18 @@ static unsigned deflateDynamic(LodePNGBitWriter* writer, Hash* hash,
   size_t numcodes_ll, numcodes_d, numcodes_lld, numcodes_lld_e, numcodes_cl;
   unsigned HLIT, HDIST, HCLEN;
 
-  uivector_init(&lz77_encoded);
-  HuffmanTree_init(&tree_ll);
-  HuffmanTree_init(&tree_d);
   HuffmanTree_init(&tree_cl);
-  /* could fit on stack, but >1KB is on the larger side so allocate instead */
-  frequencies_ll = (unsigned*)lodepng_malloc(286 * sizeof(*frequencies_ll));
-  frequencies_d = (unsigned*)lodepng_malloc(30 * sizeof(*frequencies_d));
   frequencies_cl = (unsigned*)lodepng_malloc(NUM_CODE_LENGTH_CODES * sizeof(*frequencies_cl));
 
-  if(!frequencies_ll || !frequencies_d || !frequencies_cl) error = 83; /*alloc fail*/
+  if(!frequencies_cl) error = 83; /*alloc fail*/
 
   /*This while loop never loops due to a break at the end, it is here to
   allow breaking out of it to the cleanup phase on error conditions.*/
   while(!error) {
-    lodepng_memset(frequencies_ll, 0, 286 * sizeof(*frequencies_ll));
-    lodepng_memset(frequencies_d, 0, 30 * sizeof(*frequencies_d));
     lodepng_memset(frequencies_cl, 0, NUM_CODE_LENGTH_CODES * sizeof(*frequencies_cl));
 
-    if(settings->use_lz77) {
-      error = encodeLZ77(&lz77_encoded, hash, data, datapos, dataend, settings->windowsize,
-                         settings->minmatch, settings->nicematch, settings->lazymatching);
-      if(error) break;
-    } else {
-      if(!uivector_resize(&lz77_encoded, datasize)) ERROR_BREAK(83 /*alloc fail*/);
-      for(i = datapos; i < dataend; ++i) lz77_encoded.data[i - datapos] = data[i]; /*no LZ77, but still will be Huffman compressed*/
-    }
-
-    /*Count the frequencies of lit, len and dist codes*/
-    for(i = 0; i != lz77_encoded.size; ++i) {
-      unsigned symbol = lz77_encoded.data[i];
-      ++frequencies_ll[symbol];
-      if(symbol > 256) {
-        unsigned dist = lz77_encoded.data[i + 2];
-        ++frequencies_d[dist];
-        i += 3;
-      }
-    }
-    frequencies_ll[256] = 1; /*there will be exactly 1 end code, at the end of the block*/
-
-    /*Make both huffman trees, one for the lit and len codes, one for the dist codes*/
-    error = HuffmanTree_makeFromFrequencies(&tree_ll, frequencies_ll, 257, 286, 15);
-    if(error) break;
-    /*2, not 1, is chosen for mincodes: some buggy PNG decoders require at least 2 symbols in the dist tree*/
-    error = HuffmanTree_makeFromFrequencies(&tree_d, frequencies_d, 2, 30, 15);
-    if(error) break;
-
-    numcodes_ll = LODEPNG_MIN(tree_ll.numcodes, 286);
-    numcodes_d = LODEPNG_MIN(tree_d.numcodes, 30);
+    numcodes_ll = LODEPNG_MIN(tree_ll->numcodes, 286);
+    numcodes_d = LODEPNG_MIN(tree_d->numcodes, 30);
     /*store the code lengths of both generated trees in bitlen_lld*/
     numcodes_lld = numcodes_ll + numcodes_d;
     bitlen_lld = (unsigned*)lodepng_malloc(numcodes_lld * sizeof(*bitlen_lld));
@@ -1881,9 +2431,8 @@ static unsigned deflateDynamic(LodePNGBitWriter* writer, Hash* hash,
     if(!bitlen_lld || !bitlen_lld_e) ERROR_BREAK(83); /*alloc fail*/
     numcodes_lld_e = 0;
 
-    for(i = 0; i != numcodes_ll; ++i) bitlen_lld[i] = tree_ll.lengths[i];
-    for(i = 0; i != numcodes_d; ++i) bitlen_lld[numcodes_ll + i] = tree_d.lengths[i];
-
+    for(i = 0; i != numcodes_ll; ++i) bitlen_lld[i] = tree_ll->lengths[i];
+    for(i = 0; i != numcodes_d; ++i) bitlen_lld[numcodes_ll + i] = tree_d->lengths[i];
     /*run-length compress bitlen_ldd into bitlen_lld_e by using repeat codes 16 (copy length 3-6 times),
     17 (3-10 zeroes), 18 (11-138 zeroes)*/
     for(i = 0; i != numcodes_lld; ++i) {
@@ -1980,24 +2529,11 @@ static unsigned deflateDynamic(LodePNGBitWriter* writer, Hash* hash,
       else if(bitlen_lld_e[i] == 18) writeBits(writer, bitlen_lld_e[++i], 7);
     }
 
-    /*write the compressed data symbols*/
-    writeLZ77data(writer, &lz77_encoded, &tree_ll, &tree_d);
-    /*error: the length of the end code 256 must be larger than 0*/
-    if(tree_ll.lengths[256] == 0) ERROR_BREAK(64);
-
-    /*write the end code*/
-    writeBitsReversed(writer, tree_ll.codes[256], tree_ll.lengths[256]);
-
     break; /*end of error-while*/
   }
 
   /*cleanup*/
-  uivector_cleanup(&lz77_encoded);
-  HuffmanTree_cleanup(&tree_ll);
-  HuffmanTree_cleanup(&tree_d);
   HuffmanTree_cleanup(&tree_cl);
-  lodepng_free(frequencies_ll);
-  lodepng_free(frequencies_d);
   lodepng_free(frequencies_cl);
   lodepng_free(bitlen_lld);
   lodepng_free(bitlen_lld_e);
@@ -2005,36 +2541,538 @@ static unsigned deflateDynamic(LodePNGBitWriter* writer, Hash* hash,
   return error;
 }
 
-static unsigned deflateFixed(LodePNGBitWriter* writer, Hash* hash,
-                             const unsigned char* data,
-                             size_t datapos, size_t dataend,
-                             const LodePNGCompressSettings* settings, unsigned final) {
-  HuffmanTree tree_ll; /*tree for literal values and length codes*/
-  HuffmanTree tree_d; /*tree for distance codes*/
-
-  unsigned BFINAL = final;
+/*writes a complete dynamic block of lz77 encoded data, with the trees made for it*/
+static unsigned writeDynamicBlock(LodePNGBitWriter* writer, const uivector* lz77_encoded, unsigned final) {
   unsigned error = 0;
-  size_t i;
+  HuffmanTree tree_ll; /*tree for lit,len values*/
+  HuffmanTree tree_d; /*tree for distance codes*/
+  unsigned* frequencies_ll = 0; /*frequency of lit,len codes*/
+  unsigned* frequencies_d = 0; /*frequency of dist codes*/
 
   HuffmanTree_init(&tree_ll);
   HuffmanTree_init(&tree_d);
+  /* could fit on stack, but >1KB is on the larger side so allocate instead */
+  frequencies_ll = (unsigned*)lodepng_malloc(286 * sizeof(*frequencies_ll));
+  frequencies_d = (unsigned*)lodepng_malloc(30 * sizeof(*frequencies_d));
 
-  error = generateFixedLitLenTree(&tree_ll);
-  if(!error) error = generateFixedDistanceTree(&tree_d);
+  if(!frequencies_ll || !frequencies_d) error = 83; /*alloc fail*/
 
   if(!error) {
-    writeBits(writer, BFINAL, 1);
-    writeBits(writer, 1, 1); /*first bit of BTYPE*/
-    writeBits(writer, 0, 1); /*second bit of BTYPE*/
+    lz77Frequencies(frequencies_ll, frequencies_d, lz77_encoded->data, lz77_encoded->size);
+    error = makeDynamicTrees(&tree_ll, &tree_d, frequencies_ll, frequencies_d);
+  }
+  if(!error) error = writeDynamicHeader(writer, &tree_ll, &tree_d, final);
+  if(!error) {
+    /*write the compressed data symbols*/
+    error = writeLZ77data(writer, lz77_encoded, &tree_ll, &tree_d);
+    /*error: the length of the end code 256 must be larger than 0*/
+    if(!error && tree_ll.lengths[256] == 0) error = 64;
+  }
+  /*write the end code*/
+  if(!error) writeBitsReversed(writer, tree_ll.codes[256], tree_ll.lengths[256]);
 
-    if(settings->use_lz77) /*LZ77 encoded*/ {
-      uivector lz77_encoded;
-      uivector_init(&lz77_encoded);
-      error = encodeLZ77(&lz77_encoded, hash, data, datapos, dataend, settings->windowsize,
-                         settings->minmatch, settings->nicematch, settings->lazymatching);
-      if(!error) writeLZ77data(writer, &lz77_encoded, &tree_ll, &tree_d);
-      uivector_cleanup(&lz77_encoded);
-    } else /*no LZ77, but still will be Huffman compressed*/ {
+  HuffmanTree_cleanup(&tree_ll);
+  HuffmanTree_cleanup(&tree_d);
+  lodepng_free(frequencies_ll);
+  lodepng_free(frequencies_d);
+
+  return error;
+}
+
+/*
+Optimal parsing, for LCL_OPTIMAL. Instead of taking the longest match found at each position, a block is
+encoded as the cheapest path through all of its LZ77 choices: every literal and every length of every match
+found is an edge, weighted with its cost in bits under a model of the huffman codes. The first pass uses the code
+lengths of the fixed tree, every next pass the statistics of the result before it, and the smallest result is
+kept. Costs are integers in 1/32 bits.
+*/
+#define OPTIMAL_COST_SHIFT 5u
+/*the input is parsed in pieces of at most this size, which bounds the memory and keeps path costs in 32 bits*/
+#define OPTIMAL_MAX_PARSE 1048576u
+/*blocks of fewer symbols are not split further: the header of a dynamic block takes 50-100 bytes*/
+#define OPTIMAL_MIN_SPLIT 1024u
+/*a block is split at most this many times in two, giving at most 16 blocks*/
+#define OPTIMAL_SPLIT_DEPTH 4u
+
+typedef struct OptimalMatches {
+  /*For every position, the matches of increasing length met on its hash chain, each at the closest distance seen
+  for its length, packed as length | distance << 16. Any length from 3 up to that of a match can be taken with its
+  distance. A match is replaced by a longer one with the same distance code, which costs the same, so there are at
+  most 30 per position instead of up to 256. A single 0 marks a position inside a long run of one byte value, where
+  only a literal and a match of maximum length at distance 1 are tried, so that long runs don't take quadratic
+  time.*/
+  uivector matches;
+  uivector begin; /*index in matches of the first match of every position, and one past the last*/
+} OptimalMatches;
+
+typedef struct OptimalCosts {
+  unsigned literal[256];
+  unsigned length[259]; /*length code and its extra bits, for every length from 3 to 258*/
+  unsigned distance[30]; /*distance code and its extra bits, for every distance code*/
+} OptimalCosts;
+
+/*fills the matches of the positions inpos..insize, and the hash with them as encodeLZ77 would*/
+static unsigned findOptimalMatches(OptimalMatches* m, Hash* hash, const unsigned char* in, size_t inpos,
+                                   size_t insize, const DeflateParams* params) {
+  unsigned windowsize = params->windowsize;
+  unsigned numzeros = 0;
+  size_t pos, runend = inpos; /*end of the run of equal bytes that pos is in*/
+
+  m->matches.size = 0;
+  if(!uivector_resize(&m->begin, insize - inpos + 1u)) return 83; /*alloc fail*/
+  for(pos = inpos; pos < insize; ++pos) {
+    size_t wpos = pos & (windowsize - 1u);
+    unsigned hashval = getHash(in, insize, pos);
+    unsigned length = 0, chainlength = 0, prev_offset = 0;
+    unsigned hashpos;
+    const unsigned char* lastptr = &in[LODEPNG_MIN(insize, pos + MAX_SUPPORTED_DEFLATE_LENGTH)];
+
+    if(hashval == 0) {
+      if(numzeros == 0) numzeros = countZeros(in, insize, pos);
+      else if(pos + numzeros > insize || in[pos + numzeros - 1] != 0) --numzeros;
+    } else {
+      numzeros = 0;
+    }
+    updateHashChain(hash, wpos, hashval, (unsigned short)numzeros);
+    m->begin.data[pos - inpos] = (unsigned)m->matches.size;
+
+    if(pos >= runend) {
+      runend = pos + 1u;
+      while(runend < insize && in[runend] == in[pos]) ++runend;
+    }
+    if(pos > 0 && in[pos - 1u] == in[pos] && runend - pos > 2u * MAX_SUPPORTED_DEFLATE_LENGTH) {
+      if(!uivector_push_back(&m->matches, 0)) return 83; /*alloc fail*/
+      continue;
+    }
+
+    /*the same search as in encodeLZ77, but every improvement is kept*/
+    hashpos = hash->chain[wpos];
+    for(;;) {
+      unsigned current_offset;
+      if(chainlength++ >= params->maxchainlength) break;
+      current_offset = (unsigned)(hashpos <= wpos ? wpos - hashpos : wpos - hashpos + windowsize);
+
+      if(current_offset < prev_offset) break; /*stop when went completely around the circular buffer*/
+      prev_offset = current_offset;
+      /*only a candidate that also matches the byte after the longest match so far can be longer*/
+      if(current_offset > 0 && in[pos - current_offset + length] == in[pos + length]) {
+        const unsigned char* foreptr = &in[pos];
+        const unsigned char* backptr = &in[pos - current_offset];
+        if(numzeros >= 3) {
+          unsigned skip = hash->zeros[hashpos];
+          if(skip > numzeros) skip = numzeros;
+          backptr += skip;
+          foreptr += skip;
+        }
+        foreptr += matchLength(foreptr, backptr, lastptr);
+        if((unsigned)(foreptr - &in[pos]) > length) {
+          length = (unsigned)(foreptr - &in[pos]);
+          if(length >= 3) {
+            unsigned match = length | (current_offset << 16u);
+            size_t last = m->matches.size;
+            /*the previous match costs as much as this longer one, see OptimalMatches*/
+            if(last != m->begin.data[pos - inpos]
+               && distanceCode(m->matches.data[last - 1u] >> 16u) == distanceCode(current_offset)) {
+              m->matches.data[last - 1u] = match;
+            } else if(!uivector_push_back(&m->matches, match)) {
+              return 83; /*alloc fail*/
+            }
+          }
+          if(length >= params->nicematch || foreptr == lastptr) break;
+        }
+      }
+
+      if(hashpos == hash->chain[hashpos]) break;
+
+      if(numzeros >= 3 && length > numzeros) {
+        hashpos = hash->chainz[hashpos];
+        if(hash->zeros[hashpos] != numzeros) break;
+      } else {
+        hashpos = hash->chain[hashpos];
+        /*outdated hash value, happens if particular value was not encountered in whole last window*/
+        if(hash->val[hashpos] != (int)hashval) break;
+      }
+    }
+  }
+  m->begin.data[insize - inpos] = (unsigned)m->matches.size;
+  return 0;
+}
+
+/*log2(x) in 1/32 bits, x > 0: the integer part from the highest bit, the fraction by repeated squaring*/
+static unsigned costLog2(unsigned x) {
+  unsigned l = 0, m, i, result;
+  for(m = x; m >= 2u; m >>= 1u) ++l;
+  m = l > 15u ? x >> (l - 15u) : x << (15u - l); /*x / 2^l in 1.15 fixed point*/
+  result = l;
+  for(i = 0; i != OPTIMAL_COST_SHIFT; ++i) {
+    m = (m * m) >> 15u;
+    result <<= 1u;
+    if(m >= 65536u) {
+      m >>= 1u;
+      result |= 1u;
+    }
+  }
+  return result;
+}
+
+/*the code lengths of the fixed tree, for the first pass*/
+static void optimalCostsFixed(OptimalCosts* costs) {
+  unsigned i;
+  for(i = 0; i != 256; ++i) costs->literal[i] = (i < 144 ? 8u : 9u) << OPTIMAL_COST_SHIFT;
+  for(i = 0; i != 3; ++i) costs->length[i] = 0;
+  for(i = 3; i != 259; ++i) {
+    unsigned code = lengthCode(i);
+    costs->length[i] = ((code + FIRST_LENGTH_CODE_INDEX < 280 ? 7u : 8u) + LENGTHEXTRA[code]) << OPTIMAL_COST_SHIFT;
+  }
+  for(i = 0; i != 30; ++i) costs->distance[i] = (5u + DISTANCEEXTRA[i]) << OPTIMAL_COST_SHIFT;
+}
+
+/*the entropy of every code in the given frequencies, a code that wasn't used costs as much as one used once*/
+static void optimalCostsFromFrequencies(OptimalCosts* costs, const unsigned* frequencies_ll,
+                                        const unsigned* frequencies_d) {
+  unsigned i, total_ll = 0, total_d = 0, log_ll, log_d;
+  for(i = 0; i != 286; ++i) total_ll += frequencies_ll[i];
+  for(i = 0; i != 30; ++i) total_d += frequencies_d[i];
+  log_ll = costLog2(total_ll);
+  log_d = costLog2(total_d ? total_d : 1u);
+  for(i = 0; i != 256; ++i) costs->literal[i] = log_ll - costLog2(frequencies_ll[i] ? frequencies_ll[i] : 1u);
+  for(i = 0; i != 3; ++i) costs->length[i] = 0;
+  for(i = 3; i != 259; ++i) {
+    unsigned code = lengthCode(i);
+    unsigned frequency = frequencies_ll[code + FIRST_LENGTH_CODE_INDEX];
+    costs->length[i] = log_ll - costLog2(frequency ? frequency : 1u) + (LENGTHEXTRA[code] << OPTIMAL_COST_SHIFT);
+  }
+  for(i = 0; i != 30; ++i) {
+    unsigned frequency = frequencies_d[i];
+    costs->distance[i] = log_d - costLog2(frequency ? frequency : 1u) + (DISTANCEEXTRA[i] << OPTIMAL_COST_SHIFT);
+  }
+}
+
+/*
+Appends the cheapest encoding of the positions inpos..insize under costs to out. pathcost and arrival need room
+for every position and one more: pathcost[i] is the cost of the cheapest path to position i, arrival[i] the length
+of its last step (1 for a literal).
+*/
+static unsigned optimalParse(uivector* out, const OptimalMatches* m, const OptimalCosts* costs,
+                             const unsigned char* in, size_t inpos, size_t insize,
+                             unsigned* pathcost, unsigned short* arrival) {
+  size_t n = insize - inpos, i, j;
+  unsigned length;
+
+  pathcost[0] = 0;
+  for(i = 1; i <= n; ++i) pathcost[i] = (unsigned)(-1);
+  for(i = 0; i != n; ++i) {
+    unsigned base = pathcost[i];
+    unsigned cost = base + costs->literal[in[inpos + i]];
+    size_t first = m->begin.data[i], last = m->begin.data[i + 1];
+    if(cost < pathcost[i + 1]) {
+      pathcost[i + 1] = cost;
+      arrival[i + 1] = 1;
+    }
+    if(first != last && m->matches.data[first] == 0) {
+      /*inside a long run, see OptimalMatches*/
+      cost = base + costs->length[MAX_SUPPORTED_DEFLATE_LENGTH] + costs->distance[0];
+      if(cost < pathcost[i + MAX_SUPPORTED_DEFLATE_LENGTH]) {
+        pathcost[i + MAX_SUPPORTED_DEFLATE_LENGTH] = cost;
+        arrival[i + MAX_SUPPORTED_DEFLATE_LENGTH] = (unsigned short)MAX_SUPPORTED_DEFLATE_LENGTH;
+      }
+      continue;
+    }
+    length = 3;
+    for(j = first; j != last; ++j) {
+      unsigned matchlength = m->matches.data[j] & 65535u;
+      unsigned distcost = base + costs->distance[distanceCode(m->matches.data[j] >> 16u)];
+      for(; length <= matchlength; ++length) {
+        cost = distcost + costs->length[length];
+        if(cost < pathcost[i + length]) {
+          pathcost[i + length] = cost;
+          arrival[i + length] = (unsigned short)length;
+        }
+      }
+    }
+  }
+
+  /*walk the path back from the end, marking the length of every step in pathcost at the position it starts*/
+  for(i = n; i != 0; i -= length) {
+    length = arrival[i];
+    pathcost[i - length] = length;
+  }
+  for(i = 0; i != n; i += length) {
+    length = pathcost[i];
+    if(length == 1) {
+      if(!uivector_push_back(out, in[inpos + i])) return 83; /*alloc fail*/
+    } else {
+      /*the closest match that is long enough, or distance 1 inside a long run*/
+      unsigned distance = 1;
+      for(j = m->begin.data[i]; j != m->begin.data[i + 1]; ++j) {
+        if((m->matches.data[j] & 65535u) >= length) {
+          distance = m->matches.data[j] >> 16u;
+          break;
+        }
+      }
+      addLengthDistance(out, length, distance);
+    }
+  }
+  return 0;
+}
+
+/*
+The size in bits of lz77 encoded data written as one dynamic block, without the end code. Leaves the
+frequencies of its codes in frequencies_ll and frequencies_d, and the block header in scratch.
+*/
+static unsigned dynamicBlockBits(size_t* bits, const unsigned* lz77, size_t size, ucvector* scratch,
+                                 unsigned* frequencies_ll, unsigned* frequencies_d) {
+  HuffmanTree tree_ll, tree_d;
+  LodePNGBitWriter writer;
+  unsigned error;
+  size_t i, result;
+
+  HuffmanTree_init(&tree_ll);
+  HuffmanTree_init(&tree_d);
+  lz77Frequencies(frequencies_ll, frequencies_d, lz77, size);
+  error = makeDynamicTrees(&tree_ll, &tree_d, frequencies_ll, frequencies_d);
+  if(!error) {
+    scratch->size = 0;
+    LodePNGBitWriter_init(&writer, scratch);
+    error = writeDynamicHeader(&writer, &tree_ll, &tree_d, 0);
+  }
+  if(!error) {
+    result = scratch->size * 8u - ((8u - (writer.bp & 7u)) & 7u);
+    for(i = 0; i != tree_ll.numcodes; ++i) {
+      result += (size_t)frequencies_ll[i] * (tree_ll.lengths[i] + (i > 256 ? LENGTHEXTRA[i - 257] : 0u));
+    }
+    for(i = 0; i != tree_d.numcodes; ++i) {
+      result += (size_t)frequencies_d[i] * (tree_d.lengths[i] + DISTANCEEXTRA[i]);
+    }
+    *bits = result;
+  }
+  HuffmanTree_cleanup(&tree_ll);
+  HuffmanTree_cleanup(&tree_d);
+  return error;
+}
+
+/*
+LZ77-encode the data with optimal parsing, see OptimalMatches and optimalParse. With fixedtree, only the pass
+with the costs of the fixed tree is done, as that is what will be used.
+*/
+static unsigned encodeLZ77Optimal(uivector* out, Hash* hash, const unsigned char* in, size_t inpos, size_t insize,
+                                  const DeflateParams* params, unsigned fixedtree) {
+  unsigned error = 0, pass;
+  size_t start, piecesize = LODEPNG_MIN(insize - inpos, (size_t)OPTIMAL_MAX_PARSE);
+  OptimalMatches matches;
+  uivector best, candidate;
+  ucvector scratch = ucvector_init(NULL, 0);
+  unsigned numpasses = fixedtree ? 1u : params->optimal;
+  OptimalCosts* costs = (OptimalCosts*)lodepng_malloc(sizeof(OptimalCosts));
+  unsigned* frequencies_ll = (unsigned*)lodepng_malloc(286 * sizeof(unsigned));
+  unsigned* frequencies_d = (unsigned*)lodepng_malloc(30 * sizeof(unsigned));
+  unsigned* pathcost = (unsigned*)lodepng_malloc((piecesize + 1u) * sizeof(unsigned));
+  unsigned short* arrival = (unsigned short*)lodepng_malloc((piecesize + 1u) * sizeof(unsigned short));
+
+  uivector_init(&matches.matches);
+  uivector_init(&matches.begin);
+  uivector_init(&best);
+  uivector_init(&candidate);
+  if(!costs || !frequencies_ll || !frequencies_d || !pathcost || !arrival) error = 83; /*alloc fail*/
+
+  for(start = inpos; start < insize && !error; start += OPTIMAL_MAX_PARSE) {
+    size_t end = LODEPNG_MIN(insize, start + OPTIMAL_MAX_PARSE);
+    size_t bits = 0, bestbits = 0;
+    error = findOptimalMatches(&matches, hash, in, start, end, params);
+    optimalCostsFixed(costs);
+    for(pass = 0; pass != numpasses && !error; ++pass) {
+      /*the frequencies are those of the previous candidate, left by dynamicBlockBits*/
+      if(pass) optimalCostsFromFrequencies(costs, frequencies_ll, frequencies_d);
+      candidate.size = 0;
+      error = optimalParse(&candidate, &matches, costs, in, start, end, pathcost, arrival);
+      if(!error && numpasses > 1) {
+        error = dynamicBlockBits(&bits, candidate.data, candidate.size, &scratch, frequencies_ll, frequencies_d);
+      }
+      if(!error && (pass == 0 || bits < bestbits)) {
+        uivector tmp = best;
+        best = candidate;
+        candidate = tmp;
+        bestbits = bits;
+      }
+    }
+    if(!error && !uivector_resize(out, out->size + best.size)) error = 83; /*alloc fail*/
+    if(!error) lodepng_memcpy(out->data + out->size - best.size, best.data, best.size * sizeof(unsigned));
+  }
+
+  uivector_cleanup(&matches.matches);
+  uivector_cleanup(&matches.begin);
+  uivector_cleanup(&best);
+  uivector_cleanup(&candidate);
+  lodepng_free(scratch.data);
+  lodepng_free(costs);
+  lodepng_free(frequencies_ll);
+  lodepng_free(frequencies_d);
+  lodepng_free(pathcost);
+  lodepng_free(arrival);
+  return error;
+}
+
+typedef struct OptimalBlocks {
+  uivector lz77; /*the lz77 encoded data of all blocks*/
+  uivector starts; /*index in lz77 of every symbol, and its size at the end*/
+  uivector splits; /*the symbols where a new block starts, in increasing order*/
+  ucvector scratch;
+  unsigned* frequencies_ll;
+  unsigned* frequencies_d;
+} OptimalBlocks;
+
+/*the size in bits of the symbols [begin, end) as one dynamic block*/
+static unsigned splitCost(size_t* bits, OptimalBlocks* blocks, size_t begin, size_t end) {
+  size_t first = blocks->starts.data[begin], last = blocks->starts.data[end];
+  return dynamicBlockBits(bits, blocks->lz77.data + first, last - first, &blocks->scratch,
+                          blocks->frequencies_ll, blocks->frequencies_d);
+}
+
+/*
+Splits the symbols [begin, end), which take bits as one dynamic block, where the two blocks are smallest. The
+split point is searched on a grid of 9 points, then again on a finer grid around the best one, until the grid is
+dense. The halves are split in turn, depth times at most, while that saves bits.
+*/
+static unsigned splitBlocks(OptimalBlocks* blocks, size_t begin, size_t end, size_t bits, unsigned depth) {
+  size_t lo = begin + 1u, hi = end - 1u;
+  size_t best = 0, bestbits = bits, bestleft = 0, bestright = 0;
+  unsigned error = 0, k;
+
+  if(depth == 0 || end - begin < OPTIMAL_MIN_SPLIT) return 0;
+  for(;;) {
+    size_t step = (hi - lo) / 8u;
+    for(k = 0; k != 9; ++k) {
+      size_t split = lo + (hi - lo) * k / 8u, left = 0, right = 0;
+      if(split == best) continue;
+      error = splitCost(&left, blocks, begin, split);
+      if(!error) error = splitCost(&right, blocks, split, end);
+      if(error) return error;
+      if(left + right < bestbits) {
+        best = split;
+        bestbits = left + right;
+        bestleft = left;
+        bestright = right;
+      }
+    }
+    if(best == 0 || hi - lo <= 16u) break;
+    lo = best - begin > step ? best - step : begin + 1u;
+    hi = end - best > step ? best + step : end - 1u;
+  }
+  if(best == 0) return 0;
+
+  error = splitBlocks(blocks, begin, best, bestleft, depth - 1u);
+  if(!error && !uivector_push_back(&blocks->splits, (unsigned)best)) error = 83; /*alloc fail*/
+  if(!error) error = splitBlocks(blocks, best, end, bestright, depth - 1u);
+  return error;
+}
+
+/*Deflate with optimal parsing, as one or more dynamic blocks, see encodeLZ77Optimal and splitBlocks*/
+static unsigned deflateOptimal(LodePNGBitWriter* writer, Hash* hash,
+                               const unsigned char* data, size_t datapos, size_t dataend,
+                               const DeflateParams* params, unsigned final) {
+  OptimalBlocks blocks;
+  size_t i, numsymbols, bits = 0, begin = 0;
+  unsigned error;
+
+  uivector_init(&blocks.lz77);
+  uivector_init(&blocks.starts);
+  uivector_init(&blocks.splits);
+  blocks.scratch = ucvector_init(NULL, 0);
+  blocks.frequencies_ll = (unsigned*)lodepng_malloc(286 * sizeof(unsigned));
+  blocks.frequencies_d = (unsigned*)lodepng_malloc(30 * sizeof(unsigned));
+
+  error = (blocks.frequencies_ll && blocks.frequencies_d) ? 0 : 83; /*alloc fail*/
+  if(!error) error = encodeLZ77Optimal(&blocks.lz77, hash, data, datapos, dataend, params, 0);
+  for(i = 0; i < blocks.lz77.size && !error; i += blocks.lz77.data[i] > 256 ? 4u : 1u) {
+    if(!uivector_push_back(&blocks.starts, (unsigned)i)) error = 83; /*alloc fail*/
+  }
+  numsymbols = blocks.starts.size;
+  if(!error && !uivector_push_back(&blocks.starts, (unsigned)blocks.lz77.size)) error = 83; /*alloc fail*/
+  if(!error && numsymbols) error = splitCost(&bits, &blocks, 0, numsymbols);
+  if(!error && numsymbols) error = splitBlocks(&blocks, 0, numsymbols, bits, OPTIMAL_SPLIT_DEPTH);
+
+  for(i = 0; i <= blocks.splits.size && !error; ++i) {
+    size_t end = i < blocks.splits.size ? blocks.splits.data[i] : numsymbols;
+    /*a read-only view of the block's part of lz77*/
+    uivector part;
+    part.data = blocks.lz77.data + blocks.starts.data[begin];
+    part.size = blocks.starts.data[end] - blocks.starts.data[begin];
+    part.allocsize = part.size * sizeof(unsigned);
+    error = writeDynamicBlock(writer, &part, final && i == blocks.splits.size);
+    begin = end;
+  }
+
+  uivector_cleanup(&blocks.lz77);
+  uivector_cleanup(&blocks.starts);
+  uivector_cleanup(&blocks.splits);
+  lodepng_free(blocks.scratch.data);
+  lodepng_free(blocks.frequencies_ll);
+  lodepng_free(blocks.frequencies_d);
+  return error;
+}
+
+/*Deflate for a block of type "dynamic", that is, with freely, optimally, created huffman trees*/
+static unsigned deflateDynamic(LodePNGBitWriter* writer, Hash* hash,
+                               const unsigned char* data, size_t datapos, size_t dataend,
+                               const DeflateParams* params, unsigned final) {
+  /*
+  A block is compressed as follows: The PNG data is lz77 encoded, resulting in
+  literal bytes and length/distance pairs. This is then huffman compressed with
+  two huffman trees. One huffman tree is used for the lit and len values ("ll"),
+  another huffman tree is used for the dist values ("d"), see writeDynamicHeader.
+  */
+
+  /*The lz77 encoded data, represented with integers since there will also be length and distance codes in it*/
+  uivector lz77_encoded;
+  unsigned error = 0;
+  size_t i;
+
+  if(params->use_lz77 && params->optimal) return deflateOptimal(writer, hash, data, datapos, dataend, params, final);
+
+  uivector_init(&lz77_encoded);
+  if(params->use_lz77) {
+    error = encodeLZ77(&lz77_encoded, hash, data, datapos, dataend, params);
+  } else {
+    if(!uivector_resize(&lz77_encoded, dataend - datapos)) error = 83; /*alloc fail*/
+    /*no LZ77, but still will be Huffman compressed*/
+    else for(i = datapos; i < dataend; ++i) lz77_encoded.data[i - datapos] = data[i];
+  }
+  if(!error) error = writeDynamicBlock(writer, &lz77_encoded, final);
+  uivector_cleanup(&lz77_encoded);
+
+  return error;
+}
+
+static unsigned deflateFixed(LodePNGBitWriter* writer, Hash* hash,
+                             const unsigned char* data,
+                             size_t datapos, size_t dataend,
+                             const DeflateParams* params, unsigned final) {
+  HuffmanTree tree_ll; /*tree for literal values and length codes*/
+  HuffmanTree tree_d; /*tree for distance codes*/
+
+  unsigned BFINAL = final;
+  unsigned error = 0;
+  size_t i;
+
+  HuffmanTree_init(&tree_ll);
+  HuffmanTree_init(&tree_d);
+
+  error = generateFixedLitLenTree(&tree_ll);
+  if(!error) error = generateFixedDistanceTree(&tree_d);
+
+  if(!error) {
+    writeBits(writer, BFINAL, 1);
+    writeBits(writer, 1, 1); /*first bit of BTYPE*/
+    writeBits(writer, 0, 1); /*second bit of BTYPE*/
+
+    if(params->use_lz77) /*LZ77 encoded*/ {
+      uivector lz77_encoded;
+      uivector_init(&lz77_encoded);
+      if(params->optimal) error = encodeLZ77Optimal(&lz77_encoded, hash, data, datapos, dataend, params, 1);
+      else error = encodeLZ77(&lz77_encoded, hash, data, datapos, dataend, params);
+      if(!error) error = writeLZ77data(writer, &lz77_encoded, &tree_ll, &tree_d);
+      uivector_cleanup(&lz77_encoded);
+    } else /*no LZ77, but still will be Huffman compressed*/ {
       for(i = datapos; i < dataend; ++i) {
         writeBitsReversed(writer, tree_ll.codes[data[i]], tree_ll.lengths[data[i]]);
       }
@@ -2050,29 +3088,164 @@ static unsigned deflateFixed(LodePNGBitWriter* writer, Hash* hash,
   return error;
 }
 
+#ifdef LODEPNG_COMPILE_THREADS
+static unsigned update_adler32(unsigned adler, const unsigned char* data, unsigned len);
+
+/*the adler32 of the concatenation of two buffers, from their adler32s and the length of the second one*/
+static unsigned adler32_combine(unsigned adler1, unsigned adler2, size_t len2) {
+  unsigned rem = (unsigned)(len2 % 65521u);
+  unsigned s1 = adler1 & 0xffffu;
+  unsigned s2 = (rem * s1) % 65521u; /*at most 65520 * 65520, fits in 32 bits*/
+  s1 += (adler2 & 0xffffu) + 65521u - 1u;
+  s2 += ((adler1 >> 16u) & 0xffffu) + ((adler2 >> 16u) & 0xffffu) + 65521u - rem;
+  if(s1 >= 65521u) s1 -= 65521u;
+  if(s1 >= 65521u) s1 -= 65521u;
+  if(s2 >= 65521u * 2u) s2 -= 65521u * 2u;
+  if(s2 >= 65521u) s2 -= 65521u;
+  return (s2 << 16u) | s1;
+}
+
+/*fills the hash with the positions begin..end without encoding them, as encodeLZ77 would have done*/
+static void hash_prime(Hash* hash, const unsigned char* in, size_t begin, size_t end, const DeflateParams* params) {
+  unsigned windowsize = params->windowsize;
+  unsigned numzeros = 0;
+  size_t pos;
+  if(params->greedy) {
+    for(pos = begin; pos + 4 <= end; ++pos) hash->head[getHash4(&in[pos])] = (int)(pos & (windowsize - 1u));
+    return;
+  }
+  for(pos = begin; pos < end; ++pos) {
+    unsigned hashval = getHash(in, end, pos);
+    if(hashval == 0) {
+      if(numzeros == 0) numzeros = countZeros(in, end, pos);
+      else if(pos + numzeros > end || in[pos + numzeros - 1] != 0) --numzeros;
+    } else {
+      numzeros = 0;
+    }
+    updateHashChain(hash, pos & (windowsize - 1u), hashval, (unsigned short)numzeros);
+  }
+}
+
+typedef struct DeflateJob {
+  ucvector out; /*the block's bits, ending on a byte boundary*/
+  unsigned adler; /*adler32 of the block's input*/
+  unsigned error;
+} DeflateJob;
+
+static void deflateBlockJob(DeflateJob* job, Hash* hash, const unsigned char* in, size_t start, size_t end,
+                            unsigned btype, const DeflateParams* params, unsigned final, unsigned checksum) {
+  LodePNGBitWriter writer;
+  size_t dictionary = start > params->windowsize ? start - params->windowsize : 0;
+  LodePNGBitWriter_init(&writer, &job->out);
+  /*a fresh hash for every block, so that the result doesn't depend on which thread encoded it*/
+  hash_reset(hash, params->windowsize);
+  if(params->use_lz77) hash_prime(hash, in, dictionary, start, params);
+  if(btype == 1) job->error = deflateFixed(&writer, hash, in, start, end, params, final);
+  else job->error = deflateDynamic(&writer, hash, in, start, end, params, final);
+  if(!job->error && !final) {
+    /*an empty stored block: its header is 3 bits, then it jumps to the next byte, so the following block
+    can start there. The padding bits are already zero.*/
+    writeBits(&writer, 0, 3);
+    if(!ucvector_resize(&job->out, job->out.size + 4)) job->error = 83; /*alloc fail*/
+    else lodepng_memcpy(job->out.data + job->out.size - 4, "\0\0\377\377", 4);
+  }
+  if(checksum) job->adler = update_adler32(1u, &in[start], (unsigned)(end - start));
+}
+
+/*
+Deflate with the blocks compressed in parallel. Every block is LZ77 encoded with its own hash, primed with the
+window before it, so matches may still reach into the previous block, and ends on a byte boundary so the blocks
+can be concatenated. The result doesn't depend on the number of threads. If adler is not NULL, it receives the
+adler32 of the input, computed per block on the same threads.
+*/
+static unsigned deflateParallel(ucvector* out, const unsigned char* in, size_t insize,
+                                const LodePNGCompressSettings* settings, unsigned numthreads, unsigned* adler) {
+  DeflateParams params;
+  size_t blocksize, numblocks, i;
+  unsigned error = 0;
+  std::vector<DeflateJob> jobs;
+  std::vector<std::thread> threads;
+  std::atomic<size_t> next(0);
+  /*each thread takes the next block until none is left, blocks are uneven in cost*/
+  auto work = [&]() {
+    Hash hash;
+    unsigned hasherror = hash_init(&hash, params.windowsize);
+    for(;;) {
+      size_t block = next++;
+      size_t start = block * blocksize;
+      if(block >= numblocks) break;
+      if(hasherror) {
+        jobs[block].error = hasherror;
+        continue;
+      }
+      deflateBlockJob(&jobs[block], &hash, in, start, LODEPNG_MIN(start + blocksize, insize), settings->btype,
+                      &params, block + 1u == numblocks, adler != 0);
+    }
+    hash_cleanup(&hash);
+  };
+
+  deflateParams(&params, settings);
+  blocksize = deflateBlockSize(insize, &params);
+  numblocks = (insize + blocksize - 1u) / blocksize;
+  if(numblocks == 0) numblocks = 1; /*an empty input still needs its final block*/
+  jobs.resize(numblocks);
+  for(i = 0; i != numblocks; ++i) {
+    jobs[i].out = ucvector_init(NULL, 0);
+    jobs[i].adler = 1u;
+    jobs[i].error = 0;
+  }
+  numthreads = (unsigned)LODEPNG_MIN((size_t)numthreads, numblocks);
+  threads.reserve(numthreads - 1u);
+  for(i = 1; i < numthreads; ++i) {
+    try {
+      threads.emplace_back(work);
+    } catch(...) {
+      break; /*the threads that did start, and this one, process everything*/
+    }
+  }
+  work();
+  for(i = 0; i != threads.size(); ++i) threads[i].join();
+
+  if(adler) *adler = 1u;
+  for(i = 0; i != numblocks; ++i) {
+    DeflateJob* job = &jobs[i];
+    if(!error) error = job->error;
+    if(!error && !ucvector_resize(out, out->size + job->out.size)) error = 83; /*alloc fail*/
+    if(!error) {
+      lodepng_memcpy(out->data + out->size - job->out.size, job->out.data, job->out.size);
+      if(adler) *adler = adler32_combine(*adler, job->adler, LODEPNG_MIN(blocksize, insize - i * blocksize));
+    }
+    lodepng_free(job->out.data);
+  }
+  return error;
+}
+#endif /*LODEPNG_COMPILE_THREADS*/
+
 static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
                                  const LodePNGCompressSettings* settings) {
   unsigned error = 0;
   size_t i, blocksize, numdeflateblocks;
   Hash hash;
   LodePNGBitWriter writer;
+  DeflateParams params;
 
   LodePNGBitWriter_init(&writer, out);
+  deflateParams(&params, settings);
 
   if(settings->btype > 2) return 61;
   else if(settings->btype == 0) return deflateNoCompression(out, in, insize);
-  else if(settings->btype == 1) blocksize = insize;
-  else /*if(settings->btype == 2)*/ {
-    /*on PNGs, deflate blocks of 65-262k seem to give most dense encoding*/
-    blocksize = insize / 8u + 8;
-    if(blocksize < 65536) blocksize = 65536;
-    if(blocksize > 262144) blocksize = 262144;
+#ifdef LODEPNG_COMPILE_THREADS
+  else if(insize > 65536u && lodepng_num_threads(settings->num_threads) > 1) {
+    return deflateParallel(out, in, insize, settings, lodepng_num_threads(settings->num_threads), 0);
   }
+#endif /*LODEPNG_COMPILE_THREADS*/
+  else if(settings->btype == 1) blocksize = insize;
+  else /*if(settings->btype == 2)*/ blocksize = deflateBlockSize(insize, &params);
 
   numdeflateblocks = (insize + blocksize - 1) / blocksize;
   if(numdeflateblocks == 0) numdeflateblocks = 1;
 
-  error = hash_init(&hash, settings->windowsize);
+  error = hash_init(&hash, params.windowsize);
 
   if(!error) {
     for(i = 0; i != numdeflateblocks && !error; ++i) {
@@ -2081,8 +3254,8 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
       size_t end = start + blocksize;
       if(end > insize) end = insize;
 
-      if(settings->btype == 1) error = deflateFixed(&writer, &hash, in, start, end, settings, final);
-      else if(settings->btype == 2) error = deflateDynamic(&writer, &hash, in, start, end, settings, final);
+      if(settings->btype == 1) error = deflateFixed(&writer, &hash, in, start, end, &params, final);
+      else if(settings->btype == 2) error = deflateDynamic(&writer, &hash, in, start, end, &params, final);
     }
   }
 
@@ -2119,7 +3292,7 @@ static unsigned deflate(unsigned char** out, size_t* outsize,
 /* / Adler32                                                                / */
 /* ////////////////////////////////////////////////////////////////////////// */
 
-static unsigned update_adler32(unsigned adler, const unsigned char* data, unsigned len) {
+static unsigned update_adler32Scalar(unsigned adler, const unsigned char* data, unsigned len) {
   unsigned s1 = adler & 0xffffu;
   unsigned s2 = (adler >> 16u) & 0xffffu;
 
@@ -2139,6 +3312,91 @@ static unsigned update_adler32(unsigned adler, const unsigned char* data, unsign
   return (s2 << 16u) | s1;
 }
 
+#ifdef LODEPNG_SIMD_X86
+/*
+Adler32 on 32-byte blocks: s1 gets the byte sums (psadbw), s2 the sums weighted by the distance to the block
+end (pmaddubsw with weights 32..1), plus 32 times s1 as it was before each block. 173 blocks (5536 bytes)
+still fit the 5552 bytes allowed before the modulo. The tail is done by the portable code.
+*/
+LODEPNG_TARGET("ssse3")
+static unsigned update_adler32SSSE3(unsigned adler, const unsigned char* data, unsigned len) {
+  const __m128i weights1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+  const __m128i weights2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+  const __m128i ones = _mm_set1_epi16(1), zero = _mm_setzero_si128();
+  unsigned s1 = adler & 0xffffu;
+  unsigned s2 = (adler >> 16u) & 0xffffu;
+  unsigned blocks = len / 32u;
+  len -= blocks * 32u;
+  while(blocks != 0u) {
+    unsigned n = blocks > 173u ? 173u : blocks;
+    __m128i prevs1 = _mm_cvtsi32_si128((int)(s1 * n)), vs1 = zero, vs2 = _mm_cvtsi32_si128((int)s2);
+    blocks -= n;
+    while(n--) {
+      __m128i bytes1 = _mm_loadu_si128((const __m128i*)data);
+      __m128i bytes2 = _mm_loadu_si128((const __m128i*)(data + 16));
+      prevs1 = _mm_add_epi32(prevs1, vs1);
+      vs1 = _mm_add_epi32(vs1, _mm_add_epi32(_mm_sad_epu8(bytes1, zero), _mm_sad_epu8(bytes2, zero)));
+      vs2 = _mm_add_epi32(vs2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, weights1), ones));
+      vs2 = _mm_add_epi32(vs2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, weights2), ones));
+      data += 32;
+    }
+    vs2 = _mm_add_epi32(vs2, _mm_slli_epi32(prevs1, 5));
+    /*horizontal sums: vs1 only has values in lanes 0 and 2*/
+    vs1 = _mm_add_epi32(vs1, _mm_shuffle_epi32(vs1, _MM_SHUFFLE(1, 0, 3, 2)));
+    vs2 = _mm_add_epi32(vs2, _mm_shuffle_epi32(vs2, _MM_SHUFFLE(1, 0, 3, 2)));
+    vs2 = _mm_add_epi32(vs2, _mm_shuffle_epi32(vs2, _MM_SHUFFLE(2, 3, 0, 1)));
+    s1 = (s1 + (unsigned)_mm_cvtsi128_si32(vs1)) % 65521u;
+    s2 = (unsigned)_mm_cvtsi128_si32(vs2) % 65521u;
+  }
+  return update_adler32Scalar((s2 << 16u) | s1, data, len);
+}
+
+LODEPNG_TARGET("avx2")
+static unsigned update_adler32AVX2(unsigned adler, const unsigned char* data, unsigned len) {
+  const __m256i weights = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+                                           16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+  const __m256i ones = _mm256_set1_epi16(1), zero = _mm256_setzero_si256();
+  unsigned s1 = adler & 0xffffu;
+  unsigned s2 = (adler >> 16u) & 0xffffu;
+  unsigned blocks = len / 32u;
+  len -= blocks * 32u;
+  while(blocks != 0u) {
+    unsigned n = blocks > 173u ? 173u : blocks;
+    __m256i prevs1 = _mm256_setr_epi32((int)(s1 * n), 0, 0, 0, 0, 0, 0, 0), vs1 = zero;
+    __m256i vs2 = _mm256_setr_epi32((int)s2, 0, 0, 0, 0, 0, 0, 0);
+    __m128i sum1, sum2;
+    blocks -= n;
+    while(n--) {
+      __m256i bytes = _mm256_loadu_si256((const __m256i*)data);
+      prevs1 = _mm256_add_epi32(prevs1, vs1);
+      vs1 = _mm256_add_epi32(vs1, _mm256_sad_epu8(bytes, zero));
+      vs2 = _mm256_add_epi32(vs2, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, weights), ones));
+      data += 32;
+    }
+    vs2 = _mm256_add_epi32(vs2, _mm256_slli_epi32(prevs1, 5));
+    sum1 = _mm_add_epi32(_mm256_castsi256_si128(vs1), _mm256_extracti128_si256(vs1, 1));
+    sum2 = _mm_add_epi32(_mm256_castsi256_si128(vs2), _mm256_extracti128_si256(vs2, 1));
+    sum1 = _mm_add_epi32(sum1, _mm_shuffle_epi32(sum1, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum2 = _mm_add_epi32(sum2, _mm_shuffle_epi32(sum2, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum2 = _mm_add_epi32(sum2, _mm_shuffle_epi32(sum2, _MM_SHUFFLE(2, 3, 0, 1)));
+    s1 = (s1 + (unsigned)_mm_cvtsi128_si32(sum1)) % 65521u;
+    s2 = (unsigned)_mm_cvtsi128_si32(sum2) % 65521u;
+  }
+  return update_adler32Scalar((s2 << 16u) | s1, data, len);
+}
+#endif /*LODEPNG_SIMD_X86*/
+
+static unsigned update_adler32(unsigned adler, const unsigned char* data, unsigned len) {
+#ifdef LODEPNG_SIMD_X86
+  if(len >= 64u) {
+    unsigned features = lodepng_cpu_features();
+    if(features & LCPU_AVX2) return update_adler32AVX2(adler, data, len);
+    if(features & LCPU_SSSE3) return update_adler32SSSE3(adler, data, len);
+  }
+#endif /*LODEPNG_SIMD_X86*/
+  return update_adler32Scalar(adler, data, len);
+}
+
 /*Return the adler32 of the bytes data[0..len-1]*/
 static unsigned adler32(const unsigned char* data, unsigned len) {
   return update_adler32(1u, data, len);
@@ -2150,13 +3408,10 @@ static unsigned adler32(const unsigned char* data, unsigned len) {
 
 #ifdef LODEPNG_COMPILE_DECODER
 
-static unsigned lodepng_zlib_decompressv(ucvector* out,
-                                         const unsigned char* in, size_t insize,
-                                         const LodePNGDecompressSettings* settings) {
-  unsigned error = 0;
+/*checks the two bytes of the zlib header, returns error code*/
+static unsigned checkZlibHeader(const unsigned char* in) {
   unsigned CM, CINFO, FDICT;
 
-  if(insize < 2) return 53; /*error, size of zlib data too small*/
   /*read information from zlib header*/
   if((in[0] * 256 + in[1]) % 31 != 0) {
     /*error: 256 * in[0] + in[1] must be a multiple of 31, the FCHECK value is supposed to be made that way*/
@@ -2178,6 +3433,17 @@ static unsigned lodepng_zlib_decompressv(ucvector* out,
       "The additional flags shall not specify a preset dictionary."*/
     return 26;
   }
+  return 0;
+}
+
+static unsigned lodepng_zlib_decompressv(ucvector* out,
+                                         const unsigned char* in, size_t insize,
+                                         const LodePNGDecompressSettings* settings) {
+  unsigned error = 0;
+
+  if(insize < 2) return 53; /*error, size of zlib data too small*/
+  error = checkZlibHeader(in);
+  if(error) return error;
 
   error = inflatev(out, in + 2, insize - 2, settings);
   if(error) return error;
@@ -2201,6 +3467,209 @@ unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const uns
   return error;
 }
 
+#ifdef LODEPNG_COMPILE_PNG
+/*
+Inflate of a zlib stream that arrives in pieces, for the streaming PNG decoder. Input is appended to in, and
+decoded only as far as it surely reaches, so that nothing is split between pieces: Huffman symbols up to the
+last 16 bytes and a block header once INFLATE_STREAM_HEADER bytes are there, or everything when the input is
+complete. out holds the last 32K of output that matches may refer to, followed by the output not taken yet.
+The custom_zlib and custom_inflate settings are not used.
+*/
+typedef struct InflateStream {
+  ucvector in; /*input not consumed yet, from bit bp on*/
+  size_t bp;
+  ucvector out;
+  size_t taken; /*the output before this index was taken by the caller*/
+  size_t checked; /*the output before this index is included in adler*/
+  unsigned adler;
+  unsigned mode; /*what comes next in the stream, one of the INFLATE_STREAM_ values below*/
+  unsigned final; /*the current block is the last one*/
+  size_t stored; /*bytes left of the current stored block*/
+  HuffmanTree tree_ll;
+  HuffmanTree tree_d;
+  unsigned* fast; /*table of inflateFastTable for tree_ll*/
+} InflateStream;
+
+#define INFLATE_STREAM_ZLIB 0u /*the zlib header*/
+#define INFLATE_STREAM_BLOCK 1u /*a block header*/
+#define INFLATE_STREAM_STORED 2u /*the data of a stored block*/
+#define INFLATE_STREAM_HUFFMAN 3u /*the symbols of a Huffman block*/
+#define INFLATE_STREAM_ADLER 4u /*the Adler-32 checksum after the last block*/
+#define INFLATE_STREAM_DONE 5u
+
+/*input needed before a block header is read: a dynamic Huffman block header is at most about 290 bytes*/
+#define INFLATE_STREAM_HEADER 1024u
+#define INFLATE_STREAM_WINDOW 32768u
+
+static void InflateStream_init(InflateStream* s) {
+  s->in = ucvector_init(NULL, 0);
+  s->out = ucvector_init(NULL, 0);
+  s->bp = s->taken = s->checked = s->stored = 0;
+  s->adler = 1;
+  s->mode = INFLATE_STREAM_ZLIB;
+  s->final = 0;
+  HuffmanTree_init(&s->tree_ll);
+  HuffmanTree_init(&s->tree_d);
+  s->fast = 0;
+}
+
+static void InflateStream_cleanup(InflateStream* s) {
+  lodepng_free(s->in.data);
+  lodepng_free(s->out.data);
+  HuffmanTree_cleanup(&s->tree_ll);
+  HuffmanTree_cleanup(&s->tree_d);
+  lodepng_free(s->fast);
+}
+
+static unsigned InflateStream_push(InflateStream* s, const unsigned char* data, size_t size) {
+  size_t pos = s->in.size;
+  if(!size || s->mode == INFLATE_STREAM_DONE) return 0; /*data after the end of the stream is ignored*/
+  if(!ucvector_resize(&s->in, pos + size)) return 83; /*alloc fail*/
+  lodepng_memcpy(s->in.data + pos, data, size);
+  return 0;
+}
+
+/*reads a block header, and for a stored block also its length*/
+static unsigned InflateStream_block(InflateStream* s, LodePNGBitReader* reader,
+                                    const LodePNGDecompressSettings* settings) {
+  unsigned btype, error = 0;
+  if(reader->bitsize - reader->bp < 3) return 52; /*error, bit pointer will jump past memory*/
+  ensureBits9(reader, 3);
+  s->final = readBits(reader, 1);
+  btype = readBits(reader, 2);
+  if(btype == 3) return 20; /*error: invalid BTYPE*/
+  if(btype == 0) {
+    /*as in inflateNoCompression*/
+    size_t bytepos = (reader->bp + 7u) >> 3u;
+    unsigned LEN, NLEN;
+    if(bytepos + 4 >= reader->size) return 52; /*error, bit pointer will jump past memory*/
+    LEN = (unsigned)reader->data[bytepos] + ((unsigned)reader->data[bytepos + 1] << 8u);
+    NLEN = (unsigned)reader->data[bytepos + 2] + ((unsigned)reader->data[bytepos + 3] << 8u);
+    if(!settings->ignore_nlen && LEN + NLEN != 65535) return 21; /*error: NLEN is not one's complement of LEN*/
+    reader->bp = (bytepos + 4) << 3u;
+    s->stored = LEN;
+    s->mode = INFLATE_STREAM_STORED;
+    return 0;
+  }
+  HuffmanTree_cleanup(&s->tree_ll);
+  HuffmanTree_cleanup(&s->tree_d);
+  HuffmanTree_init(&s->tree_ll);
+  HuffmanTree_init(&s->tree_d);
+  if(btype == 1) error = getTreeInflateFixed(&s->tree_ll, &s->tree_d);
+  else error = getTreeInflateDynamic(&s->tree_ll, &s->tree_d, reader);
+#ifdef LODEPNG_INFLATE_FAST
+  if(!error && !s->fast) {
+    s->fast = (unsigned*)lodepng_malloc((1u << FASTBITS) * sizeof(unsigned));
+    if(!s->fast) error = 83; /*alloc fail*/
+  }
+  if(!error) inflateFastTable(s->fast, &s->tree_ll);
+#endif /*LODEPNG_INFLATE_FAST*/
+  s->mode = INFLATE_STREAM_HUFFMAN;
+  return error;
+}
+
+/*
+Decodes as much of the input in from bit bp on as possible, but stops once limit bytes of output are not taken yet.
+last means that all input was given, reaching its end before the end of the stream is then an error. The input is
+normally in, but decodeIdat gives the data of an IDAT chunk where it is.
+*/
+static unsigned InflateStream_decode(InflateStream* s, const unsigned char* in, size_t insize,
+                                     const LodePNGDecompressSettings* settings, unsigned last, size_t limit) {
+  LodePNGBitReader reader;
+  unsigned error = LodePNGBitReader_init(&reader, in, insize);
+  if(error) return error;
+  reader.bp = s->bp;
+
+  while(!error && s->mode != INFLATE_STREAM_DONE) {
+    size_t bytepos = (reader.bp + 7u) >> 3u; /*the next whole byte*/
+    size_t avail = bytepos < insize ? insize - bytepos : 0;
+    if(s->mode == INFLATE_STREAM_ZLIB) {
+      if(avail < 2) {
+        if(last) error = 53; /*error, size of zlib data too small*/
+        break;
+      }
+      error = checkZlibHeader(in + bytepos);
+      reader.bp += 16;
+      s->mode = INFLATE_STREAM_BLOCK;
+    } else if(s->mode == INFLATE_STREAM_BLOCK) {
+      if(s->final) {
+        s->mode = INFLATE_STREAM_ADLER;
+      } else {
+        if(!last && avail < INFLATE_STREAM_HEADER) break;
+        error = InflateStream_block(s, &reader, settings);
+      }
+    } else if(s->mode == INFLATE_STREAM_STORED) {
+      size_t n = LODEPNG_MIN(s->stored, avail);
+      if(s->out.size - s->taken >= limit) break;
+      n = LODEPNG_MIN(n, limit - (s->out.size - s->taken));
+      if(n) {
+        if(!ucvector_resize(&s->out, s->out.size + n)) ERROR_BREAK(83); /*alloc fail*/
+        lodepng_memcpy(s->out.data + s->out.size - n, in + bytepos, n);
+        reader.bp += n << 3u;
+        s->stored -= n;
+      }
+      if(!s->stored) {
+        s->mode = INFLATE_STREAM_BLOCK;
+      } else if(n == avail) {
+        if(last) error = 23; /*error: reading outside of in buffer*/
+        break;
+      }
+    } else if(s->mode == INFLATE_STREAM_HUFFMAN) {
+      int done = 0;
+      if(s->out.size - s->taken >= limit) break;
+      error = inflateHuffmanSymbols(&s->out, &reader, s->fast, &s->tree_ll, &s->tree_d, last ? 0 : 16,
+                                    s->taken + limit, 0, &done);
+      if(!done) break; /*stopped for the input or the output limit*/
+      s->mode = INFLATE_STREAM_BLOCK;
+    } else /*if(s->mode == INFLATE_STREAM_ADLER)*/ {
+      if(avail < 4) {
+        if(last && !settings->ignore_adler32) error = 58; /*error, adler checksum not correct*/
+        if(last) s->mode = INFLATE_STREAM_DONE;
+        break;
+      }
+      if(!settings->ignore_adler32) {
+        s->adler = update_adler32(s->adler, s->out.data + s->checked, (unsigned)(s->out.size - s->checked));
+        s->checked = s->out.size;
+        if(lodepng_read32bitInt(in + bytepos) != s->adler) error = 58; /*error, adler checksum not correct*/
+      }
+      reader.bp = (bytepos + 4) << 3u;
+      s->mode = INFLATE_STREAM_DONE;
+    }
+  }
+
+  s->bp = reader.bp;
+  return error;
+}
+
+/*decodes the input pushed to in*/
+static unsigned InflateStream_run(InflateStream* s, const LodePNGDecompressSettings* settings,
+                                  unsigned last, size_t limit) {
+  return InflateStream_decode(s, s->in.data, s->in.size, settings, last, limit);
+}
+
+/*marks all output as taken, and drops the output before the last 32K once that is twice as much as needed*/
+static void InflateStream_take(InflateStream* s) {
+  s->taken = s->out.size;
+  if(s->taken > 2 * INFLATE_STREAM_WINDOW) {
+    size_t i, drop = s->taken - INFLATE_STREAM_WINDOW;
+    s->adler = update_adler32(s->adler, s->out.data + s->checked, (unsigned)(s->out.size - s->checked));
+    /*moved down in place, lodepng_memcpy does not allow overlap*/
+    for(i = drop; i != s->out.size; ++i) s->out.data[i - drop] = s->out.data[i];
+    s->out.size -= drop;
+    s->taken = s->checked = s->out.size;
+  }
+}
+
+/*drops the consumed input, once it is at least half of the input so that moving the rest down stays cheap*/
+static void InflateStream_compact(InflateStream* s) {
+  size_t i, drop = LODEPNG_MIN(s->bp >> 3u, s->in.size);
+  if(!drop || drop < s->in.size - drop) return;
+  for(i = drop; i != s->in.size; ++i) s->in.data[i - drop] = s->in.data[i];
+  s->in.size -= drop;
+  s->bp -= drop << 3u;
+}
+#endif /*LODEPNG_COMPILE_PNG*/
+
 /*expected_size is expected output size, to avoid intermediate allocations. Set to 0 if not known. */
 static unsigned zlib_decompress(unsigned char** out, size_t* outsize, size_t expected_size,
                                 const unsigned char* in, size_t insize, const LodePNGDecompressSettings* settings) {
@@ -2216,8 +3685,8 @@ static unsigned zlib_decompress(unsigned char** out, size_t* outsize, size_t exp
   } else {
     ucvector v = ucvector_init(*out, *outsize);
     if(expected_size) {
-      /*reserve the memory to avoid intermediate reallocations*/
-      ucvector_resize(&v, *outsize + expected_size);
+      /*reserve the memory to avoid intermediate reallocations, with the room inflate keeps free at the end*/
+      ucvector_resize(&v, *outsize + expected_size + INFLATE_FAST_SLACK);
       v.size = *outsize;
     }
     error = lodepng_zlib_decompressv(&v, in, insize, settings);
@@ -2231,13 +3700,37 @@ static unsigned zlib_decompress(unsigned char** out, size_t* outsize, size_t exp
 
 #ifdef LODEPNG_COMPILE_ENCODER
 
+/*the 2 bytes CMF and FLG that start the zlib data*/
+static void writeZlibHeader(unsigned char* out, const LodePNGCompressSettings* settings) {
+  unsigned CMF = 120; /*0b01111000: CM 8, CINFO 7. With CINFO 7, any window size up to 32768 can be used.*/
+  /*informative only: 0 fastest, 1 fast, 2 default, 3 maximum compression*/
+  unsigned FLEVEL = settings->level <= 1 ? 0 : settings->level < 6 ? 1 : settings->level == 6 ? 2 : 3;
+  unsigned FDICT = 0;
+  unsigned CMFFLG = 256 * CMF + FDICT * 32 + FLEVEL * 64;
+  unsigned FCHECK = 31 - CMFFLG % 31;
+  CMFFLG += FCHECK;
+  out[0] = (unsigned char)(CMFFLG >> 8);
+  out[1] = (unsigned char)(CMFFLG & 255);
+}
+
 unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize, const unsigned char* in,
                                size_t insize, const LodePNGCompressSettings* settings) {
   size_t i;
   unsigned error;
   unsigned char* deflatedata = 0;
   size_t deflatesize = 0;
-
+  unsigned ADLER32 = 0, haveadler = 0;
+#ifdef LODEPNG_COMPILE_THREADS
+  unsigned numthreads = lodepng_num_threads(settings->num_threads);
+  if(!settings->custom_deflate && (settings->btype == 1 || settings->btype == 2) && insize > 65536u && numthreads > 1) {
+    /*the checksum is computed per block on the compressing threads as well*/
+    ucvector v = ucvector_init(NULL, 0);
+    error = deflateParallel(&v, in, insize, settings, numthreads, &ADLER32);
+    deflatedata = v.data;
+    deflatesize = v.size;
+    haveadler = 1;
+  } else
+#endif /*LODEPNG_COMPILE_THREADS*/
   error = deflate(&deflatedata, &deflatesize, in, insize, settings);
 
   *out = NULL;
@@ -2249,17 +3742,10 @@ unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize, const unsig
   }
 
   if(!error) {
-    unsigned ADLER32 = adler32(in, (unsigned)insize);
     /*zlib data: 1 byte CMF (CM+CINFO), 1 byte FLG, deflate data, 4 byte ADLER32 checksum of the Decompressed data*/
-    unsigned CMF = 120; /*0b01111000: CM 8, CINFO 7. With CINFO 7, any window size up to 32768 can be used.*/
-    unsigned FLEVEL = 0;
-    unsigned FDICT = 0;
-    unsigned CMFFLG = 256 * CMF + FDICT * 32 + FLEVEL * 64;
-    unsigned FCHECK = 31 - CMFFLG % 31;
-    CMFFLG += FCHECK;
-
-    (*out)[0] = (unsigned char)(CMFFLG >> 8);
-    (*out)[1] = (unsigned char)(CMFFLG & 255);
+    if(!haveadler) ADLER32 = adler32(in, (unsigned)insize);
+
+    writeZlibHeader(*out, settings);
     for(i = 0; i != deflatesize; ++i) (*out)[i + 2] = deflatedata[i];
     lodepng_set32bitInt(&(*out)[*outsize - 4], ADLER32);
   }
@@ -2268,6 +3754,125 @@ unsigned lodepng_zlib_compress(unsigned char** out, size_t* outsize, const unsig
   return error;
 }
 
+#ifdef LODEPNG_COMPILE_PNG
+/*
+Zlib compression of input that arrives in pieces, for the streaming PNG encoder. The size of the whole input
+must be known up front: the blocks are then those lodepng_deflatev chooses, and the result is the same. The
+hash is kept over all blocks, and the input is only moved down by multiples of 32K so that the positions in
+the hash stay valid. The custom_zlib, custom_deflate and num_threads settings are not used, and btype 1 uses
+blocks of the same size as btype 2 rather than a single block.
+*/
+typedef struct DeflateStream {
+  ucvector in; /*at least the window before pos, then the input not compressed yet*/
+  size_t pos;
+  size_t blocksize;
+  unsigned btype;
+  unsigned hashed; /*whether hash is initialized, it is not used for stored blocks*/
+  DeflateParams params;
+  Hash hash;
+  ucvector out; /*the output not taken yet, the last byte may be incomplete*/
+  LodePNGBitWriter writer;
+  unsigned adler;
+} DeflateStream;
+
+/*the move of the input keeps 32K before pos, which is the largest window*/
+#define DEFLATE_STREAM_WINDOW 32768u
+
+static unsigned DeflateStream_init(DeflateStream* s, size_t insize, const LodePNGCompressSettings* settings) {
+  s->in = ucvector_init(NULL, 0);
+  s->out = ucvector_init(NULL, 0);
+  s->pos = 0;
+  s->btype = settings->btype;
+  s->hashed = 0;
+  s->adler = 1;
+  LodePNGBitWriter_init(&s->writer, &s->out);
+  deflateParams(&s->params, settings);
+  if(s->btype > 2) return 61; /*error: invalid btype*/
+  if(s->btype == 0) {
+    s->blocksize = 65535;
+  } else {
+    s->blocksize = deflateBlockSize(insize, &s->params);
+    s->hashed = 1; /*cleaned up even if hash_init fails*/
+    CERROR_TRY_RETURN(hash_init(&s->hash, s->params.windowsize));
+  }
+  if(!ucvector_resize(&s->out, 2)) return 83; /*alloc fail*/
+  writeZlibHeader(s->out.data, settings);
+  return 0;
+}
+
+static void DeflateStream_cleanup(DeflateStream* s) {
+  lodepng_free(s->in.data);
+  lodepng_free(s->out.data);
+  if(s->hashed) hash_cleanup(&s->hash);
+}
+
+/*compresses the input from pos to end as one block*/
+static unsigned DeflateStream_block(DeflateStream* s, size_t end, unsigned final) {
+  unsigned error = 0;
+  if(s->btype == 0) {
+    /*as in deflateNoCompression*/
+    size_t pos = s->out.size;
+    unsigned LEN = (unsigned)(end - s->pos), NLEN = 65535 - LEN;
+    if(!ucvector_resize(&s->out, pos + LEN + 5)) return 83; /*alloc fail*/
+    s->out.data[pos + 0] = (unsigned char)final;
+    s->out.data[pos + 1] = (unsigned char)(LEN & 255);
+    s->out.data[pos + 2] = (unsigned char)(LEN >> 8u);
+    s->out.data[pos + 3] = (unsigned char)(NLEN & 255);
+    s->out.data[pos + 4] = (unsigned char)(NLEN >> 8u);
+    lodepng_memcpy(s->out.data + pos + 5, s->in.data + s->pos, LEN);
+  } else if(s->btype == 1) {
+    error = deflateFixed(&s->writer, &s->hash, s->in.data, s->pos, end, &s->params, final);
+  } else {
+    error = deflateDynamic(&s->writer, &s->hash, s->in.data, s->pos, end, &s->params, final);
+  }
+  s->adler = update_adler32(s->adler, s->in.data + s->pos, (unsigned)(end - s->pos));
+  s->pos = end;
+  return error;
+}
+
+/*adds input, and compresses every complete block that is not the last one*/
+static unsigned DeflateStream_push(DeflateStream* s, const unsigned char* data, size_t size) {
+  size_t i, drop, pos = s->in.size;
+  if(!ucvector_resize(&s->in, pos + size)) return 83; /*alloc fail*/
+  lodepng_memcpy(s->in.data + pos, data, size);
+  /*a block is only compressed once more input follows it, the last one must be final*/
+  while(s->in.size - s->pos > s->blocksize) CERROR_TRY_RETURN(DeflateStream_block(s, s->pos + s->blocksize, 0));
+
+  if(s->pos >= 2 * DEFLATE_STREAM_WINDOW) {
+    drop = (s->pos - DEFLATE_STREAM_WINDOW) & ~(size_t)(DEFLATE_STREAM_WINDOW - 1u);
+    /*moved down in place, lodepng_memcpy does not allow overlap*/
+    for(i = drop; i != s->in.size; ++i) s->in.data[i - drop] = s->in.data[i];
+    s->in.size -= drop;
+    s->pos -= drop;
+  }
+  return 0;
+}
+
+/*compresses the rest of the input as the final block, followed by the Adler-32*/
+static unsigned DeflateStream_finish(DeflateStream* s) {
+  size_t pos;
+  CERROR_TRY_RETURN(DeflateStream_block(s, s->in.size, 1));
+  pos = s->out.size;
+  if(!ucvector_resize(&s->out, pos + 4)) return 83; /*alloc fail*/
+  lodepng_set32bitInt(s->out.data + pos, s->adler);
+  s->writer.bp = 0;
+  return 0;
+}
+
+/*the number of bytes at the start of out that are complete*/
+static size_t DeflateStream_complete(const DeflateStream* s) {
+  return (s->writer.bp & 7u) ? s->out.size - 1u : s->out.size;
+}
+
+/*removes the first size bytes of out, which were taken*/
+static void DeflateStream_take(DeflateStream* s, size_t size) {
+  size_t i;
+  if(!size) return;
+  for(i = size; i != s->out.size; ++i) s->out.data[i - size] = s->out.data[i];
+  s->out.size -= size;
+}
+#endif /*LODEPNG_COMPILE_PNG*/
+
 /* compress using the default or custom zlib function */
 static unsigned zlib_compress(unsigned char** out, size_t* outsize, const unsigned char* in,
                               size_t insize, const LodePNGCompressSettings* settings) {
@@ -2317,13 +3922,16 @@ void lodepng_compress_settings_init(LodePNGCompressSettings* settings) {
   settings->minmatch = 3;
   settings->nicematch = 128;
   settings->lazymatching = 1;
+  settings->level = LCL_DEFAULT;
+  settings->iterations = 5;
+  settings->num_threads = 1;
 
   settings->custom_zlib = 0;
   settings->custom_deflate = 0;
   settings->custom_context = 0;
 }
 
-const LodePNGCompressSettings lodepng_default_compress_settings = {2, 1, DEFAULT_WINDOWSIZE, 3, 128, 1, 0, 0, 0};
+const LodePNGCompressSettings lodepng_default_compress_settings = {2, 1, DEFAULT_WINDOWSIZE, 3, 128, 1, LCL_DEFAULT, 5, 1, 0, 0, 0};
 
 
 #endif /*LODEPNG_COMPILE_ENCODER*/
@@ -2639,10 +4247,8 @@ static const unsigned lodepng_crc32_table7[256] = {
   0x2c8e0fffu, 0xe0240f61u, 0x6eab0882u, 0xa201081cu, 0xa8c40105u, 0x646e019bu, 0xeae10678u, 0x264b06e6u
 };
 
-/* Computes the cyclic redundancy check as used by PNG chunks*/
-unsigned lodepng_crc32(const unsigned char* data, size_t length) {
-  /*Using the Slicing by Eight algorithm*/
-  unsigned r = 0xffffffffu;
+/*the table version above, continuing from the (not inverted) state r*/
+static unsigned crc32Slice8(unsigned r, const unsigned char* data, size_t length) {
   while(length >= 8) {
     r = lodepng_crc32_table7[(data[0] ^ (r & 0xffu))] ^
         lodepng_crc32_table6[(data[1] ^ ((r >> 8) & 0xffu))] ^
@@ -2658,7 +4264,109 @@ unsigned lodepng_crc32(const unsigned char* data, size_t length) {
   while(length--) {
     r = lodepng_crc32_table0[(r ^ *data++) & 0xffu] ^ (r >> 8);
   }
-  return r ^ 0xffffffffu;
+  return r;
+}
+
+#ifdef LODEPNG_SIMD_X86
+/*
+CRC-32 by folding with carry-less multiplication ("Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+Instruction", Intel). Four 128-bit accumulators are folded forward by 64 bytes per step, then into one, and
+reduced to 32 bits with a Barrett reduction. length must be at least 64 and a multiple of 16.
+*/
+LODEPNG_TARGET("pclmul,sse4.1")
+static unsigned crc32PCLMUL(unsigned r, const unsigned char* data, size_t length) {
+  const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596ll, 0x0154442bd4ll); /*x^(4*128+32), x^(4*128-32) mod P*/
+  const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009ell, 0x01751997d0ll); /*x^(128+32), x^(128-32) mod P*/
+  const __m128i k5 = _mm_set_epi64x(0, 0x0163cd6124ll); /*x^64 mod P*/
+  const __m128i poly = _mm_set_epi64x(0x01f7011641ll, 0x01db710641ll); /*P and the Barrett constant*/
+  const __m128i mask32 = _mm_setr_epi32(-1, 0, -1, 0);
+  __m128i x0, x1, x2, x3, x4, t1, t2, t3, t4;
+
+  x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(data + 0)), _mm_cvtsi32_si128((int)r));
+  x2 = _mm_loadu_si128((const __m128i*)(data + 16));
+  x3 = _mm_loadu_si128((const __m128i*)(data + 32));
+  x4 = _mm_loadu_si128((const __m128i*)(data + 48));
+  data += 64;
+  length -= 64;
+
+  while(length >= 64) {
+    t1 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+    t2 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+    t3 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+    t4 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k1k2, 0x11), t1);
+    x2 = _mm_xor_si128(_mm_clmulepi64_si128(x2, k1k2, 0x11), t2);
+    x3 = _mm_xor_si128(_mm_clmulepi64_si128(x3, k1k2, 0x11), t3);
+    x4 = _mm_xor_si128(_mm_clmulepi64_si128(x4, k1k2, 0x11), t4);
+    x1 = _mm_xor_si128(x1, _mm_loadu_si128((const __m128i*)(data + 0)));
+    x2 = _mm_xor_si128(x2, _mm_loadu_si128((const __m128i*)(data + 16)));
+    x3 = _mm_xor_si128(x3, _mm_loadu_si128((const __m128i*)(data + 32)));
+    x4 = _mm_xor_si128(x4, _mm_loadu_si128((const __m128i*)(data + 48)));
+    data += 64;
+    length -= 64;
+  }
+
+  /*fold the four accumulators into one, then the remaining 16 byte blocks*/
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_clmulepi64_si128(x1, k3k4, 0x00)), x2);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_clmulepi64_si128(x1, k3k4, 0x00)), x3);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_clmulepi64_si128(x1, k3k4, 0x00)), x4);
+  while(length >= 16) {
+    x2 = _mm_loadu_si128((const __m128i*)data);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_clmulepi64_si128(x1, k3k4, 0x00)), x2);
+    data += 16;
+    length -= 16;
+  }
+
+  /*128 to 64 bits*/
+  x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5, 0x00), x2);
+
+  /*Barrett reduction to 32 bits*/
+  x0 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly, 0x10);
+  x0 = _mm_clmulepi64_si128(_mm_and_si128(x0, mask32), poly, 0x00);
+  x1 = _mm_xor_si128(x1, x0);
+  return (unsigned)_mm_extract_epi32(x1, 1);
+}
+#endif /*LODEPNG_SIMD_X86*/
+
+#ifdef LODEPNG_SIMD_ARM_CRC32
+/*the ARMv8 CRC32 instructions use the same (reflected) polynomial as PNG*/
+LODEPNG_TARGET(LODEPNG_TARGET_ARM_CRC32)
+static unsigned crc32ARM(unsigned r, const unsigned char* data, size_t length) {
+  while(length >= 8) {
+    unsigned long long word;
+    lodepng_memcpy(&word, data, 8); /*little endian*/
+    r = __crc32d(r, word);
+    data += 8;
+    length -= 8;
+  }
+  while(length--) r = __crc32b(r, *data++);
+  return r;
+}
+#endif /*LODEPNG_SIMD_ARM_CRC32*/
+
+/*continues a CRC-32 with more bytes: crc is the CRC of the bytes before them, 0 if there are none*/
+static unsigned crc32Update(unsigned crc, const unsigned char* data, size_t length) {
+  unsigned r = crc ^ 0xffffffffu;
+#if defined(LODEPNG_SIMD_X86)
+  if(length >= 64 && (lodepng_cpu_features() & (LCPU_PCLMUL | LCPU_SSE41)) == (LCPU_PCLMUL | LCPU_SSE41)) {
+    size_t folded = length & ~(size_t)15u;
+    r = crc32PCLMUL(r, data, folded);
+    data += folded;
+    length -= folded;
+  }
+#elif defined(LODEPNG_SIMD_ARM_CRC32)
+  if(lodepng_cpu_features() & LCPU_ARM_CRC32) return crc32ARM(r, data, length) ^ 0xffffffffu;
+#endif
+  /*Using the Slicing by Eight algorithm*/
+  return crc32Slice8(r, data, length) ^ 0xffffffffu;
+}
+
+/* Computes the cyclic redundancy check as used by PNG chunks*/
+unsigned lodepng_crc32(const unsigned char* data, size_t length) {
+  return crc32Update(0, data, length);
 }
 #else /* LODEPNG_COMPILE_CRC */
 /*in this case, the function is only declared here, and must be defined externally
@@ -4317,6 +6025,16 @@ static unsigned char paethPredictor(unsigned char a, unsigned char b, unsigned c
   return (pc < pa) ? c : a;
 }
 
+#ifdef LODEPNG_SIMD_X86
+/*The Paeth predictor on 16-bit lanes: pa = |b - c|, pb = |a - c|, pc = |a + b - 2c|, ties prefer a, then b*/
+static LODEPNG_INLINE __m128i paethSelect(__m128i a, __m128i b, __m128i c, __m128i pa, __m128i pb, __m128i pc) {
+  __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+  __m128i useA = _mm_cmpeq_epi16(pa, smallest), useB = _mm_cmpeq_epi16(pb, smallest);
+  __m128i bc = _mm_or_si128(_mm_and_si128(useB, b), _mm_andnot_si128(useB, c));
+  return _mm_or_si128(_mm_and_si128(useA, a), _mm_andnot_si128(useA, bc));
+}
+#endif /*LODEPNG_SIMD_X86*/
+
 /*shared values used by multiple Adam7 related functions*/
 
 static const unsigned ADAM7_IX[7] = { 0, 4, 0, 2, 0, 1, 0 }; /*x start values*/
@@ -4435,6 +6153,174 @@ unsigned lodepng_inspect(unsigned* w, unsigned* h, LodePNGState* state,
   return state->error;
 }
 
+#ifdef LODEPNG_SIMD_X86
+/*
+SIMD unfiltering for 3 and 4 bytes per pixel (8-bit RGB and RGBA), the common case for photographic images.
+Sub, Avg and Paeth depend on the previous pixel, so they run one pixel per step with all channels in one
+register (Sub with 4 bytes per pixel uses a prefix sum over 4 pixels instead). Up has no such dependency
+and runs 16 or 32 bytes per step. Loads and stores never touch bytes outside the scanline, and each pixel
+is read before it is written, so recon and scanline may still be the same buffer.
+*/
+static LODEPNG_INLINE __m128i loadPixel4(const unsigned char* p) { int v; lodepng_memcpy(&v, p, 4); return _mm_cvtsi32_si128(v); }
+static LODEPNG_INLINE __m128i loadPixel3(const unsigned char* p) { int v = 0; lodepng_memcpy(&v, p, 3); return _mm_cvtsi32_si128(v); }
+static LODEPNG_INLINE void storePixel4(unsigned char* p, __m128i x) { int v = _mm_cvtsi128_si32(x); lodepng_memcpy(p, &v, 4); }
+static LODEPNG_INLINE void storePixel3(unsigned char* p, __m128i x) { int v = _mm_cvtsi128_si32(x); lodepng_memcpy(p, &v, 3); }
+
+/*a 4-byte load for a 3-byte pixel is fine until the last pixel: the extra byte is ignored by the byte-wise math*/
+#define LODEPNG_LOAD_PIXEL(p, i, bytewidth, length) \
+  (((bytewidth) == 4 || (i) + 4 <= (length)) ? loadPixel4((p) + (i)) : loadPixel3((p) + (i)))
+#define LODEPNG_STORE_PIXEL(p, i, bytewidth, x) \
+  if((bytewidth) == 4) storePixel4((p) + (i), x); else storePixel3((p) + (i), x)
+
+static void unfilterSubSSE2(unsigned char* recon, const unsigned char* scanline, size_t bytewidth, size_t length) {
+  size_t i = 0;
+  __m128i a = _mm_setzero_si128(), x;
+  if(bytewidth == 4) {
+    for(; i + 16 <= length; i += 16) { /*prefix sum of 4 pixels, plus the last pixel of the previous step*/
+      x = _mm_loadu_si128((const __m128i*)(scanline + i));
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+      x = _mm_add_epi8(x, a);
+      _mm_storeu_si128((__m128i*)(recon + i), x);
+      a = _mm_shuffle_epi32(x, 0xFF);
+    }
+  }
+  for(; i < length; i += bytewidth) {
+    x = _mm_add_epi8(LODEPNG_LOAD_PIXEL(scanline, i, bytewidth, length), a);
+    LODEPNG_STORE_PIXEL(recon, i, bytewidth, x);
+    a = x;
+  }
+}
+
+LODEPNG_TARGET("ssse3")
+static void unfilterSub3SSSE3(unsigned char* recon, const unsigned char* scanline, size_t length) {
+  size_t i = 0;
+  /*broadcast of the 4th pixel (bytes 9..11) of the previous step into pixels 0..3*/
+  const __m128i last = _mm_setr_epi8(9, 10, 11, 9, 10, 11, 9, 10, 11, 9, 10, 11, -1, -1, -1, -1);
+  __m128i a = _mm_setzero_si128(), x;
+  for(; i + 16 <= length; i += 12) { /*prefix sum of 4 pixels (12 bytes) per step*/
+    x = _mm_loadu_si128((const __m128i*)(scanline + i));
+    x = _mm_add_epi8(x, _mm_slli_si128(x, 3));
+    x = _mm_add_epi8(x, _mm_slli_si128(x, 6));
+    x = _mm_add_epi8(x, a);
+    _mm_storel_epi64((__m128i*)(recon + i), x); /*only 12 bytes: the rest of scanline is still unread*/
+    storePixel4(recon + i + 8, _mm_srli_si128(x, 8));
+    a = _mm_shuffle_epi8(x, last);
+  }
+  for(; i < length; i += 3) {
+    x = _mm_add_epi8(LODEPNG_LOAD_PIXEL(scanline, i, 3, length), a);
+    storePixel3(recon + i, x);
+    a = x;
+  }
+}
+
+static void unfilterUpSSE2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, size_t length) {
+  size_t i = 0;
+  for(; i + 16 <= length; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(scanline + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(precon + i));
+    _mm_storeu_si128((__m128i*)(recon + i), _mm_add_epi8(x, b));
+  }
+  for(; i != length; ++i) recon[i] = scanline[i] + precon[i];
+}
+
+LODEPNG_TARGET("avx2")
+static void unfilterUpAVX2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon, size_t length) {
+  size_t i = 0;
+  for(; i + 32 <= length; i += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(scanline + i));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(precon + i));
+    _mm256_storeu_si256((__m256i*)(recon + i), _mm256_add_epi8(x, b));
+  }
+  for(; i != length; ++i) recon[i] = scanline[i] + precon[i];
+}
+
+static void unfilterAvgSSE2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                            size_t bytewidth, size_t length) {
+  size_t i;
+  const __m128i one = _mm_set1_epi8(1);
+  __m128i a = _mm_setzero_si128();
+  for(i = 0; i < length; i += bytewidth) {
+    __m128i b = LODEPNG_LOAD_PIXEL(precon, i, bytewidth, length);
+    __m128i x = LODEPNG_LOAD_PIXEL(scanline, i, bytewidth, length);
+    /*floor((a + b) / 2): _mm_avg_epu8 rounds up, subtract the lost low bit*/
+    __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+    a = _mm_add_epi8(x, avg);
+    LODEPNG_STORE_PIXEL(recon, i, bytewidth, a);
+  }
+}
+
+static void unfilterPaethSSE2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                              size_t bytewidth, size_t length) {
+  size_t i;
+  const __m128i zero = _mm_setzero_si128();
+  __m128i a = zero, c = zero;
+  for(i = 0; i < length; i += bytewidth) {
+    __m128i b = _mm_unpacklo_epi8(LODEPNG_LOAD_PIXEL(precon, i, bytewidth, length), zero);
+    __m128i x = LODEPNG_LOAD_PIXEL(scanline, i, bytewidth, length);
+    __m128i pa = _mm_sub_epi16(b, c), pb = _mm_sub_epi16(a, c);
+    __m128i pc = _mm_add_epi16(pa, pb);
+    pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+    pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+    pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+    x = _mm_add_epi8(x, _mm_packus_epi16(paethSelect(a, b, c, pa, pb, pc), zero));
+    LODEPNG_STORE_PIXEL(recon, i, bytewidth, x);
+    a = _mm_unpacklo_epi8(x, zero);
+    c = b;
+  }
+}
+
+LODEPNG_TARGET("ssse3")
+static void unfilterPaethSSSE3(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                               size_t bytewidth, size_t length) {
+  size_t i;
+  const __m128i zero = _mm_setzero_si128();
+  __m128i a = zero, c = zero;
+  for(i = 0; i < length; i += bytewidth) {
+    __m128i b = _mm_unpacklo_epi8(LODEPNG_LOAD_PIXEL(precon, i, bytewidth, length), zero);
+    __m128i x = LODEPNG_LOAD_PIXEL(scanline, i, bytewidth, length);
+    __m128i pa = _mm_sub_epi16(b, c), pb = _mm_sub_epi16(a, c);
+    __m128i pc = _mm_abs_epi16(_mm_add_epi16(pa, pb));
+    pa = _mm_abs_epi16(pa);
+    pb = _mm_abs_epi16(pb);
+    x = _mm_add_epi8(x, _mm_packus_epi16(paethSelect(a, b, c, pa, pb, pc), zero));
+    LODEPNG_STORE_PIXEL(recon, i, bytewidth, x);
+    a = _mm_unpacklo_epi8(x, zero);
+    c = b;
+  }
+}
+
+/*returns 1 if the scanline was unfiltered by a SIMD kernel, 0 if the portable code has to do it*/
+static int unfilterScanlineSIMD(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                                size_t bytewidth, unsigned char filterType, size_t length) {
+  unsigned features = lodepng_cpu_features();
+  int pixels = bytewidth == 3 || bytewidth == 4;
+  if(!(features & LCPU_SSE2)) return 0;
+  switch(filterType) {
+    case 1:
+      if(!pixels) return 0;
+      if(bytewidth == 3 && (features & LCPU_SSSE3)) unfilterSub3SSSE3(recon, scanline, length);
+      else unfilterSubSSE2(recon, scanline, bytewidth, length);
+      return 1;
+    case 2:
+      if(!precon) return 0;
+      if(features & LCPU_AVX2) unfilterUpAVX2(recon, scanline, precon, length);
+      else unfilterUpSSE2(recon, scanline, precon, length);
+      return 1;
+    case 3:
+      if(!precon || !pixels) return 0;
+      unfilterAvgSSE2(recon, scanline, precon, bytewidth, length);
+      return 1;
+    case 4:
+      if(!precon || !pixels) return 0;
+      if(features & LCPU_SSSE3) unfilterPaethSSSE3(recon, scanline, precon, bytewidth, length);
+      else unfilterPaethSSE2(recon, scanline, precon, bytewidth, length);
+      return 1;
+    default: return 0;
+  }
+}
+#endif /*LODEPNG_SIMD_X86*/
+
 static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
                                  size_t bytewidth, unsigned char filterType, size_t length) {
   /*
@@ -4447,6 +6333,9 @@ static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scan
   */
 
   size_t i;
+#ifdef LODEPNG_SIMD_X86
+  if(unfilterScanlineSIMD(recon, scanline, precon, bytewidth, filterType, length)) return 0;
+#endif /*LODEPNG_SIMD_X86*/
   switch(filterType) {
     case 0:
       for(i = 0; i != length; ++i) recon[i] = scanline[i];
@@ -5281,28 +7170,182 @@ unsigned lodepng_inspect_chunk(LodePNGState* state, size_t pos,
   return error;
 }
 
+/*
+Reads a chunk other than IDAT for decodeGeneric and the streaming decoder, the whole chunk must be in memory.
+Sets iend at the IEND chunk. critical_pos is 1 after IHDR, 2 after PLTE and 3 after IDAT: where unknown chunks
+are remembered.
+*/
+static unsigned decodeChunk(LodePNGState* state, const unsigned char* chunk, unsigned* critical_pos,
+                            unsigned char* iend) {
+  unsigned chunkLength = lodepng_chunk_length(chunk);
+  const unsigned char* data = lodepng_chunk_data_const(chunk);
+  unsigned unknown = 0;
+  unsigned error = 0;
+
+  if(lodepng_chunk_type_equals(chunk, "IEND")) {
+    /*IEND chunk*/
+    *iend = 1;
+  } else if(lodepng_chunk_type_equals(chunk, "PLTE")) {
+    /*palette chunk (PLTE)*/
+    error = readChunk_PLTE(&state->info_png.color, data, chunkLength);
+    *critical_pos = 2;
+  } else if(lodepng_chunk_type_equals(chunk, "tRNS")) {
+    /*palette transparency chunk (tRNS). Even though this one is an ancillary chunk , it is still compiled
+    in without 'LODEPNG_COMPILE_ANCILLARY_CHUNKS' because it contains essential color information that
+    affects the alpha channel of pixels. */
+    error = readChunk_tRNS(&state->info_png.color, data, chunkLength);
+#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
+    /*background color chunk (bKGD)*/
+  } else if(lodepng_chunk_type_equals(chunk, "bKGD")) {
+    error = readChunk_bKGD(&state->info_png, data, chunkLength);
+  } else if(lodepng_chunk_type_equals(chunk, "tEXt")) {
+    /*text chunk (tEXt)*/
+    if(state->decoder.read_text_chunks) {
+      error = readChunk_tEXt(&state->info_png, data, chunkLength);
+    }
+  } else if(lodepng_chunk_type_equals(chunk, "zTXt")) {
+    /*compressed text chunk (zTXt)*/
+    if(state->decoder.read_text_chunks) {
+      error = readChunk_zTXt(&state->info_png, &state->decoder, data, chunkLength);
+    }
+  } else if(lodepng_chunk_type_equals(chunk, "iTXt")) {
+    /*international text chunk (iTXt)*/
+    if(state->decoder.read_text_chunks) {
+      error = readChunk_iTXt(&state->info_png, &state->decoder, data, chunkLength);
+    }
+  } else if(lodepng_chunk_type_equals(chunk, "tIME")) {
+    error = readChunk_tIME(&state->info_png, data, chunkLength);
+  } else if(lodepng_chunk_type_equals(chunk, "pHYs")) {
+    error = readChunk_pHYs(&state->info_png, data, chunkLength);
+  } else if(lodepng_chunk_type_equals(chunk, "gAMA")) {
+    error = readChunk_gAMA(&state->info_png, data, chunkLength);
+  } else if(lodepng_chunk_type_equals(chunk, "cHRM")) {
+    error = readChunk_cHRM(&state->info_png, data, chunkLength);
+  } else if(lodepng_chunk_type_equals(chunk, "sRGB")) {
+    error = readChunk_sRGB(&state->info_png, data, chunkLength);
+  } else if(lodepng_chunk_type_equals(chunk, "iCCP")) {
+    error = readChunk_iCCP(&state->info_png, &state->decoder, data, chunkLength);
+  } else if(lodepng_chunk_type_equals(chunk, "cICP")) {
+    error = readChunk_cICP(&state->info_png, data, chunkLength);
+  } else if(lodepng_chunk_type_equals(chunk, "mDCv")) {
+    error = readChunk_mDCv(&state->info_png, data, chunkLength);
+  } else if(lodepng_chunk_type_equals(chunk, "cLLi")) {
+    error = readChunk_cLLi(&state->info_png, data, chunkLength);
+  } else if(lodepng_chunk_type_equals(chunk, "eXIf")) {
+    error = readChunk_eXIf(&state->info_png, data, chunkLength);
+  } else if(lodepng_chunk_type_equals(chunk, "sBIT")) {
+    error = readChunk_sBIT(&state->info_png, data, chunkLength);
+#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
+  } else /*it's not an implemented chunk type, so ignore it: skip over the data*/ {
+    if(!lodepng_chunk_type_name_valid(chunk)) {
+      return 121; /* invalid chunk type name */
+    }
+    if(lodepng_chunk_reserved(chunk)) {
+      return 122; /* invalid third lowercase character */
+    }
+
+    /*error: unknown critical chunk (5th bit of first byte of chunk type is 0)*/
+    if(!state->decoder.ignore_critical && !lodepng_chunk_ancillary(chunk)) {
+      return 69;
+    }
+
+    unknown = 1;
+#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
+    if(state->decoder.remember_unknown_chunks) {
+      error = lodepng_chunk_append(&state->info_png.unknown_chunks_data[*critical_pos - 1],
+                                   &state->info_png.unknown_chunks_size[*critical_pos - 1], chunk);
+    }
+#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
+  }
+
+  if(!error && !state->decoder.ignore_crc && !unknown) /*check CRC if wanted, only on known chunk types*/ {
+    if(lodepng_chunk_check_crc(chunk)) error = 57; /*invalid CRC*/
+  }
+  return error;
+}
+
+/*size of the decompressed IDAT data: the scanlines with their filter bytes, for all Adam7 passes if interlaced*/
+static size_t getExpectedIdatSize(unsigned w, unsigned h, const LodePNGInfo* info_png) {
+  unsigned bpp = lodepng_get_bpp(&info_png->color);
+  size_t expected_size = 0;
+  if(info_png->interlace_method == 0) {
+    expected_size = lodepng_get_raw_size_idat(w, h, bpp);
+  } else {
+    /*Adam-7 interlaced: expected size is the sum of the 7 sub-images sizes*/
+    expected_size += lodepng_get_raw_size_idat((w + 7) >> 3, (h + 7) >> 3, bpp);
+    if(w > 4) expected_size += lodepng_get_raw_size_idat((w + 3) >> 3, (h + 7) >> 3, bpp);
+    expected_size += lodepng_get_raw_size_idat((w + 3) >> 2, (h + 3) >> 3, bpp);
+    if(w > 2) expected_size += lodepng_get_raw_size_idat((w + 1) >> 2, (h + 3) >> 2, bpp);
+    expected_size += lodepng_get_raw_size_idat((w + 1) >> 1, (h + 1) >> 2, bpp);
+    if(w > 1) expected_size += lodepng_get_raw_size_idat((w + 0) >> 1, (h + 1) >> 1, bpp);
+    expected_size += lodepng_get_raw_size_idat((w + 0), (h + 0) >> 1, bpp);
+  }
+  return expected_size;
+}
+
 /*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
+#ifdef LODEPNG_COMPILE_ZLIB
+/*
+Inflates the data of one IDAT chunk where it is in the PNG, so that the compressed data is not gathered into one
+buffer first. What the inflater cannot decode before the end of the chunk (the last bytes of a symbol, or a block
+header closer than INFLATE_STREAM_HEADER to the end) is copied into s->in, and continued there with as many bytes
+of the next chunk as it takes to get past it. After that the next chunk is decoded in place again.
+*/
+static unsigned decodeIdat(InflateStream* s, const unsigned char* data, size_t size,
+                           const LodePNGDecompressSettings* settings, size_t limit) {
+  size_t pos;
+  if(s->in.size) {
+    size_t start = s->in.size; /*where data begins in s->in*/
+    size_t used = 0; /*bytes of data added to s->in*/
+    while((s->bp >> 3u) < start && used != size) {
+      size_t n = s->mode == INFLATE_STREAM_HUFFMAN ? 64u : INFLATE_STREAM_HEADER + 64u;
+      n = LODEPNG_MIN(n, size - used);
+      CERROR_TRY_RETURN(InflateStream_push(s, data + used, n));
+      used += n;
+      CERROR_TRY_RETURN(InflateStream_run(s, settings, 0, limit));
+    }
+    if((s->bp >> 3u) < start) {
+      /*all of data is in s->in now, or the stream ended*/
+      InflateStream_compact(s);
+      return 0;
+    }
+    s->bp -= start << 3u;
+    s->in.size = 0;
+  }
+  CERROR_TRY_RETURN(InflateStream_decode(s, data, size, settings, 0, limit));
+  pos = LODEPNG_MIN(s->bp >> 3u, size);
+  s->bp -= pos << 3u;
+  return InflateStream_push(s, data + pos, size - pos);
+}
+#endif /*LODEPNG_COMPILE_ZLIB*/
+
 static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
                           LodePNGState* state,
                           const unsigned char* in, size_t insize) {
   unsigned char IEND = 0;
   const unsigned char* chunk; /*points to beginning of next chunk*/
-  unsigned char* idat; /*the data from idat chunks, zlib compressed*/
+  unsigned char* idat = 0; /*the data from idat chunks, zlib compressed, with a custom zlib or inflate*/
   size_t idatsize = 0;
   unsigned char* scanlines = 0;
   size_t scanlines_size = 0, expected_size = 0;
   size_t outsize = 0;
+  const LodePNGDecompressSettings* zlibsettings = &state->decoder.zlibsettings;
+  unsigned inplace = 0; /*the IDAT data is inflated where it is, rather than gathered into idat*/
+#ifdef LODEPNG_COMPILE_ZLIB
+  InflateStream inflate;
+  size_t limit = 0; /*output at which the inflater stops, past max_output_size*/
+  unsigned inflate_error = 0; /*only returned after all chunks were read, like errors of zlib_decompress*/
+#endif /*LODEPNG_COMPILE_ZLIB*/
 
   /*for unknown chunk order*/
-  unsigned unknown = 0;
-#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
   unsigned critical_pos = 1; /*1 = after IHDR, 2 = after PLTE, 3 = after IDAT*/
-#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-
 
   /* safe output values in case error happens */
   *out = 0;
   *w = *h = 0;
+#ifdef LODEPNG_COMPILE_ZLIB
+  InflateStream_init(&inflate);
+#endif /*LODEPNG_COMPILE_ZLIB*/
 
   state->error = lodepng_inspect(w, h, state, in, insize); /*reads header and resets other parameters in state->info_png*/
   if(state->error) return;
@@ -5311,9 +7354,24 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
     CERROR_RETURN(state->error, 92); /*overflow possible due to amount of pixels*/
   }
 
-  /*the input filesize is a safe upper bound for the sum of idat chunks size*/
-  idat = (unsigned char*)lodepng_malloc(insize);
-  if(!idat) CERROR_RETURN(state->error, 83); /*alloc fail*/
+  /*predict output size, to allocate exact size for output buffer to avoid more dynamic allocation.
+  If the decompressed size does not match the prediction, the image must be corrupt.*/
+  expected_size = getExpectedIdatSize(*w, *h, &state->info_png);
+#ifdef LODEPNG_COMPILE_ZLIB
+  inplace = !zlibsettings->custom_zlib && !zlibsettings->custom_inflate;
+  if(inplace) {
+    /*decoded to the end like zlib_decompress, so that corrupt data gives the same error*/
+    limit = (size_t)(-1);
+    if(zlibsettings->max_output_size && zlibsettings->max_output_size < limit) limit = zlibsettings->max_output_size + 1u;
+    /*with the room inflate keeps free at the end, as in zlib_decompress*/
+    if(!ucvector_reserve(&inflate.out, expected_size + INFLATE_FAST_SLACK)) CERROR_RETURN(state->error, 83);
+  }
+#endif /*LODEPNG_COMPILE_ZLIB*/
+  if(!inplace) {
+    /*the input filesize is a safe upper bound for the sum of idat chunks size*/
+    idat = (unsigned char*)lodepng_malloc(insize);
+    if(!idat) CERROR_RETURN(state->error, 83); /*alloc fail*/
+  }
 
   chunk = &in[33]; /*first byte of the first chunk after the header*/
 
@@ -5344,116 +7402,23 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
 
     data = lodepng_chunk_data_const(chunk);
 
-    unknown = 0;
-
     /*IDAT chunk, containing compressed image data*/
     if(lodepng_chunk_type_equals(chunk, "IDAT")) {
       size_t newsize;
       if(lodepng_addofl(idatsize, chunkLength, &newsize)) CERROR_BREAK(state->error, 95);
       if(newsize > insize) CERROR_BREAK(state->error, 95);
+#ifdef LODEPNG_COMPILE_ZLIB
+      if(inplace) {
+        if(!inflate_error) inflate_error = decodeIdat(&inflate, data, chunkLength, zlibsettings, limit);
+      } else
+#endif /*LODEPNG_COMPILE_ZLIB*/
       lodepng_memcpy(idat + idatsize, data, chunkLength);
       idatsize += chunkLength;
-#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
       critical_pos = 3;
-#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-    } else if(lodepng_chunk_type_equals(chunk, "IEND")) {
-      /*IEND chunk*/
-      IEND = 1;
-    } else if(lodepng_chunk_type_equals(chunk, "PLTE")) {
-      /*palette chunk (PLTE)*/
-      state->error = readChunk_PLTE(&state->info_png.color, data, chunkLength);
-      if(state->error) break;
-#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-      critical_pos = 2;
-#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-    } else if(lodepng_chunk_type_equals(chunk, "tRNS")) {
-      /*palette transparency chunk (tRNS). Even though this one is an ancillary chunk , it is still compiled
-      in without 'LODEPNG_COMPILE_ANCILLARY_CHUNKS' because it contains essential color information that
-      affects the alpha channel of pixels. */
-      state->error = readChunk_tRNS(&state->info_png.color, data, chunkLength);
-      if(state->error) break;
-#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-      /*background color chunk (bKGD)*/
-    } else if(lodepng_chunk_type_equals(chunk, "bKGD")) {
-      state->error = readChunk_bKGD(&state->info_png, data, chunkLength);
-      if(state->error) break;
-    } else if(lodepng_chunk_type_equals(chunk, "tEXt")) {
-      /*text chunk (tEXt)*/
-      if(state->decoder.read_text_chunks) {
-        state->error = readChunk_tEXt(&state->info_png, data, chunkLength);
-        if(state->error) break;
-      }
-    } else if(lodepng_chunk_type_equals(chunk, "zTXt")) {
-      /*compressed text chunk (zTXt)*/
-      if(state->decoder.read_text_chunks) {
-        state->error = readChunk_zTXt(&state->info_png, &state->decoder, data, chunkLength);
-        if(state->error) break;
-      }
-    } else if(lodepng_chunk_type_equals(chunk, "iTXt")) {
-      /*international text chunk (iTXt)*/
-      if(state->decoder.read_text_chunks) {
-        state->error = readChunk_iTXt(&state->info_png, &state->decoder, data, chunkLength);
-        if(state->error) break;
-      }
-    } else if(lodepng_chunk_type_equals(chunk, "tIME")) {
-      state->error = readChunk_tIME(&state->info_png, data, chunkLength);
-      if(state->error) break;
-    } else if(lodepng_chunk_type_equals(chunk, "pHYs")) {
-      state->error = readChunk_pHYs(&state->info_png, data, chunkLength);
-      if(state->error) break;
-    } else if(lodepng_chunk_type_equals(chunk, "gAMA")) {
-      state->error = readChunk_gAMA(&state->info_png, data, chunkLength);
-      if(state->error) break;
-    } else if(lodepng_chunk_type_equals(chunk, "cHRM")) {
-      state->error = readChunk_cHRM(&state->info_png, data, chunkLength);
-      if(state->error) break;
-    } else if(lodepng_chunk_type_equals(chunk, "sRGB")) {
-      state->error = readChunk_sRGB(&state->info_png, data, chunkLength);
-      if(state->error) break;
-    } else if(lodepng_chunk_type_equals(chunk, "iCCP")) {
-      state->error = readChunk_iCCP(&state->info_png, &state->decoder, data, chunkLength);
-      if(state->error) break;
-    } else if(lodepng_chunk_type_equals(chunk, "cICP")) {
-      state->error = readChunk_cICP(&state->info_png, data, chunkLength);
-      if(state->error) break;
-    } else if(lodepng_chunk_type_equals(chunk, "mDCv")) {
-      state->error = readChunk_mDCv(&state->info_png, data, chunkLength);
-      if(state->error) break;
-    } else if(lodepng_chunk_type_equals(chunk, "cLLi")) {
-      state->error = readChunk_cLLi(&state->info_png, data, chunkLength);
-      if(state->error) break;
-    } else if(lodepng_chunk_type_equals(chunk, "eXIf")) {
-      state->error = readChunk_eXIf(&state->info_png, data, chunkLength);
-      if(state->error) break;
-    } else if(lodepng_chunk_type_equals(chunk, "sBIT")) {
-      state->error = readChunk_sBIT(&state->info_png, data, chunkLength);
+      if(!state->decoder.ignore_crc && lodepng_chunk_check_crc(chunk)) CERROR_BREAK(state->error, 57); /*invalid CRC*/
+    } else {
+      state->error = decodeChunk(state, chunk, &critical_pos, &IEND);
       if(state->error) break;
-#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-    } else /*it's not an implemented chunk type, so ignore it: skip over the data*/ {
-      if(!lodepng_chunk_type_name_valid(chunk)) {
-        CERROR_BREAK(state->error, 121); /* invalid chunk type name */
-      }
-      if(lodepng_chunk_reserved(chunk)) {
-        CERROR_BREAK(state->error, 122); /* invalid third lowercase character */
-      }
-
-      /*error: unknown critical chunk (5th bit of first byte of chunk type is 0)*/
-      if(!state->decoder.ignore_critical && !lodepng_chunk_ancillary(chunk)) {
-        CERROR_BREAK(state->error, 69);
-      }
-
-      unknown = 1;
-#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-      if(state->decoder.remember_unknown_chunks) {
-        state->error = lodepng_chunk_append(&state->info_png.unknown_chunks_data[critical_pos - 1],
-                                            &state->info_png.unknown_chunks_size[critical_pos - 1], chunk);
-        if(state->error) break;
-      }
-#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-    }
-
-    if(!state->decoder.ignore_crc && !unknown) /*check CRC if wanted, only on known chunk types*/ {
-      if(lodepng_chunk_check_crc(chunk)) CERROR_BREAK(state->error, 57); /*invalid CRC*/
     }
 
     if(!IEND) chunk = lodepng_chunk_next_const(chunk, in + insize);
@@ -5463,29 +7428,25 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
     state->error = 106; /* error: PNG file must have PLTE chunk if color type is palette */
   }
 
-  if(!state->error) {
-    /*predict output size, to allocate exact size for output buffer to avoid more dynamic allocation.
-    If the decompressed size does not match the prediction, the image must be corrupt.*/
-    if(state->info_png.interlace_method == 0) {
-      unsigned bpp = lodepng_get_bpp(&state->info_png.color);
-      expected_size = lodepng_get_raw_size_idat(*w, *h, bpp);
-    } else {
-      unsigned bpp = lodepng_get_bpp(&state->info_png.color);
-      /*Adam-7 interlaced: expected size is the sum of the 7 sub-images sizes*/
-      expected_size = 0;
-      expected_size += lodepng_get_raw_size_idat((*w + 7) >> 3, (*h + 7) >> 3, bpp);
-      if(*w > 4) expected_size += lodepng_get_raw_size_idat((*w + 3) >> 3, (*h + 7) >> 3, bpp);
-      expected_size += lodepng_get_raw_size_idat((*w + 3) >> 2, (*h + 3) >> 3, bpp);
-      if(*w > 2) expected_size += lodepng_get_raw_size_idat((*w + 1) >> 2, (*h + 3) >> 2, bpp);
-      expected_size += lodepng_get_raw_size_idat((*w + 1) >> 1, (*h + 1) >> 2, bpp);
-      if(*w > 1) expected_size += lodepng_get_raw_size_idat((*w + 0) >> 1, (*h + 1) >> 1, bpp);
-      expected_size += lodepng_get_raw_size_idat((*w + 0), (*h + 0) >> 1, bpp);
-    }
-
-    state->error = zlib_decompress(&scanlines, &scanlines_size, expected_size, idat, idatsize, &state->decoder.zlibsettings);
+  if(!state->error && inplace) {
+#ifdef LODEPNG_COMPILE_ZLIB
+    /*the rest of the stream that is in inflate.in*/
+    state->error = inflate_error ? inflate_error : InflateStream_run(&inflate, zlibsettings, 1, limit);
+    if(!state->error && zlibsettings->max_output_size && inflate.out.size > zlibsettings->max_output_size) {
+      state->error = 109; /*error, larger than max size*/
+    }
+    scanlines = inflate.out.data;
+    scanlines_size = inflate.out.size;
+    inflate.out = ucvector_init(NULL, 0);
+#endif /*LODEPNG_COMPILE_ZLIB*/
+  } else if(!state->error) {
+    state->error = zlib_decompress(&scanlines, &scanlines_size, expected_size, idat, idatsize, zlibsettings);
   }
   if(!state->error && scanlines_size != expected_size) state->error = 91; /*decompressed size doesn't match prediction*/
   lodepng_free(idat);
+#ifdef LODEPNG_COMPILE_ZLIB
+  InflateStream_cleanup(&inflate);
+#endif /*LODEPNG_COMPILE_ZLIB*/
 
   if(!state->error) {
     outsize = lodepng_get_raw_size(*w, *h, &state->info_png.color);
@@ -5502,6 +7463,7 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
 unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
                         LodePNGState* state,
                         const unsigned char* in, size_t insize) {
+  TRACE_SCOPE("lodepng_decode");
   *out = 0;
   decodeGeneric(out, w, h, state, in, insize);
   if(state->error) return state->error;
@@ -5561,6 +7523,345 @@ unsigned lodepng_decode24(unsigned char** out, unsigned* w, unsigned* h, const u
   return lodepng_decode_memory(out, w, h, in, insize, LCT_RGB, 8);
 }
 
+#ifdef LODEPNG_COMPILE_ZLIB
+/*stages of the streaming decoder: what the next bytes of the PNG are*/
+#define STREAM_SIGNATURE 0u /*the signature and the IHDR chunk, 33 bytes*/
+#define STREAM_CHUNK_HEADER 1u /*the length and type of a chunk*/
+#define STREAM_CHUNK 2u /*the rest of a chunk other than IDAT*/
+#define STREAM_IDAT 3u /*the data of an IDAT chunk*/
+#define STREAM_IDAT_CRC 4u /*the CRC of an IDAT chunk*/
+#define STREAM_SKIP 5u /*the rest of an ancillary chunk longer than max_chunk_size*/
+#define STREAM_END 6u /*after IEND*/
+
+/*IDAT data goes to the inflater in pieces of at most this size, and is decoded to at most this much output at a time*/
+#define STREAM_PIECE 65536u
+
+struct LodePNGStreamInternal {
+  unsigned stage;
+  ucvector chunk; /*the bytes of the current stage gathered so far*/
+  size_t need; /*how many bytes chunk must have for the current stage*/
+  size_t idat_left; /*bytes of the current IDAT chunk not pushed yet*/
+  size_t skip_left; /*bytes of the skipped chunk not pushed yet, with its CRC*/
+  unsigned crc; /*CRC of the current IDAT chunk so far*/
+  unsigned critical_pos; /*as in decodeGeneric*/
+  unsigned char iend;
+  unsigned started; /*the image data started, the members below are set*/
+  InflateStream inflate;
+  unsigned convert; /*whether rows are converted from info_png to info_raw*/
+  size_t bytewidth, linebytes; /*as in unfilter*/
+  unsigned char* prev; /*the previous and the current scanline, each with the filter byte first*/
+  unsigned char* cur;
+  size_t filled; /*bytes of cur received*/
+  unsigned y;
+  unsigned char* row; /*a row in info_raw's mode when it is not in prev or cur*/
+  ucvector scanlines; /*all of the decompressed data of an interlaced image*/
+  size_t expected, received; /*size of the decompressed data*/
+};
+
+void lodepng_stream_decoder_init(LodePNGStreamDecoder* decoder, LodePNGRowCallback callback, void* context) {
+  lodepng_state_init(&decoder->state);
+  decoder->state.error = 0; /*the error of the decoding so far*/
+  decoder->width = decoder->height = 0;
+  decoder->callback = callback;
+  decoder->context = context;
+  decoder->max_chunk_size = 1048576;
+  decoder->internal = 0;
+}
+
+void lodepng_stream_decoder_cleanup(LodePNGStreamDecoder* decoder) {
+  struct LodePNGStreamInternal* s = decoder->internal;
+  if(s) {
+    lodepng_free(s->chunk.data);
+    InflateStream_cleanup(&s->inflate);
+    lodepng_free(s->prev);
+    lodepng_free(s->cur);
+    lodepng_free(s->row);
+    lodepng_free(s->scanlines.data);
+    lodepng_free(s);
+    decoder->internal = 0;
+  }
+  lodepng_state_cleanup(&decoder->state);
+}
+
+/*appends input to chunk until it has need bytes, and advances the input past what was used*/
+static unsigned streamGather(struct LodePNGStreamInternal* s, const unsigned char** data, size_t* size) {
+  size_t pos = s->chunk.size;
+  size_t n = LODEPNG_MIN(*size, s->need - pos);
+  if(!ucvector_resize(&s->chunk, pos + n)) return 83; /*alloc fail*/
+  lodepng_memcpy(s->chunk.data + pos, *data, n);
+  *data += n;
+  *size -= n;
+  return 0;
+}
+
+/*sets up the rows at the first IDAT chunk, once PLTE and tRNS are known*/
+static unsigned streamBegin(LodePNGStreamDecoder* decoder) {
+  struct LodePNGStreamInternal* s = decoder->internal;
+  LodePNGState* state = &decoder->state;
+  unsigned bpp = lodepng_get_bpp(&state->info_png.color);
+
+  s->started = 1;
+  if(state->info_png.color.colortype == LCT_PALETTE && !state->info_png.color.palette) {
+    return 106; /* error: PNG file must have PLTE chunk if color type is palette */
+  }
+  /*the same choice as in lodepng_decode*/
+  s->convert = state->decoder.color_convert && !lodepng_color_mode_equal(&state->info_raw, &state->info_png.color);
+  if(!state->decoder.color_convert) {
+    unsigned error = lodepng_color_mode_copy(&state->info_raw, &state->info_png.color);
+    if(error) return error;
+  } else if(s->convert && !(state->info_raw.colortype == LCT_RGB || state->info_raw.colortype == LCT_RGBA)
+            && !(state->info_raw.bitdepth == 8)) {
+    return 56; /*unsupported color mode conversion*/
+  }
+
+  s->bytewidth = (bpp + 7u) / 8u;
+  s->linebytes = lodepng_get_raw_size_idat(decoder->width, 1, bpp) - 1u;
+  s->expected = getExpectedIdatSize(decoder->width, decoder->height, &state->info_png);
+  if(state->info_png.interlace_method == 0) {
+    s->prev = (unsigned char*)lodepng_malloc(1 + s->linebytes);
+    s->cur = (unsigned char*)lodepng_malloc(1 + s->linebytes);
+    if(!s->prev || !s->cur) return 83; /*alloc fail*/
+  } else if(!ucvector_reserve(&s->scanlines, s->expected)) {
+    return 83; /*alloc fail*/
+  }
+  if(s->convert || state->info_png.interlace_method != 0) {
+    s->row = (unsigned char*)lodepng_malloc(lodepng_get_raw_size(decoder->width, 1, &state->info_raw));
+    if(!s->row) return 83; /*alloc fail*/
+  }
+  return 0;
+}
+
+/*unfilters the complete scanline in cur and passes it on*/
+static unsigned streamRow(LodePNGStreamDecoder* decoder) {
+  struct LodePNGStreamInternal* s = decoder->internal;
+  unsigned char* row = s->cur + 1;
+  unsigned char* swap;
+  unsigned error = unfilterScanline(row, row, s->y ? s->prev + 1 : 0, s->bytewidth, s->cur[0], s->linebytes);
+  if(error) return error;
+  if(s->convert) {
+    error = lodepng_convert(s->row, row, &decoder->state.info_raw, &decoder->state.info_png.color, decoder->width, 1);
+    if(error) return error;
+    row = s->row;
+  }
+  if(decoder->callback) decoder->callback(decoder->context, row, s->y);
+  swap = s->prev;
+  s->prev = s->cur;
+  s->cur = swap;
+  s->filled = 0;
+  ++s->y;
+  return 0;
+}
+
+/*passes the new output of the inflater on to the rows, or keeps it for an interlaced image*/
+static unsigned streamOutput(LodePNGStreamDecoder* decoder) {
+  struct LodePNGStreamInternal* s = decoder->internal;
+  InflateStream* z = &s->inflate;
+  const unsigned char* data = z->out.data + z->taken;
+  size_t size = z->out.size - z->taken;
+  unsigned error = 0;
+
+  if(size > s->expected - s->received) return 91; /*decompressed size doesn't match prediction*/
+  s->received += size;
+  if(decoder->state.info_png.interlace_method != 0) {
+    size_t pos = s->scanlines.size;
+    if(!ucvector_resize(&s->scanlines, pos + size)) return 83; /*alloc fail*/
+    lodepng_memcpy(s->scanlines.data + pos, data, size);
+  } else {
+    while(!error && size) {
+      size_t n = LODEPNG_MIN(size, 1 + s->linebytes - s->filled);
+      lodepng_memcpy(s->cur + s->filled, data, n);
+      s->filled += n;
+      data += n;
+      size -= n;
+      if(s->filled == 1 + s->linebytes) error = streamRow(decoder);
+    }
+  }
+  InflateStream_take(z);
+  return error;
+}
+
+/*decodes the IDAT data pushed so far, with last all of it to the end of the zlib stream*/
+static unsigned streamInflate(LodePNGStreamDecoder* decoder, unsigned last) {
+  struct LodePNGStreamInternal* s = decoder->internal;
+  unsigned error = 0;
+  unsigned produced;
+  do {
+    error = InflateStream_run(&s->inflate, &decoder->state.decoder.zlibsettings, last, STREAM_PIECE);
+    produced = s->inflate.out.size != s->inflate.taken;
+    if(!error) error = streamOutput(decoder);
+  } while(!error && produced);
+  InflateStream_compact(&s->inflate);
+  return error;
+}
+
+/*the rows of an Adam7 interlaced image are only known once all of it is there, they are passed on at the end*/
+static unsigned streamInterlaced(LodePNGStreamDecoder* decoder) {
+  struct LodePNGStreamInternal* s = decoder->internal;
+  LodePNGState* state = &decoder->state;
+  unsigned w = decoder->width, h = decoder->height, y;
+  size_t rowbits = (size_t)w * lodepng_get_bpp(&state->info_raw);
+  size_t size = lodepng_get_raw_size(w, h, &state->info_png.color);
+  unsigned char* image = (unsigned char*)lodepng_malloc(size);
+  unsigned char* converted = 0;
+  unsigned error = 0;
+
+  if(!image) return 83; /*alloc fail*/
+  lodepng_memset(image, 0, size);
+  error = postProcessScanlines(image, s->scanlines.data, w, h, &state->info_png);
+  if(!error && s->convert) {
+    converted = (unsigned char*)lodepng_malloc(lodepng_get_raw_size(w, h, &state->info_raw));
+    if(!converted) error = 83; /*alloc fail*/
+    else error = lodepng_convert(converted, image, &state->info_raw, &state->info_png.color, w, h);
+  }
+  for(y = 0; !error && y != h && decoder->callback; ++y) {
+    const unsigned char* raw = s->convert ? converted : image;
+    if((rowbits & 7u) == 0) {
+      decoder->callback(decoder->context, raw + (size_t)y * (rowbits >> 3u), y);
+    } else {
+      /*rows of less than 8 bits per pixel do not start at a byte*/
+      size_t ibp = (size_t)y * rowbits, obp = 0, i;
+      for(i = 0; i != rowbits; ++i) setBitOfReversedStream(&obp, s->row, readBitFromReversedStream(&ibp, raw));
+      decoder->callback(decoder->context, s->row, y);
+    }
+  }
+  lodepng_free(image);
+  lodepng_free(converted);
+  return error;
+}
+
+/*finishes the image data, at IEND or at the end of the input with ignore_end*/
+static unsigned streamEnd(LodePNGStreamDecoder* decoder) {
+  struct LodePNGStreamInternal* s = decoder->internal;
+  unsigned error = 0;
+  s->stage = STREAM_END;
+  if(!s->started) error = streamBegin(decoder);
+  if(!error) error = streamInflate(decoder, 1);
+  if(!error && s->received != s->expected) error = 91; /*decompressed size doesn't match prediction*/
+  if(!error && decoder->state.info_png.interlace_method != 0) error = streamInterlaced(decoder);
+  return error;
+}
+
+/*handles the gathered bytes of the current stage, other than IDAT data*/
+static unsigned streamStage(LodePNGStreamDecoder* decoder) {
+  struct LodePNGStreamInternal* s = decoder->internal;
+  LodePNGState* state = &decoder->state;
+  unsigned error = 0;
+
+  if(s->stage == STREAM_SIGNATURE) {
+    error = lodepng_inspect(&decoder->width, &decoder->height, state, s->chunk.data, s->chunk.size);
+    if(!error && lodepng_pixel_overflow(decoder->width, decoder->height, &state->info_png.color, &state->info_raw)) {
+      error = 92; /*overflow possible due to amount of pixels*/
+    }
+  } else if(s->stage == STREAM_CHUNK_HEADER) {
+    unsigned chunkLength = lodepng_chunk_length(s->chunk.data);
+    /*error: chunk length larger than the max PNG chunk size*/
+    if(chunkLength > 2147483647) return state->decoder.ignore_end ? streamEnd(decoder) : 63;
+    if(lodepng_chunk_type_equals(s->chunk.data, "IDAT")) {
+      if(!s->started) error = streamBegin(decoder);
+      s->critical_pos = 3;
+#ifdef LODEPNG_COMPILE_CRC
+      s->crc = crc32Update(0, s->chunk.data + 4, 4);
+#endif /*LODEPNG_COMPILE_CRC*/
+      s->idat_left = chunkLength;
+      s->stage = chunkLength ? STREAM_IDAT : STREAM_IDAT_CRC;
+      s->need = 4;
+      s->chunk.size = 0;
+    } else if(chunkLength > decoder->max_chunk_size && lodepng_chunk_ancillary(s->chunk.data)
+              && !(lodepng_chunk_type_equals(s->chunk.data, "tRNS") && chunkLength <= 256)) {
+      if(!lodepng_chunk_type_name_valid(s->chunk.data)) return 121; /*invalid chunk type name*/
+      if(lodepng_chunk_reserved(s->chunk.data)) return 122; /*invalid third lowercase character*/
+      /*tRNS has at most 256 values, readChunk_tRNS gives the error from the length alone*/
+      if(lodepng_chunk_type_equals(s->chunk.data, "tRNS")) {
+        return readChunk_tRNS(&state->info_png.color, 0, chunkLength);
+      }
+      s->skip_left = (size_t)chunkLength + 4;
+      s->stage = STREAM_SKIP;
+      s->chunk.size = 0;
+    } else {
+      /*the whole chunk is gathered, starting with the header already there*/
+      s->stage = STREAM_CHUNK;
+      s->need = (size_t)chunkLength + 12;
+    }
+    return error;
+  } else if(s->stage == STREAM_CHUNK) {
+    error = decodeChunk(state, s->chunk.data, &s->critical_pos, &s->iend);
+    if(!error && s->iend) return streamEnd(decoder);
+  } else /*if(s->stage == STREAM_IDAT_CRC)*/ {
+#ifdef LODEPNG_COMPILE_CRC
+    if(!state->decoder.ignore_crc && lodepng_read32bitInt(s->chunk.data) != s->crc) return 57; /*invalid CRC*/
+#endif /*LODEPNG_COMPILE_CRC*/
+  }
+  s->stage = STREAM_CHUNK_HEADER;
+  s->need = 8;
+  s->chunk.size = 0;
+  return error;
+}
+
+unsigned lodepng_stream_decoder_push(LodePNGStreamDecoder* decoder, const unsigned char* data, size_t size) {
+  struct LodePNGStreamInternal* s = decoder->internal;
+  LodePNGState* state = &decoder->state;
+  if(state->error) return state->error;
+
+  if(!s) {
+    s = (struct LodePNGStreamInternal*)lodepng_malloc(sizeof(struct LodePNGStreamInternal));
+    if(!s) CERROR_RETURN_ERROR(state->error, 83); /*alloc fail*/
+    lodepng_memset(s, 0, sizeof(struct LodePNGStreamInternal));
+    s->chunk = ucvector_init(NULL, 0);
+    s->scanlines = ucvector_init(NULL, 0);
+    InflateStream_init(&s->inflate);
+    s->stage = STREAM_SIGNATURE;
+    s->need = 33;
+    s->critical_pos = 1;
+    decoder->internal = s;
+  }
+
+  while(size && !state->error && s->stage != STREAM_END) /*anything after IEND is ignored*/ {
+    if(s->stage == STREAM_IDAT) {
+      size_t n = LODEPNG_MIN(LODEPNG_MIN(size, s->idat_left), STREAM_PIECE);
+#ifdef LODEPNG_COMPILE_CRC
+      s->crc = crc32Update(s->crc, data, n);
+#endif /*LODEPNG_COMPILE_CRC*/
+      state->error = InflateStream_push(&s->inflate, data, n);
+      if(!state->error) state->error = streamInflate(decoder, 0);
+      data += n;
+      size -= n;
+      s->idat_left -= n;
+      if(!s->idat_left) s->stage = STREAM_IDAT_CRC;
+    } else if(s->stage == STREAM_SKIP) {
+      size_t n = LODEPNG_MIN(size, s->skip_left);
+      data += n;
+      size -= n;
+      s->skip_left -= n;
+      if(!s->skip_left) {
+        s->stage = STREAM_CHUNK_HEADER;
+        s->need = 8;
+      }
+    } else {
+      state->error = streamGather(s, &data, &size);
+      if(!state->error && s->chunk.size == s->need) state->error = streamStage(decoder);
+    }
+  }
+  return state->error;
+}
+
+unsigned lodepng_stream_decoder_finish(LodePNGStreamDecoder* decoder) {
+  struct LodePNGStreamInternal* s = decoder->internal;
+  LodePNGState* state = &decoder->state;
+  if(state->error) return state->error;
+
+  if(!s || s->stage == STREAM_SIGNATURE) {
+    /*error: the given data is empty, or smaller than the length of a PNG header*/
+    state->error = (!s || !s->chunk.size) ? 48 : 27;
+  } else if(s->stage != STREAM_END) {
+    /*error: the input ends in the middle of a chunk, or without IEND*/
+    if(s->stage != STREAM_CHUNK_HEADER) state->error = 64;
+    else if(!state->decoder.ignore_end) state->error = 30;
+    else state->error = streamEnd(decoder);
+  }
+  return state->error;
+}
+#endif /*LODEPNG_COMPILE_ZLIB*/
+
 #ifdef LODEPNG_COMPILE_DISK
 unsigned lodepng_decode_file(unsigned char** out, unsigned* w, unsigned* h, const char* filename,
                              LodePNGColorType colortype, unsigned bitdepth) {
@@ -5576,6 +7877,25 @@ unsigned lodepng_decode_file(unsigned char** out, unsigned* w, unsigned* h, cons
   return error;
 }
 
+unsigned lodepng_decode_file_mapped(unsigned char** out, unsigned* w, unsigned* h, const char* filename,
+                                    LodePNGColorType colortype, unsigned bitdepth) {
+#ifdef LODEPNG_MMAP
+  const unsigned char* buffer = 0;
+  size_t buffersize;
+  unsigned error;
+  /* safe output values in case error happens */
+  *out = 0;
+  *w = *h = 0;
+  /*the PNG is decoded from the page cache, the IDAT data where it is in the file*/
+  error = lodepng_map_file(&buffer, &buffersize, filename);
+  if(!error) error = lodepng_decode_memory(out, w, h, buffer, buffersize, colortype, bitdepth);
+  lodepng_unmap_file(buffer, buffersize);
+  return error;
+#else /*LODEPNG_MMAP*/
+  return lodepng_decode_file(out, w, h, filename, colortype, bitdepth);
+#endif /*LODEPNG_MMAP*/
+}
+
 unsigned lodepng_decode32_file(unsigned char** out, unsigned* w, unsigned* h, const char* filename) {
   return lodepng_decode_file(out, w, h, filename, LCT_RGBA, 8);
 }
@@ -6085,6 +8405,195 @@ static void filterScanline(unsigned char* out, const unsigned char* scanline, co
   }
 }
 
+#ifdef LODEPNG_SIMD_X86
+/*
+All five filter candidates of a scanline in one pass, optionally with the LFS_MINSUM scores: the sum of the
+bytes for None, and the sum of min(s, 255 - s) (the magnitude as signed char) for the differences. Unlike
+unfiltering, filtering only reads raw input, so every byte is independent and 16 or 32 run per step.
+Requires prevline (the first scanline uses the portable code). The results are identical to filterScanline.
+*/
+
+/*the sum of the two 64-bit lanes of a _mm_sad_epu8 accumulator. _mm_cvtsi128_si64 only exists on x86-64, and
+on 32-bit x86 size_t is 32 bits anyway, so there the low 32 bits are the same result*/
+static size_t sadLaneSum(__m128i v) {
+  v = _mm_add_epi64(v, _mm_unpackhi_epi64(v, v));
+#ifdef __x86_64__
+  return (size_t)_mm_cvtsi128_si64(v);
+#else
+  return (size_t)(unsigned)_mm_cvtsi128_si32(v);
+#endif
+}
+
+static void filterScanlineTail(unsigned char* attempt[5], const unsigned char* scanline, const unsigned char* prevline,
+                               size_t begin, size_t length, size_t bytewidth, size_t sums[5]) {
+  size_t i, type;
+  for(i = begin; i < length; ++i) {
+    unsigned char x = scanline[i], b = prevline[i];
+    unsigned char a = i >= bytewidth ? scanline[i - bytewidth] : 0, c = i >= bytewidth ? prevline[i - bytewidth] : 0;
+    attempt[0][i] = x;
+    attempt[1][i] = x - a;
+    attempt[2][i] = x - b;
+    attempt[3][i] = x - ((a + b) >> 1);
+    attempt[4][i] = x - paethPredictor(a, b, c);
+    if(sums) {
+      sums[0] += x;
+      for(type = 1; type != 5; ++type) {
+        unsigned char s = attempt[type][i];
+        sums[type] += s < 128 ? s : (255U - s);
+      }
+    }
+  }
+}
+
+static LODEPNG_INLINE __m128i paethPredict16(__m128i a8, __m128i b8, __m128i c8) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i result[2];
+  int half;
+  for(half = 0; half != 2; ++half) {
+    __m128i a = half ? _mm_unpackhi_epi8(a8, zero) : _mm_unpacklo_epi8(a8, zero);
+    __m128i b = half ? _mm_unpackhi_epi8(b8, zero) : _mm_unpacklo_epi8(b8, zero);
+    __m128i c = half ? _mm_unpackhi_epi8(c8, zero) : _mm_unpacklo_epi8(c8, zero);
+    __m128i pa = _mm_sub_epi16(b, c), pb = _mm_sub_epi16(a, c);
+    __m128i pc = _mm_add_epi16(pa, pb);
+    pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+    pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+    pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+    result[half] = paethSelect(a, b, c, pa, pb, pc);
+  }
+  return _mm_packus_epi16(result[0], result[1]);
+}
+
+static void filterScanlineAllSSE2(unsigned char* attempt[5], const unsigned char* scanline, const unsigned char* prevline,
+                                  size_t length, size_t bytewidth, size_t sums[5]) {
+  const __m128i zero = _mm_setzero_si128(), one = _mm_set1_epi8(1), ones = _mm_set1_epi8(-1);
+  __m128i acc[5];
+  size_t i, type;
+  size_t begin = LODEPNG_MIN(bytewidth, length);
+  for(type = 0; type != 5; ++type) acc[type] = zero;
+  if(sums) for(type = 0; type != 5; ++type) sums[type] = 0;
+  filterScanlineTail(attempt, scanline, prevline, 0, begin, bytewidth, sums); /*no left neighbour yet*/
+  for(i = begin; i + 16 <= length; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(scanline + i));
+    __m128i a = _mm_loadu_si128((const __m128i*)(scanline + i - bytewidth));
+    __m128i b = _mm_loadu_si128((const __m128i*)(prevline + i));
+    __m128i c = _mm_loadu_si128((const __m128i*)(prevline + i - bytewidth));
+    __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+    __m128i f[5];
+    f[0] = x;
+    f[1] = _mm_sub_epi8(x, a);
+    f[2] = _mm_sub_epi8(x, b);
+    f[3] = _mm_sub_epi8(x, avg);
+    f[4] = _mm_sub_epi8(x, paethPredict16(a, b, c));
+    for(type = 0; type != 5; ++type) _mm_storeu_si128((__m128i*)(attempt[type] + i), f[type]);
+    if(sums) {
+      acc[0] = _mm_add_epi64(acc[0], _mm_sad_epu8(f[0], zero));
+      for(type = 1; type != 5; ++type) {
+        acc[type] = _mm_add_epi64(acc[type], _mm_sad_epu8(_mm_min_epu8(f[type], _mm_xor_si128(f[type], ones)), zero));
+      }
+    }
+  }
+  if(sums) {
+    for(type = 0; type != 5; ++type) {
+      sums[type] += sadLaneSum(acc[type]);
+    }
+  }
+  filterScanlineTail(attempt, scanline, prevline, i, length, bytewidth, sums);
+}
+
+LODEPNG_TARGET("avx2")
+static void filterScanlineAllAVX2(unsigned char* attempt[5], const unsigned char* scanline, const unsigned char* prevline,
+                                  size_t length, size_t bytewidth, size_t sums[5]) {
+  const __m256i zero = _mm256_setzero_si256(), one = _mm256_set1_epi8(1), ones = _mm256_set1_epi8(-1);
+  __m256i acc[5];
+  size_t i, type;
+  size_t begin = LODEPNG_MIN(bytewidth, length);
+  for(type = 0; type != 5; ++type) acc[type] = zero;
+  if(sums) for(type = 0; type != 5; ++type) sums[type] = 0;
+  filterScanlineTail(attempt, scanline, prevline, 0, begin, bytewidth, sums);
+  for(i = begin; i + 32 <= length; i += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(scanline + i));
+    __m256i a = _mm256_loadu_si256((const __m256i*)(scanline + i - bytewidth));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(prevline + i));
+    __m256i c = _mm256_loadu_si256((const __m256i*)(prevline + i - bytewidth));
+    __m256i avg = _mm256_sub_epi8(_mm256_avg_epu8(a, b), _mm256_and_si256(_mm256_xor_si256(a, b), one));
+    __m256i predicted[2], f[5];
+    int half;
+    /*unpack and pack both work within 128-bit lanes, so the byte order is preserved*/
+    for(half = 0; half != 2; ++half) {
+      __m256i a16 = half ? _mm256_unpackhi_epi8(a, zero) : _mm256_unpacklo_epi8(a, zero);
+      __m256i b16 = half ? _mm256_unpackhi_epi8(b, zero) : _mm256_unpacklo_epi8(b, zero);
+      __m256i c16 = half ? _mm256_unpackhi_epi8(c, zero) : _mm256_unpacklo_epi8(c, zero);
+      __m256i pa = _mm256_sub_epi16(b16, c16), pb = _mm256_sub_epi16(a16, c16);
+      __m256i pc = _mm256_abs_epi16(_mm256_add_epi16(pa, pb));
+      __m256i smallest, useA, useB;
+      pa = _mm256_abs_epi16(pa);
+      pb = _mm256_abs_epi16(pb);
+      smallest = _mm256_min_epi16(pc, _mm256_min_epi16(pa, pb));
+      useA = _mm256_cmpeq_epi16(pa, smallest);
+      useB = _mm256_cmpeq_epi16(pb, smallest);
+      predicted[half] = _mm256_blendv_epi8(_mm256_blendv_epi8(c16, b16, useB), a16, useA);
+    }
+    f[0] = x;
+    f[1] = _mm256_sub_epi8(x, a);
+    f[2] = _mm256_sub_epi8(x, b);
+    f[3] = _mm256_sub_epi8(x, avg);
+    f[4] = _mm256_sub_epi8(x, _mm256_packus_epi16(predicted[0], predicted[1]));
+    for(type = 0; type != 5; ++type) _mm256_storeu_si256((__m256i*)(attempt[type] + i), f[type]);
+    if(sums) {
+      acc[0] = _mm256_add_epi64(acc[0], _mm256_sad_epu8(f[0], zero));
+      for(type = 1; type != 5; ++type) {
+        acc[type] = _mm256_add_epi64(acc[type], _mm256_sad_epu8(_mm256_min_epu8(f[type], _mm256_xor_si256(f[type], ones)), zero));
+      }
+    }
+  }
+  if(sums) {
+    for(type = 0; type != 5; ++type) {
+      sums[type] += sadLaneSum(_mm_add_epi64(_mm256_castsi256_si128(acc[type]), _mm256_extracti128_si256(acc[type], 1)));
+    }
+  }
+  filterScanlineTail(attempt, scanline, prevline, i, length, bytewidth, sums);
+}
+#endif /*LODEPNG_SIMD_X86*/
+
+/*
+Computes all five filter types of the scanline into attempt, and if sums is not NULL, the LFS_MINSUM
+score of each. Uses SIMD when available, otherwise one filterScanline call per type.
+*/
+static void filterScanlineAll(unsigned char* attempt[5], const unsigned char* scanline, const unsigned char* prevline,
+                              size_t length, size_t bytewidth, size_t sums[5]) {
+  unsigned char type;
+  size_t x;
+#ifdef LODEPNG_SIMD_X86
+  if(prevline) {
+    unsigned features = lodepng_cpu_features();
+    if(features & LCPU_AVX2) {
+      filterScanlineAllAVX2(attempt, scanline, prevline, length, bytewidth, sums);
+      return;
+    }
+    if(features & LCPU_SSE2) {
+      filterScanlineAllSSE2(attempt, scanline, prevline, length, bytewidth, sums);
+      return;
+    }
+  }
+#endif /*LODEPNG_SIMD_X86*/
+  for(type = 0; type != 5; ++type) {
+    filterScanline(attempt[type], scanline, prevline, length, bytewidth, type);
+    if(!sums) continue;
+    sums[type] = 0;
+    if(type == 0) {
+      for(x = 0; x != length; ++x) sums[type] += (unsigned char)(attempt[type][x]);
+    } else {
+      for(x = 0; x != length; ++x) {
+        /*For differences, each byte should be treated as signed, values above 127 are negative
+        (converted to signed char). Filtertype 0 isn't a difference though, so use unsigned there.
+        This means filtertype 0 is almost never chosen, but that is justified.*/
+        unsigned char s = attempt[type][x];
+        sums[type] += s < 128 ? s : (255U - s);
+      }
+    }
+  }
+}
+
 /* integer binary logarithm, max return value is 31 */
 static size_t ilog2(size_t i) {
   size_t result = 0;
@@ -6106,47 +8615,24 @@ static size_t ilog2i(size_t i) {
   return i * l + ((i - (((size_t)1) << l)) << 1u);
 }
 
-static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h,
-                       const LodePNGColorMode* color, const LodePNGEncoderSettings* settings) {
-  /*
-  For PNG filter method 0
-  out must be a buffer with as size: h + (w * h * bpp + 7u) / 8u, because there are
-  the scanlines with 1 extra byte per scanline
-  */
-
-  unsigned bpp = lodepng_get_bpp(color);
-  /*the width of a scanline in bytes, not including the filter type*/
-  size_t linebytes = lodepng_get_raw_size_idat(w, 1, bpp) - 1u;
-
-  /*bytewidth is used for filtering, is 1 when bpp < 8, number of bytes per pixel otherwise*/
-  size_t bytewidth = (bpp + 7u) / 8u;
-  const unsigned char* prevline = 0;
+/*
+Adaptive filter selection (LFS_MINSUM, LFS_ENTROPY, LFS_BRUTE_FORCE) for the scanlines ybegin until yend.
+The choice for a row only depends on the raw input of the row and the row above it, never on the filtered
+output, so disjoint ranges can be processed independently and give the same result as the whole image.
+*/
+static unsigned filterAdaptive(unsigned char* out, const unsigned char* in, size_t linebytes, size_t bytewidth,
+                               unsigned ybegin, unsigned yend, LodePNGFilterStrategy strategy,
+                               const LodePNGCompressSettings* settings) {
+  const unsigned char* prevline = ybegin ? &in[(size_t)(ybegin - 1u) * linebytes] : 0;
   unsigned x, y;
   unsigned error = 0;
-  LodePNGFilterStrategy strategy = settings->filter_strategy;
-
-  if(settings->filter_palette_zero && (color->colortype == LCT_PALETTE || color->bitdepth < 8)) {
-    /*if the filter_palette_zero setting is enabled, override the filter strategy with
-    zero for all scanlines for palette and less-than-8-bitdepth images*/
-    strategy = LFS_ZERO;
-  }
-
-  if(bpp == 0) return 31; /*error: invalid color type*/
 
-  if(strategy >= LFS_ZERO && strategy <= LFS_FOUR) {
-    unsigned char type = (unsigned char)strategy;
-    for(y = 0; y != h; ++y) {
-      size_t outindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
-      size_t inindex = linebytes * y;
-      out[outindex] = type; /*filter type byte*/
-      filterScanline(&out[outindex + 1], &in[inindex], prevline, linebytes, bytewidth, type);
-      prevline = &in[inindex];
-    }
-  } else if(strategy == LFS_MINSUM) {
+  if(strategy == LFS_MINSUM) {
     /*adaptive filtering: independently for each row, try all five filter types and select the one that produces the
     smallest sum of absolute values per row.*/
     unsigned char* attempt[5]; /*five filtering attempts, one for each filter type*/
     size_t smallest = 0;
+    size_t sums[5];
     unsigned char type, bestType = 0;
 
     for(type = 0; type != 5; ++type) {
@@ -6155,29 +8641,14 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
     }
 
     if(!error) {
-      for(y = 0; y != h; ++y) {
-        /*try the 5 filter types*/
+      for(y = ybegin; y != yend; ++y) {
+        /*try the 5 filter types, and calculate the sum of each result*/
+        filterScanlineAll(attempt, &in[y * linebytes], prevline, linebytes, bytewidth, sums);
         for(type = 0; type != 5; ++type) {
-          size_t sum = 0;
-          filterScanline(attempt[type], &in[y * linebytes], prevline, linebytes, bytewidth, type);
-
-          /*calculate the sum of the result*/
-          if(type == 0) {
-            for(x = 0; x != linebytes; ++x) sum += (unsigned char)(attempt[type][x]);
-          } else {
-            for(x = 0; x != linebytes; ++x) {
-              /*For differences, each byte should be treated as signed, values above 127 are negative
-              (converted to signed char). Filtertype 0 isn't a difference though, so use unsigned there.
-              This means filtertype 0 is almost never chosen, but that is justified.*/
-              unsigned char s = attempt[type][x];
-              sum += s < 128 ? s : (255U - s);
-            }
-          }
-
           /*check if this is smallest sum (or if type == 0 it's the first case so always store the values)*/
-          if(type == 0 || sum < smallest) {
+          if(type == 0 || sums[type] < smallest) {
             bestType = type;
-            smallest = sum;
+            smallest = sums[type];
           }
         }
 
@@ -6194,7 +8665,7 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
     unsigned char* attempt[5]; /*five filtering attempts, one for each filter type*/
     size_t bestSum = 0;
     unsigned type, bestType = 0;
-    unsigned count[256];
+    unsigned count[4][256]; /*four interleaved histograms, runs of equal bytes don't serialize on one counter*/
 
     for(type = 0; type != 5; ++type) {
       attempt[type] = (unsigned char*)lodepng_malloc(linebytes);
@@ -6202,16 +8673,23 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
     }
 
     if(!error) {
-      for(y = 0; y != h; ++y) {
+      for(y = ybegin; y != yend; ++y) {
         /*try the 5 filter types*/
+        filterScanlineAll(attempt, &in[y * linebytes], prevline, linebytes, bytewidth, 0);
         for(type = 0; type != 5; ++type) {
           size_t sum = 0;
-          filterScanline(attempt[type], &in[y * linebytes], prevline, linebytes, bytewidth, type);
-          lodepng_memset(count, 0, 256 * sizeof(*count));
-          for(x = 0; x != linebytes; ++x) ++count[attempt[type][x]];
-          ++count[type]; /*the filter type itself is part of the scanline*/
+          const unsigned char* line = attempt[type];
+          lodepng_memset(count, 0, sizeof(count));
+          for(x = 0; x + 4 <= linebytes; x += 4) {
+            ++count[0][line[x + 0]];
+            ++count[1][line[x + 1]];
+            ++count[2][line[x + 2]];
+            ++count[3][line[x + 3]];
+          }
+          for(; x != linebytes; ++x) ++count[0][line[x]];
+          ++count[0][type]; /*the filter type itself is part of the scanline*/
           for(x = 0; x != 256; ++x) {
-            sum += ilog2i(count[x]);
+            sum += ilog2i(count[0][x] + count[1][x] + count[2][x] + count[3][x]);
           }
           /*check if this is smallest sum (or if type == 0 it's the first case so always store the values)*/
           if(type == 0 || sum > bestSum) {
@@ -6229,15 +8707,6 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
     }
 
     for(type = 0; type != 5; ++type) lodepng_free(attempt[type]);
-  } else if(strategy == LFS_PREDEFINED) {
-    for(y = 0; y != h; ++y) {
-      size_t outindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
-      size_t inindex = linebytes * y;
-      unsigned char type = settings->predefined_filters[y];
-      out[outindex] = type; /*filter type byte*/
-      filterScanline(&out[outindex + 1], &in[inindex], prevline, linebytes, bytewidth, type);
-      prevline = &in[inindex];
-    }
   } else if(strategy == LFS_BRUTE_FORCE) {
     /*brute force filter chooser.
     deflate the scanline after every filter attempt to see which one deflates best.
@@ -6248,7 +8717,7 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
     unsigned type = 0, bestType = 0;
     unsigned char* dummy;
     LodePNGCompressSettings zlibsettings;
-    lodepng_memcpy(&zlibsettings, &settings->zlibsettings, sizeof(LodePNGCompressSettings));
+    lodepng_memcpy(&zlibsettings, settings, sizeof(LodePNGCompressSettings));
     /*use fixed tree on the attempts so that the tree is not adapted to the filtertype on purpose,
     to simulate the true case where the tree is the same for the whole image. Sometimes it gives
     better result with dynamic tree anyway. Using the fixed tree sometimes gives worse, but in rare
@@ -6258,37 +8727,135 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
     images only, so disable it*/
     zlibsettings.custom_zlib = 0;
     zlibsettings.custom_deflate = 0;
+    zlibsettings.num_threads = 1; /*the rows are already spread over the threads*/
     for(type = 0; type != 5; ++type) {
       attempt[type] = (unsigned char*)lodepng_malloc(linebytes);
       if(!attempt[type]) error = 83; /*alloc fail*/
     }
     if(!error) {
-      for(y = 0; y != h; ++y) /*try the 5 filter types*/ {
+      for(y = ybegin; y != yend; ++y) /*try the 5 filter types*/ {
+        filterScanlineAll(attempt, &in[y * linebytes], prevline, linebytes, bytewidth, 0);
         for(type = 0; type != 5; ++type) {
           unsigned testsize = (unsigned)linebytes;
           /*if(testsize > 8) testsize /= 8;*/ /*it already works good enough by testing a part of the row*/
 
-          filterScanline(attempt[type], &in[y * linebytes], prevline, linebytes, bytewidth, type);
-          size[type] = 0;
-          dummy = 0;
-          zlib_compress(&dummy, &size[type], attempt[type], testsize, &zlibsettings);
-          lodepng_free(dummy);
-          /*check if this is smallest size (or if type == 0 it's the first case so always store the values)*/
-          if(type == 0 || size[type] < smallest) {
-            bestType = type;
-            smallest = size[type];
-          }
-        }
-        prevline = &in[y * linebytes];
-        out[y * (linebytes + 1)] = bestType; /*the first byte of a scanline will be the filter type*/
-        for(x = 0; x != linebytes; ++x) out[y * (linebytes + 1) + 1 + x] = attempt[bestType][x];
-      }
+          size[type] = 0;
+          dummy = 0;
+          zlib_compress(&dummy, &size[type], attempt[type], testsize, &zlibsettings);
+          lodepng_free(dummy);
+          /*check if this is smallest size (or if type == 0 it's the first case so always store the values)*/
+          if(type == 0 || size[type] < smallest) {
+            bestType = type;
+            smallest = size[type];
+          }
+        }
+        prevline = &in[y * linebytes];
+        out[y * (linebytes + 1)] = bestType; /*the first byte of a scanline will be the filter type*/
+        for(x = 0; x != linebytes; ++x) out[y * (linebytes + 1) + 1 + x] = attempt[bestType][x];
+      }
+    }
+    for(type = 0; type != 5; ++type) lodepng_free(attempt[type]);
+  }
+
+  return error;
+}
+
+#ifdef LODEPNG_COMPILE_THREADS
+/*
+Runs filterAdaptive on row bands in parallel. Every band writes only its own rows of out, so the result is
+identical to the serial one. If a thread cannot be started, its band is processed on the calling thread instead.
+*/
+static unsigned filterAdaptiveParallel(unsigned char* out, const unsigned char* in, unsigned h, size_t linebytes,
+                                       size_t bytewidth, LodePNGFilterStrategy strategy,
+                                       const LodePNGCompressSettings* settings, unsigned numthreads) {
+  /*bands shorter than this are not worth a thread, except for brute force where every row is expensive*/
+  size_t minrows = strategy == LFS_BRUTE_FORCE ? 1u : LODEPNG_MAX((size_t)1u, ((size_t)1u << 18) / (linebytes + 1u));
+  unsigned bands = (unsigned)LODEPNG_MIN((size_t)numthreads, (h + minrows - 1u) / minrows);
+  std::vector<std::thread> threads;
+  std::vector<unsigned> errors;
+  unsigned i, error = 0;
+  if(bands <= 1) return filterAdaptive(out, in, linebytes, bytewidth, 0, h, strategy, settings);
+
+#ifdef LODEPNG_COMPILE_SIMD
+  (void)lodepng_cpu_features(); /*detect once, before the threads read it*/
+#endif /*LODEPNG_COMPILE_SIMD*/
+  errors.resize(bands, 0);
+  threads.reserve(bands - 1u);
+  for(i = 1; i != bands; ++i) {
+    unsigned ybegin = (unsigned)((unsigned long long)h * i / bands);
+    unsigned yend = (unsigned)((unsigned long long)h * (i + 1u) / bands);
+    unsigned* bandError = &errors[i];
+    try {
+      threads.emplace_back([=]() {
+        *bandError = filterAdaptive(out, in, linebytes, bytewidth, ybegin, yend, strategy, settings);
+      });
+    } catch(...) {
+      *bandError = filterAdaptive(out, in, linebytes, bytewidth, ybegin, yend, strategy, settings);
+    }
+  }
+  errors[0] = filterAdaptive(out, in, linebytes, bytewidth, 0, h / bands, strategy, settings);
+  for(i = 0; i != threads.size(); ++i) threads[i].join();
+  for(i = 0; i != bands && !error; ++i) error = errors[i];
+  return error;
+}
+#endif /*LODEPNG_COMPILE_THREADS*/
+
+static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h,
+                       const LodePNGColorMode* color, const LodePNGEncoderSettings* settings) {
+  /*
+  For PNG filter method 0
+  out must be a buffer with as size: h + (w * h * bpp + 7u) / 8u, because there are
+  the scanlines with 1 extra byte per scanline
+  */
+
+  unsigned bpp = lodepng_get_bpp(color);
+  /*the width of a scanline in bytes, not including the filter type*/
+  size_t linebytes = lodepng_get_raw_size_idat(w, 1, bpp) - 1u;
+
+  /*bytewidth is used for filtering, is 1 when bpp < 8, number of bytes per pixel otherwise*/
+  size_t bytewidth = (bpp + 7u) / 8u;
+  const unsigned char* prevline = 0;
+  unsigned y;
+  LodePNGFilterStrategy strategy = settings->filter_strategy;
+
+  if(settings->filter_palette_zero && (color->colortype == LCT_PALETTE || color->bitdepth < 8)) {
+    /*if the filter_palette_zero setting is enabled, override the filter strategy with
+    zero for all scanlines for palette and less-than-8-bitdepth images*/
+    strategy = LFS_ZERO;
+  }
+
+  if(bpp == 0) return 31; /*error: invalid color type*/
+
+  if(strategy >= LFS_ZERO && strategy <= LFS_FOUR) {
+    unsigned char type = (unsigned char)strategy;
+    for(y = 0; y != h; ++y) {
+      size_t outindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
+      size_t inindex = linebytes * y;
+      out[outindex] = type; /*filter type byte*/
+      filterScanline(&out[outindex + 1], &in[inindex], prevline, linebytes, bytewidth, type);
+      prevline = &in[inindex];
     }
-    for(type = 0; type != 5; ++type) lodepng_free(attempt[type]);
+  } else if(strategy == LFS_PREDEFINED) {
+    for(y = 0; y != h; ++y) {
+      size_t outindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
+      size_t inindex = linebytes * y;
+      unsigned char type = settings->predefined_filters[y];
+      out[outindex] = type; /*filter type byte*/
+      filterScanline(&out[outindex + 1], &in[inindex], prevline, linebytes, bytewidth, type);
+      prevline = &in[inindex];
+    }
+  } else if(strategy == LFS_MINSUM || strategy == LFS_ENTROPY || strategy == LFS_BRUTE_FORCE) {
+#ifdef LODEPNG_COMPILE_THREADS
+    unsigned numthreads = lodepng_num_threads(settings->num_threads);
+    if(numthreads > 1) {
+      return filterAdaptiveParallel(out, in, h, linebytes, bytewidth, strategy, &settings->zlibsettings, numthreads);
+    }
+#endif /*LODEPNG_COMPILE_THREADS*/
+    return filterAdaptive(out, in, linebytes, bytewidth, 0, h, strategy, &settings->zlibsettings);
   }
   else return 88; /* unknown filter strategy */
 
-  return error;
+  return 0;
 }
 
 static void addPaddingBits(unsigned char* out, const unsigned char* in,
@@ -6467,6 +9034,178 @@ static unsigned isRGBICCProfile(const unsigned char* profile, unsigned size) {
 }
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
+/*checks the settings and color modes given to the encoder*/
+static unsigned checkEncoderState(const LodePNGState* state) {
+  const LodePNGInfo* info_png = &state->info_png;
+  if((info_png->color.colortype == LCT_PALETTE || state->encoder.force_palette)
+      && (info_png->color.palettesize == 0 || info_png->color.palettesize > 256)) {
+    /*this error is returned even if auto_convert is enabled and thus encoder could
+    generate the palette by itself: while allowing this could be possible in theory,
+    it may complicate the code or edge cases, and always requiring to give a palette
+    when setting this color type is a simpler contract*/
+    return 68; /*invalid palette size, it is only allowed to be 1-256*/
+  }
+  if(state->encoder.zlibsettings.btype > 2) return 61; /*error: invalid btype*/
+  if(info_png->interlace_method > 1) return 71; /*error: invalid interlace mode*/
+  /*error: invalid color type given*/
+  CERROR_TRY_RETURN(checkColorValidity(info_png->color.colortype, info_png->color.bitdepth));
+  return checkColorValidity(state->info_raw.colortype, state->info_raw.bitdepth);
+}
+
+#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
+/*checks that the ICC profile, if any, fits the color type of the PNG in info*/
+static unsigned checkICCProfile(const LodePNGInfo* info, unsigned auto_convert) {
+  if(info->iccp_defined) {
+    unsigned gray_icc = isGrayICCProfile(info->iccp_profile, info->iccp_profile_size);
+    unsigned rgb_icc = isRGBICCProfile(info->iccp_profile, info->iccp_profile_size);
+    unsigned gray_png = info->color.colortype == LCT_GREY || info->color.colortype == LCT_GREY_ALPHA;
+    if(!gray_icc && !rgb_icc) {
+      return 100; /* Disallowed profile color type for PNG */
+    }
+    if(gray_icc != gray_png) {
+      /*Not allowed to use RGB/RGBA/palette with GRAY ICC profile or vice versa,
+      or in case of auto_convert, it wasn't possible to find appropriate model*/
+      return auto_convert ? 102 : 101;
+    }
+  }
+  return 0;
+}
+#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
+
+/*writes the signature and the chunks before the image data, info has the color mode of the PNG*/
+static unsigned addChunksBeforeIDAT(ucvector* out, unsigned w, unsigned h,
+                                    const LodePNGInfo* info, LodePNGEncoderSettings* settings) {
+  /*write signature and chunks*/
+  CERROR_TRY_RETURN(writeSignature(out));
+  /*IHDR*/
+  CERROR_TRY_RETURN(addChunk_IHDR(out, w, h, info->color.colortype, info->color.bitdepth, info->interlace_method));
+#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
+  /*unknown chunks between IHDR and PLTE*/
+  if(info->unknown_chunks_data[0]) {
+    CERROR_TRY_RETURN(addUnknownChunks(out, info->unknown_chunks_data[0], info->unknown_chunks_size[0]));
+  }
+  /*color profile chunks must come before PLTE */
+  if(info->cicp_defined) {
+    CERROR_TRY_RETURN(addChunk_cICP(out, info));
+  }
+  if(info->mdcv_defined) {
+    CERROR_TRY_RETURN(addChunk_mDCv(out, info));
+  }
+  if(info->clli_defined) {
+    CERROR_TRY_RETURN(addChunk_cLLi(out, info));
+  }
+  if(info->iccp_defined) {
+    CERROR_TRY_RETURN(addChunk_iCCP(out, info, &settings->zlibsettings));
+  }
+  if(info->srgb_defined) {
+    CERROR_TRY_RETURN(addChunk_sRGB(out, info));
+  }
+  if(info->gama_defined) {
+    CERROR_TRY_RETURN(addChunk_gAMA(out, info));
+  }
+  if(info->chrm_defined) {
+    CERROR_TRY_RETURN(addChunk_cHRM(out, info));
+  }
+  if(info->sbit_defined) {
+    CERROR_TRY_RETURN(addChunk_sBIT(out, info));
+  }
+  if(info->exif_defined) {
+    CERROR_TRY_RETURN(addChunk_eXIf(out, info));
+  }
+#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
+  /*PLTE*/
+  if(info->color.colortype == LCT_PALETTE) {
+    CERROR_TRY_RETURN(addChunk_PLTE(out, &info->color));
+  }
+  if(settings->force_palette && (info->color.colortype == LCT_RGB || info->color.colortype == LCT_RGBA)) {
+    /*force_palette means: write suggested palette for truecolor in PLTE chunk*/
+    CERROR_TRY_RETURN(addChunk_PLTE(out, &info->color));
+  }
+  /*tRNS (this will only add if when necessary) */
+  CERROR_TRY_RETURN(addChunk_tRNS(out, &info->color));
+#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
+  /*bKGD (must come between PLTE and the IDAt chunks*/
+  if(info->background_defined) {
+    CERROR_TRY_RETURN(addChunk_bKGD(out, info));
+  }
+  /*pHYs (must come before the IDAT chunks)*/
+  if(info->phys_defined) {
+    CERROR_TRY_RETURN(addChunk_pHYs(out, info));
+  }
+
+  /*unknown chunks between PLTE and IDAT*/
+  if(info->unknown_chunks_data[1]) {
+    CERROR_TRY_RETURN(addUnknownChunks(out, info->unknown_chunks_data[1], info->unknown_chunks_size[1]));
+  }
+#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
+  return 0;
+}
+
+/*writes the chunks after the image data, up to IEND*/
+static unsigned addChunksAfterIDAT(ucvector* out, const LodePNGInfo* info, LodePNGEncoderSettings* settings) {
+#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
+  size_t i;
+  /*tIME*/
+  if(info->time_defined) {
+    CERROR_TRY_RETURN(addChunk_tIME(out, &info->time));
+  }
+  /*tEXt and/or zTXt*/
+  for(i = 0; i != info->text_num; ++i) {
+    if(lodepng_strlen(info->text_keys[i]) > 79) {
+      return 66; /*text chunk too large*/
+    }
+    if(lodepng_strlen(info->text_keys[i]) < 1) {
+      return 67; /*text chunk too small*/
+    }
+    if(settings->text_compression) {
+      CERROR_TRY_RETURN(addChunk_zTXt(out, info->text_keys[i], info->text_strings[i], &settings->zlibsettings));
+    } else {
+      CERROR_TRY_RETURN(addChunk_tEXt(out, info->text_keys[i], info->text_strings[i]));
+    }
+  }
+  /*LodePNG version id in text chunk*/
+  if(settings->add_id) {
+    unsigned already_added_id_text = 0;
+    for(i = 0; i != info->text_num; ++i) {
+      const char* k = info->text_keys[i];
+      /* Could use strcmp, but we're not calling or reimplementing this C library function for this use only */
+      if(k[0] == 'L' && k[1] == 'o' && k[2] == 'd' && k[3] == 'e' &&
+         k[4] == 'P' && k[5] == 'N' && k[6] == 'G' && k[7] == '\0') {
+        already_added_id_text = 1;
+        break;
+      }
+    }
+    if(already_added_id_text == 0) {
+      /*it's shorter as tEXt than as zTXt chunk*/
+      CERROR_TRY_RETURN(addChunk_tEXt(out, "LodePNG", LODEPNG_VERSION_STRING));
+    }
+  }
+  /*iTXt*/
+  for(i = 0; i != info->itext_num; ++i) {
+    if(lodepng_strlen(info->itext_keys[i]) > 79) {
+      return 66; /*text chunk too large*/
+    }
+    if(lodepng_strlen(info->itext_keys[i]) < 1) {
+      return 67; /*text chunk too small*/
+    }
+    CERROR_TRY_RETURN(addChunk_iTXt(
+        out, settings->text_compression,
+        info->itext_keys[i], info->itext_langtags[i], info->itext_transkeys[i], info->itext_strings[i],
+        &settings->zlibsettings));
+  }
+
+  /*unknown chunks between IDAT and IEND*/
+  if(info->unknown_chunks_data[2]) {
+    CERROR_TRY_RETURN(addUnknownChunks(out, info->unknown_chunks_data[2], info->unknown_chunks_size[2]));
+  }
+#else /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
+  (void)info;
+  (void)settings;
+#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
+  CERROR_TRY_RETURN(addChunk_IEND(out));
+  return 0;
+}
+
 unsigned lodepng_encode(unsigned char** out, size_t* outsize,
                         const unsigned char* image, unsigned w, unsigned h,
                         LodePNGState* state) {
@@ -6476,6 +9215,7 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
   LodePNGInfo info;
   const LodePNGInfo* info_png = &state->info_png;
   LodePNGColorMode auto_color;
+  TRACE_SCOPE("lodepng_encode");
 
   lodepng_info_init(&info);
   lodepng_color_mode_init(&auto_color);
@@ -6486,30 +9226,11 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
   state->error = 0;
 
   /*check input values validity*/
-  if((info_png->color.colortype == LCT_PALETTE || state->encoder.force_palette)
-      && (info_png->color.palettesize == 0 || info_png->color.palettesize > 256)) {
-    /*this error is returned even if auto_convert is enabled and thus encoder could
-    generate the palette by itself: while allowing this could be possible in theory,
-    it may complicate the code or edge cases, and always requiring to give a palette
-    when setting this color type is a simpler contract*/
-    state->error = 68; /*invalid palette size, it is only allowed to be 1-256*/
-    goto cleanup;
-  }
-  if(state->encoder.zlibsettings.btype > 2) {
-    state->error = 61; /*error: invalid btype*/
-    goto cleanup;
-  }
-  if(info_png->interlace_method > 1) {
-    state->error = 71; /*error: invalid interlace mode*/
-    goto cleanup;
-  }
-  state->error = checkColorValidity(info_png->color.colortype, info_png->color.bitdepth);
-  if(state->error) goto cleanup; /*error: invalid color type given*/
-  state->error = checkColorValidity(state->info_raw.colortype, state->info_raw.bitdepth);
-  if(state->error) goto cleanup; /*error: invalid color type given*/
+  state->error = checkEncoderState(state);
+  if(state->error) goto cleanup;
 
   /* color convert and compute scanline filter types */
-  lodepng_info_copy(&info, &state->info_png);
+  lodepng_info_copy(&info, info_png);
   if(state->encoder.auto_convert) {
     LodePNGColorStats stats;
     unsigned allow_convert = 1;
@@ -6615,21 +9336,8 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
     }
   }
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-  if(info_png->iccp_defined) {
-    unsigned gray_icc = isGrayICCProfile(info_png->iccp_profile, info_png->iccp_profile_size);
-    unsigned rgb_icc = isRGBICCProfile(info_png->iccp_profile, info_png->iccp_profile_size);
-    unsigned gray_png = info.color.colortype == LCT_GREY || info.color.colortype == LCT_GREY_ALPHA;
-    if(!gray_icc && !rgb_icc) {
-      state->error = 100; /* Disallowed profile color type for PNG */
-      goto cleanup;
-    }
-    if(gray_icc != gray_png) {
-      /*Not allowed to use RGB/RGBA/palette with GRAY ICC profile or vice versa,
-      or in case of auto_convert, it wasn't possible to find appropriate model*/
-      state->error = state->encoder.auto_convert ? 102 : 101;
-      goto cleanup;
-    }
-  }
+  state->error = checkICCProfile(&info, state->encoder.auto_convert);
+  if(state->error) goto cleanup;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
   if(!lodepng_color_mode_equal(&state->info_raw, &info.color)) {
     unsigned char* converted;
@@ -6650,161 +9358,18 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
     if(state->error) goto cleanup;
   }
 
-  /* output all PNG chunks */ {
-#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-    size_t i;
-#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-    /*write signature and chunks*/
-    state->error = writeSignature(&outv);
-    if(state->error) goto cleanup;
-    /*IHDR*/
-    state->error = addChunk_IHDR(&outv, w, h, info.color.colortype, info.color.bitdepth, info.interlace_method);
-    if(state->error) goto cleanup;
-#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-    /*unknown chunks between IHDR and PLTE*/
-    if(info.unknown_chunks_data[0]) {
-      state->error = addUnknownChunks(&outv, info.unknown_chunks_data[0], info.unknown_chunks_size[0]);
-      if(state->error) goto cleanup;
-    }
-    /*color profile chunks must come before PLTE */
-    if(info.cicp_defined) {
-      state->error = addChunk_cICP(&outv, &info);
-      if(state->error) goto cleanup;
-    }
-    if(info.mdcv_defined) {
-      state->error = addChunk_mDCv(&outv, &info);
-      if(state->error) goto cleanup;
-    }
-    if(info.clli_defined) {
-      state->error = addChunk_cLLi(&outv, &info);
-      if(state->error) goto cleanup;
-    }
-    if(info.iccp_defined) {
-      state->error = addChunk_iCCP(&outv, &info, &state->encoder.zlibsettings);
-      if(state->error) goto cleanup;
-    }
-    if(info.srgb_defined) {
-      state->error = addChunk_sRGB(&outv, &info);
-      if(state->error) goto cleanup;
-    }
-    if(info.gama_defined) {
-      state->error = addChunk_gAMA(&outv, &info);
-      if(state->error) goto cleanup;
-    }
-    if(info.chrm_defined) {
-      state->error = addChunk_cHRM(&outv, &info);
-      if(state->error) goto cleanup;
-    }
-    if(info_png->sbit_defined) {
-      state->error = addChunk_sBIT(&outv, &info);
-      if(state->error) goto cleanup;
-    }
-    if(info.exif_defined) {
-      state->error = addChunk_eXIf(&outv, &info);
-      if(state->error) goto cleanup;
-    }
-#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-    /*PLTE*/
-    if(info.color.colortype == LCT_PALETTE) {
-      state->error = addChunk_PLTE(&outv, &info.color);
-      if(state->error) goto cleanup;
-    }
-    if(state->encoder.force_palette && (info.color.colortype == LCT_RGB || info.color.colortype == LCT_RGBA)) {
-      /*force_palette means: write suggested palette for truecolor in PLTE chunk*/
-      state->error = addChunk_PLTE(&outv, &info.color);
-      if(state->error) goto cleanup;
-    }
-    /*tRNS (this will only add if when necessary) */
-    state->error = addChunk_tRNS(&outv, &info.color);
-    if(state->error) goto cleanup;
-#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-    /*bKGD (must come between PLTE and the IDAt chunks*/
-    if(info.background_defined) {
-      state->error = addChunk_bKGD(&outv, &info);
-      if(state->error) goto cleanup;
-    }
-    /*pHYs (must come before the IDAT chunks)*/
-    if(info.phys_defined) {
-      state->error = addChunk_pHYs(&outv, &info);
-      if(state->error) goto cleanup;
-    }
-
-    /*unknown chunks between PLTE and IDAT*/
-    if(info.unknown_chunks_data[1]) {
-      state->error = addUnknownChunks(&outv, info.unknown_chunks_data[1], info.unknown_chunks_size[1]);
-      if(state->error) goto cleanup;
-    }
-#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-    /*IDAT (multiple IDAT chunks must be consecutive)*/
-    state->error = addChunk_IDAT(&outv, data, datasize, &state->encoder.zlibsettings);
-    if(state->error) goto cleanup;
-#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
-    /*tIME*/
-    if(info.time_defined) {
-      state->error = addChunk_tIME(&outv, &info.time);
-      if(state->error) goto cleanup;
-    }
-    /*tEXt and/or zTXt*/
-    for(i = 0; i != info.text_num; ++i) {
-      if(lodepng_strlen(info.text_keys[i]) > 79) {
-        state->error = 66; /*text chunk too large*/
-        goto cleanup;
-      }
-      if(lodepng_strlen(info.text_keys[i]) < 1) {
-        state->error = 67; /*text chunk too small*/
-        goto cleanup;
-      }
-      if(state->encoder.text_compression) {
-        state->error = addChunk_zTXt(&outv, info.text_keys[i], info.text_strings[i], &state->encoder.zlibsettings);
-        if(state->error) goto cleanup;
-      } else {
-        state->error = addChunk_tEXt(&outv, info.text_keys[i], info.text_strings[i]);
-        if(state->error) goto cleanup;
-      }
-    }
-    /*LodePNG version id in text chunk*/
-    if(state->encoder.add_id) {
-      unsigned already_added_id_text = 0;
-      for(i = 0; i != info.text_num; ++i) {
-        const char* k = info.text_keys[i];
-        /* Could use strcmp, but we're not calling or reimplementing this C library function for this use only */
-        if(k[0] == 'L' && k[1] == 'o' && k[2] == 'd' && k[3] == 'e' &&
-           k[4] == 'P' && k[5] == 'N' && k[6] == 'G' && k[7] == '\0') {
-          already_added_id_text = 1;
-          break;
-        }
-      }
-      if(already_added_id_text == 0) {
-        state->error = addChunk_tEXt(&outv, "LodePNG", LODEPNG_VERSION_STRING); /*it's shorter as tEXt than as zTXt chunk*/
-        if(state->error) goto cleanup;
-      }
-    }
-    /*iTXt*/
-    for(i = 0; i != info.itext_num; ++i) {
-      if(lodepng_strlen(info.itext_keys[i]) > 79) {
-        state->error = 66; /*text chunk too large*/
-        goto cleanup;
-      }
-      if(lodepng_strlen(info.itext_keys[i]) < 1) {
-        state->error = 67; /*text chunk too small*/
-        goto cleanup;
-      }
-      state->error = addChunk_iTXt(
-          &outv, state->encoder.text_compression,
-          info.itext_keys[i], info.itext_langtags[i], info.itext_transkeys[i], info.itext_strings[i],
-          &state->encoder.zlibsettings);
-      if(state->error) goto cleanup;
-    }
-
-    /*unknown chunks between IDAT and IEND*/
-    if(info.unknown_chunks_data[2]) {
-      state->error = addUnknownChunks(&outv, info.unknown_chunks_data[2], info.unknown_chunks_size[2]);
-      if(state->error) goto cleanup;
-    }
-#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
-    state->error = addChunk_IEND(&outv);
-    if(state->error) goto cleanup;
+  /* output all PNG chunks */
+  state->error = addChunksBeforeIDAT(&outv, w, h, &info, &state->encoder);
+  if(state->error) goto cleanup;
+  /*IDAT (multiple IDAT chunks must be consecutive)*/
+  {
+    LodePNGCompressSettings zlibsettings = state->encoder.zlibsettings;
+    /*the image data uses the encoder's threads, unless the zlib settings ask for a number of their own*/
+    if(zlibsettings.num_threads == 1) zlibsettings.num_threads = state->encoder.num_threads;
+    state->error = addChunk_IDAT(&outv, data, datasize, &zlibsettings);
   }
+  if(state->error) goto cleanup;
+  state->error = addChunksAfterIDAT(&outv, &info, &state->encoder);
 
 cleanup:
   lodepng_info_cleanup(&info);
@@ -6841,6 +9406,212 @@ unsigned lodepng_encode24(unsigned char** out, size_t* outsize, const unsigned c
   return lodepng_encode_memory(out, outsize, image, w, h, LCT_RGB, 8);
 }
 
+#ifdef LODEPNG_COMPILE_ZLIB
+struct LodePNGStreamEncoderInternal {
+  unsigned y; /*rows received*/
+  unsigned convert; /*whether rows are converted from info_raw to info_png*/
+  size_t linebytes, bytewidth; /*as in filter*/
+  LodePNGFilterStrategy strategy;
+  unsigned char* rows; /*the previous and the current row in the mode of the PNG, linebytes each*/
+  unsigned char* filtered; /*two filtered scanlines with the filter byte first, the second one is the output*/
+  ucvector image; /*the whole image of an interlaced PNG, without padding bits between rows*/
+  unsigned deflating; /*deflate is initialized*/
+  DeflateStream deflate;
+  ucvector chunks; /*the PNG data not written yet*/
+};
+
+void lodepng_stream_encoder_init(LodePNGStreamEncoder* encoder, unsigned w, unsigned h,
+                                 LodePNGWriteCallback write, void* context) {
+  lodepng_state_init(&encoder->state);
+  encoder->state.error = 0; /*the error of the encoding so far*/
+  encoder->width = w;
+  encoder->height = h;
+  encoder->idat_size = 65536;
+  encoder->write = write;
+  encoder->context = context;
+  encoder->internal = 0;
+}
+
+void lodepng_stream_encoder_cleanup(LodePNGStreamEncoder* encoder) {
+  struct LodePNGStreamEncoderInternal* s = encoder->internal;
+  if(s) {
+    lodepng_free(s->rows);
+    lodepng_free(s->filtered);
+    lodepng_free(s->image.data);
+    if(s->deflating) DeflateStream_cleanup(&s->deflate);
+    lodepng_free(s->chunks.data);
+    lodepng_free(s);
+    encoder->internal = 0;
+  }
+  lodepng_state_cleanup(&encoder->state);
+}
+
+/*passes the chunks made so far to the write callback*/
+static unsigned streamWrite(LodePNGStreamEncoder* encoder) {
+  struct LodePNGStreamEncoderInternal* s = encoder->internal;
+  if(s->chunks.size) {
+    if(encoder->write(encoder->context, s->chunks.data, s->chunks.size)) return 125;
+    s->chunks.size = 0;
+  }
+  return 0;
+}
+
+/*makes IDAT chunks of idat_size bytes of the compressed data, and of the rest too if final*/
+static unsigned streamIDAT(LodePNGStreamEncoder* encoder, unsigned final) {
+  struct LodePNGStreamEncoderInternal* s = encoder->internal;
+  /* max chunk length allowed by the specification is 2147483647 bytes */
+  size_t chunksize = LODEPNG_MAX((size_t)1u, LODEPNG_MIN(encoder->idat_size, (size_t)2147483647u));
+  size_t complete = DeflateStream_complete(&s->deflate), pos = 0;
+  while(complete - pos >= chunksize || (final && pos != complete)) {
+    size_t size = LODEPNG_MIN(chunksize, complete - pos);
+    CERROR_TRY_RETURN(lodepng_chunk_createv(&s->chunks, size, "IDAT", s->deflate.out.data + pos));
+    pos += size;
+  }
+  DeflateStream_take(&s->deflate, pos);
+  return streamWrite(encoder);
+}
+
+/*checks the settings, and writes the chunks before the image data*/
+static unsigned streamEncodeBegin(LodePNGStreamEncoder* encoder) {
+  struct LodePNGStreamEncoderInternal* s = encoder->internal;
+  LodePNGState* state = &encoder->state;
+  const LodePNGColorMode* color = &state->info_png.color;
+  unsigned bpp = lodepng_get_bpp(color);
+  if(!encoder->width || !encoder->height) return 93;
+  CERROR_TRY_RETURN(checkEncoderState(state));
+#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
+  CERROR_TRY_RETURN(checkICCProfile(&state->info_png, 0));
+#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
+  s->convert = !lodepng_color_mode_equal(&state->info_raw, color);
+  s->linebytes = lodepng_get_raw_size_idat(encoder->width, 1, bpp) - 1u;
+  s->bytewidth = (bpp + 7u) / 8u;
+  s->strategy = state->encoder.filter_strategy;
+  if(state->encoder.filter_palette_zero && (color->colortype == LCT_PALETTE || color->bitdepth < 8)) {
+    s->strategy = LFS_ZERO; /*as in filter*/
+  }
+  if(s->strategy > LFS_PREDEFINED) return 88; /* unknown filter strategy */
+
+  s->rows = (unsigned char*)lodepng_malloc(2 * s->linebytes);
+  s->filtered = (unsigned char*)lodepng_malloc(2 * (s->linebytes + 1u));
+  if(!s->rows || !s->filtered) return 83; /*alloc fail*/
+  if(state->info_png.interlace_method == 0) {
+    /*the size of the data is known, so the deflate blocks are those lodepng_encode gives*/
+    size_t datasize = (size_t)encoder->height * (s->linebytes + 1u);
+    s->deflating = 1;
+    CERROR_TRY_RETURN(DeflateStream_init(&s->deflate, datasize, &state->encoder.zlibsettings));
+  }
+  CERROR_TRY_RETURN(addChunksBeforeIDAT(&s->chunks, encoder->width, encoder->height,
+                                        &state->info_png, &state->encoder));
+  return streamWrite(encoder);
+}
+
+/*filters the row in the second half of rows, and compresses it*/
+static unsigned streamFilter(LodePNGStreamEncoder* encoder) {
+  struct LodePNGStreamEncoderInternal* s = encoder->internal;
+  const LodePNGEncoderSettings* settings = &encoder->state.encoder;
+  size_t linebytes = s->linebytes;
+  unsigned char* cur = s->rows + linebytes;
+  unsigned char* out = s->filtered + linebytes + 1u;
+  if(s->strategy == LFS_MINSUM || s->strategy == LFS_ENTROPY || s->strategy == LFS_BRUTE_FORCE) {
+    /*filterAdaptive works on whole images, this is an image of the previous and the current row*/
+    if(s->y) {
+      CERROR_TRY_RETURN(filterAdaptive(s->filtered, s->rows, linebytes, s->bytewidth, 1, 2,
+                                       s->strategy, &settings->zlibsettings));
+    } else {
+      CERROR_TRY_RETURN(filterAdaptive(out, cur, linebytes, s->bytewidth, 0, 1,
+                                       s->strategy, &settings->zlibsettings));
+    }
+  } else {
+    unsigned char type = s->strategy == LFS_PREDEFINED ? settings->predefined_filters[s->y]
+                                                       : (unsigned char)s->strategy;
+    out[0] = type;
+    filterScanline(out + 1, cur, s->y ? s->rows : 0, linebytes, s->bytewidth, type);
+  }
+  CERROR_TRY_RETURN(DeflateStream_push(&s->deflate, out, linebytes + 1u));
+  return streamIDAT(encoder, 0);
+}
+
+/*takes in one row of info_raw's mode, and filters and compresses it or adds it to the interlaced image*/
+static unsigned streamEncodeRow(LodePNGStreamEncoder* encoder, const unsigned char* row) {
+  struct LodePNGStreamEncoderInternal* s = encoder->internal;
+  LodePNGState* state = &encoder->state;
+  size_t bits = (size_t)encoder->width * lodepng_get_bpp(&state->info_png.color);
+  unsigned char* cur = s->rows + s->linebytes;
+  if(s->convert) {
+    CERROR_TRY_RETURN(lodepng_convert(cur, row, &state->info_png.color, &state->info_raw, encoder->width, 1));
+  } else {
+    lodepng_memcpy(cur, row, s->linebytes);
+  }
+  /*the padding bits of the scanline are 0, as in addPaddingBits*/
+  if(bits & 7u) cur[s->linebytes - 1u] &= (unsigned char)(0xff00u >> (bits & 7u));
+
+  if(state->info_png.interlace_method == 0) {
+    CERROR_TRY_RETURN(streamFilter(encoder));
+    lodepng_memcpy(s->rows, cur, s->linebytes);
+  } else if(bits & 7u) {
+    /*the rows of the image are not padded to a byte, as preProcessScanlines expects*/
+    size_t x, ibp = 0, obp = (size_t)s->y * bits;
+    if(!ucvector_resize(&s->image, (obp + bits + 7u) / 8u)) return 83; /*alloc fail*/
+    for(x = 0; x != bits; ++x) setBitOfReversedStream(&obp, s->image.data, readBitFromReversedStream(&ibp, cur));
+  } else {
+    size_t pos = s->image.size;
+    if(!ucvector_resize(&s->image, pos + s->linebytes)) return 83; /*alloc fail*/
+    lodepng_memcpy(s->image.data + pos, cur, s->linebytes);
+  }
+  ++s->y;
+  return 0;
+}
+
+unsigned lodepng_stream_encoder_push(LodePNGStreamEncoder* encoder, const unsigned char* rows, unsigned count) {
+  struct LodePNGStreamEncoderInternal* s = encoder->internal;
+  LodePNGState* state = &encoder->state;
+  size_t rowbytes = lodepng_get_raw_size(encoder->width, 1, &state->info_raw);
+  unsigned i;
+  if(state->error) return state->error;
+
+  if(!s) {
+    s = (struct LodePNGStreamEncoderInternal*)lodepng_malloc(sizeof(struct LodePNGStreamEncoderInternal));
+    if(!s) CERROR_RETURN_ERROR(state->error, 83); /*alloc fail*/
+    lodepng_memset(s, 0, sizeof(struct LodePNGStreamEncoderInternal));
+    s->image = ucvector_init(NULL, 0);
+    s->chunks = ucvector_init(NULL, 0);
+    encoder->internal = s;
+    state->error = streamEncodeBegin(encoder);
+  }
+
+  for(i = 0; i != count && !state->error; ++i) {
+    if(s->y == encoder->height) state->error = 123; /*error: more rows than the height*/
+    else state->error = streamEncodeRow(encoder, rows + i * rowbytes);
+  }
+  return state->error;
+}
+
+unsigned lodepng_stream_encoder_finish(LodePNGStreamEncoder* encoder) {
+  struct LodePNGStreamEncoderInternal* s = encoder->internal;
+  LodePNGState* state = &encoder->state;
+  if(state->error) return state->error;
+  if(!s || s->y != encoder->height) CERROR_RETURN_ERROR(state->error, 124); /*error: not all rows were pushed*/
+
+  if(state->info_png.interlace_method != 0) {
+    unsigned char* data = 0;
+    size_t datasize = 0;
+    state->error = preProcessScanlines(&data, &datasize, s->image.data, encoder->width, encoder->height,
+                                       &state->info_png, &state->encoder);
+    if(!state->error) {
+      s->deflating = 1;
+      state->error = DeflateStream_init(&s->deflate, datasize, &state->encoder.zlibsettings);
+    }
+    if(!state->error) state->error = DeflateStream_push(&s->deflate, data, datasize);
+    lodepng_free(data);
+  }
+  if(!state->error) state->error = DeflateStream_finish(&s->deflate);
+  if(!state->error) state->error = streamIDAT(encoder, 1);
+  if(!state->error) state->error = addChunksAfterIDAT(&s->chunks, &state->info_png, &state->encoder);
+  if(!state->error) state->error = streamWrite(encoder);
+  return state->error;
+}
+#endif /*LODEPNG_COMPILE_ZLIB*/
+
 #ifdef LODEPNG_COMPILE_DISK
 unsigned lodepng_encode_file(const char* filename, const unsigned char* image, unsigned w, unsigned h,
                              LodePNGColorType colortype, unsigned bitdepth) {
@@ -6868,6 +9639,7 @@ void lodepng_encoder_settings_init(LodePNGEncoderSettings* settings) {
   settings->auto_convert = 1;
   settings->force_palette = 0;
   settings->predefined_filters = 0;
+  settings->num_threads = 1;
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
   settings->add_id = 0;
   settings->text_compression = 1;
@@ -7013,6 +9785,9 @@ const char* lodepng_error_text(unsigned code) {
     case 120: return "invalid cLLi chunk size";
     case 121: return "invalid chunk type name: may only contain [a-zA-Z]";
     case 122: return "invalid chunk type name: third character must be uppercase";
+    case 123: return "more rows given to the streaming encoder than the height of the image";
+    case 124: return "streaming encoder finished before all rows of the image were given";
+    case 125: return "the write callback of the streaming encoder failed";
   }
   return "unknown error code";
 }
@@ -7155,6 +9930,28 @@ unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h,
   return decode(out, w, h, state, in.empty() ? 0 : &in[0], in.size());
 }
 
+#ifdef LODEPNG_COMPILE_ZLIB
+StreamDecoder::StreamDecoder(LodePNGRowCallback callback, void* context) {
+  lodepng_stream_decoder_init(this, callback, context);
+}
+
+StreamDecoder::~StreamDecoder() {
+  lodepng_stream_decoder_cleanup(this);
+}
+
+unsigned StreamDecoder::push(const unsigned char* data, size_t size) {
+  return lodepng_stream_decoder_push(this, data, size);
+}
+
+unsigned StreamDecoder::push(const std::vector<unsigned char>& data) {
+  return lodepng_stream_decoder_push(this, data.empty() ? 0 : &data[0], data.size());
+}
+
+unsigned StreamDecoder::finish() {
+  return lodepng_stream_decoder_finish(this);
+}
+#endif /*LODEPNG_COMPILE_ZLIB*/
+
 #ifdef LODEPNG_COMPILE_DISK
 unsigned decode(std::vector<unsigned char>& out, unsigned& w, unsigned& h, const std::string& filename,
                 LodePNGColorType colortype, unsigned bitdepth) {
@@ -7208,6 +10005,29 @@ unsigned encode(std::vector<unsigned char>& out,
   return encode(out, in.empty() ? 0 : &in[0], w, h, state);
 }
 
+#ifdef LODEPNG_COMPILE_ZLIB
+StreamEncoder::StreamEncoder(unsigned w, unsigned h, LodePNGWriteCallback write, void* context) {
+  lodepng_stream_encoder_init(this, w, h, write, context);
+}
+
+StreamEncoder::~StreamEncoder() {
+  lodepng_stream_encoder_cleanup(this);
+}
+
+unsigned StreamEncoder::push(const unsigned char* rows, unsigned count) {
+  return lodepng_stream_encoder_push(this, rows, count);
+}
+
+unsigned StreamEncoder::push(const std::vector<unsigned char>& rows) {
+  size_t rowbytes = lodepng_get_raw_size(width, 1, &state.info_raw);
+  return lodepng_stream_encoder_push(this, rows.empty() ? 0 : &rows[0], (unsigned)(rows.size() / rowbytes));
+}
+
+unsigned StreamEncoder::finish() {
+  return lodepng_stream_encoder_finish(this);
+}
+#endif /*LODEPNG_COMPILE_ZLIB*/
+
 #ifdef LODEPNG_COMPILE_DISK
 unsigned encode(const std::string& filename,
                 const unsigned char* in, unsigned w, unsigned h,
@@ -0,0 +1,189 @@
+//=============================================================================================
+// Shader hot reload: fájlfigyelés és háttérben fordított programcsere
+//=============================================================================================
+#include "shaderwatch.h"
+#include <chrono>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+static fs::path canonicalPath(const fs::path& path) {
+	std::error_code ec;
+	fs::path canonical = fs::weakly_canonical(path, ec);
+	return ec ? path : canonical;
+}
+
+void ShaderWatcher::watch(const fs::path& file) {
+	fs::path path = canonicalPath(file);
+	std::lock_guard<std::mutex> lock(mutex);
+	for (const fs::path& f : files) if (f == path) return;
+	files.push_back(path);
+#ifdef __linux__
+	if (inotifyFd < 0) inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	fs::path dir = path.parent_path();
+	bool watched = false;
+	for (auto& entry : watchedDirs) if (entry.second == dir) watched = true;
+	if (!watched && inotifyFd >= 0) {
+		// A könyvtárat figyeljük, mert sok szerkesztő új fájlt ír és átnevezi a régire
+		int wd = inotify_add_watch(inotifyFd, dir.string().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (wd >= 0) watchedDirs[wd] = dir;
+	}
+#else
+	std::error_code ec;
+	writeTimes[path] = fs::last_write_time(path, ec);
+#endif
+	if (!running) {
+		running = true;
+		thread = std::thread(&ShaderWatcher::run, this);
+	}
+}
+
+void ShaderWatcher::fileChanged(const fs::path& file) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		bool watched = false;
+		for (const fs::path& f : files) if (f == file) watched = true;
+		if (!watched) return;
+	}
+	std::string source = GPUProgram::file2string(file); // a beolvasás is a háttérszálon történik
+	if (source.empty()) return; // félbehagyott írás, a következő esemény hozza a teljes fájlt
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& change : changes) {
+		if (change.first == file) {
+			change.second = std::move(source);
+			return;
+		}
+	}
+	changes.push_back({ file, std::move(source) });
+}
+
+void ShaderWatcher::run() {
+#ifdef __linux__
+	alignas(struct inotify_event) char buffer[4096];
+	while (running) {
+		pollfd pfd = { inotifyFd, POLLIN, 0 };
+		if (::poll(&pfd, 1, 100) <= 0) continue; // időnként a running-ot is megnézzük
+		ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+		for (char* p = buffer; length > 0 && p < buffer + length; ) {
+			const struct inotify_event* event = (const struct inotify_event*)p;
+			p += sizeof(struct inotify_event) + event->len;
+			if (event->len == 0) continue;
+			fs::path file;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				auto dir = watchedDirs.find(event->wd);
+				if (dir == watchedDirs.end()) continue;
+				file = dir->second / event->name;
+			}
+			fileChanged(file);
+		}
+	}
+#else
+	while (running) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(250));
+		std::vector<fs::path> changed;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto& entry : writeTimes) {
+				std::error_code ec;
+				fs::file_time_type time = fs::last_write_time(entry.first, ec);
+				if (!ec && time != entry.second) {
+					entry.second = time;
+					changed.push_back(entry.first);
+				}
+			}
+		}
+		for (const fs::path& file : changed) fileChanged(file);
+	}
+#endif
+}
+
+bool ShaderWatcher::poll(fs::path& file, std::string& source) {
+	if (!running) return false;
+	std::lock_guard<std::mutex> lock(mutex);
+	if (changes.empty()) return false;
+	file = std::move(changes.front().first);
+	source = std::move(changes.front().second);
+	changes.erase(changes.begin());
+	return true;
+}
+
+ShaderWatcher::~ShaderWatcher() {
+	if (running) {
+		running = false;
+		thread.join();
+	}
+#ifdef __linux__
+	if (inotifyFd >= 0) close(inotifyFd);
+#endif
+}
+
+void ShaderHotReload::add(GPUProgram* program) {
+	Entry entry;
+	entry.program = program;
+	for (auto& file : program->shaderFiles) {
+		fs::path path = canonicalPath(file.second);
+		entry.files.push_back({ file.first, path });
+		if (sources.find(path) == sources.end()) sources[path] = GPUProgram::file2string(path);
+		watcher.watch(path);
+	}
+	entries.push_back(std::move(entry));
+}
+
+void ShaderHotReload::remove(GPUProgram* program) {
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].program == program) {
+			entries.erase(entries.begin() + i);
+			return;
+		}
+	}
+}
+
+void ShaderHotReload::startBuild(Entry& entry) {
+	const char* vertexSource = nullptr, * fragmentSource = nullptr, * geometrySource = nullptr;
+	for (auto& file : entry.files) {
+		const char* source = sources[file.second].c_str();
+		switch (file.first) {
+		case GL_VERTEX_SHADER:		vertexSource = source; break;
+		case GL_FRAGMENT_SHADER:	fragmentSource = source; break;
+		case GL_GEOMETRY_SHADER:	geometrySource = source; break;
+		}
+	}
+	if (!vertexSource || !fragmentSource) return;
+	entry.staging.reset(new GPUProgram());
+	entry.staging->waitError = false; // hibánál nem állíthatjuk meg a főciklust
+	entry.staging->createAsync(vertexSource, fragmentSource, geometrySource);
+	entry.dirty = false;
+}
+
+void ShaderHotReload::update() {
+	if (entries.empty()) return;
+	TRACE_SCOPE("ShaderHotReload::update");
+	fs::path file;
+	std::string source;
+	while (watcher.poll(file, source)) {
+		sources[file] = std::move(source);
+		for (Entry& entry : entries) {
+			for (auto& f : entry.files) if (f.second == file) entry.dirty = true;
+		}
+	}
+
+	for (Entry& entry : entries) {
+		if (entry.dirty && !entry.staging) startBuild(entry);
+		if (!entry.staging) continue;
+		if (entry.staging->isReady()) {
+			// Csere: a régi program az ideiglenes objektummal együtt törlődik
+			std::swap(entry.program->shaderProgramId, entry.staging->shaderProgramId);
+			printf("Shader program reloaded (%s)\n", entry.files.front().second.filename().string().c_str());
+		}
+		else if (entry.staging->pending) {
+			continue; // még fordul
+		}
+		else {
+			printf("Shader reload failed, keeping the previous program\n");
+		}
+		entry.staging.reset();
+	}
+}
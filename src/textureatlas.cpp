@@ -0,0 +1,332 @@
+//=============================================================================================
+// Textúra atlasz és textúra tömb
+//=============================================================================================
+#include "textureatlas.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <numeric>
+#include <string.h>
+
+int TextureAtlas::add(const fs::path& path, bool transparent) {
+	sources.push_back({ path, transparent });
+	return (int)sources.size() - 1;
+}
+
+// Kulcs: a képek útvonala, mérete és módosítási ideje, valamint a csomagolás paraméterei (FNV-1a)
+uint64_t TextureAtlas::cacheKey(int maxSize, int padding) const {
+	std::string id;
+	char params[96];
+	for (const Source& source : sources) {
+		std::error_code ec;
+		fs::path canonical = fs::weakly_canonical(source.path, ec);
+		uintmax_t size = fs::file_size(source.path, ec);
+		long long time = (long long)fs::last_write_time(source.path, ec).time_since_epoch().count();
+		snprintf(params, sizeof(params), "|%llu|%lld|%d;", (unsigned long long)size, time, source.transparent ? 1 : 0);
+		id += canonical.string() + params;
+	}
+	snprintf(params, sizeof(params), "%d|%d|%d|1", (int)layout, maxSize, padding); // az utolsó szám a formátum verziója
+	id += params;
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for (unsigned char c : id) {
+		h ^= c;
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static fs::path atlasFileName(const fs::path& directory, uint64_t key) {
+	char name[40];
+	snprintf(name, sizeof(name), "atlas_%016llx.bin", (unsigned long long)key);
+	return directory / name;
+}
+
+// Bejegyzés: "GTA1", elrendezés, szélesség, magasság, rétegek, képek száma, a régiók, majd a pixelek
+static const uint32_t atlasMagic = 0x31415447; // "GTA1"
+
+bool TextureAtlas::loadCache(uint64_t key) {
+	if (!cacheEnabled) return false;
+	fs::path path = atlasFileName(cacheDirectory, key);
+	FILE* file = fopen(path.string().c_str(), "rb");
+	if (!file) return false;
+	uint32_t header[6] = { 0, 0, 0, 0, 0, 0 };
+	bool ok = fread(header, sizeof(header), 1, file) == 1 && header[0] == atlasMagic && header[1] == (uint32_t)layout
+		&& header[5] == sources.size() && header[2] <= 16384 && header[3] <= 16384 && header[4] <= 2048;
+	if (ok) {
+		width = (int)header[2];
+		height = (int)header[3];
+		layers = (int)header[4];
+		regions.resize(sources.size());
+		for (AtlasRegion& region : regions) {
+			float uv[4];
+			int32_t info[3];
+			ok = fread(uv, sizeof(uv), 1, file) == 1 && fread(info, sizeof(info), 1, file) == 1;
+			if (!ok) break;
+			region.uvMin = vec2(uv[0], uv[1]);
+			region.uvMax = vec2(uv[2], uv[3]);
+			region.layer = info[0];
+			region.width = info[1];
+			region.height = info[2];
+		}
+	}
+	if (ok) {
+		pixels.resize((size_t)width * height * layers * 4);
+		ok = fread(pixels.data(), 1, pixels.size(), file) == pixels.size();
+	}
+	fclose(file);
+	if (!ok) {
+		regions.clear();
+		pixels.clear();
+		std::error_code ec;
+		fs::remove(path, ec); // sérült bejegyzés, a következő csomagolás felülírja
+	}
+	return ok;
+}
+
+void TextureAtlas::storeCache(uint64_t key) const {
+	if (!cacheEnabled) return;
+	std::error_code ec;
+	fs::create_directories(cacheDirectory, ec);
+	fs::path path = atlasFileName(cacheDirectory, key);
+	fs::path tmp = path;
+	tmp += ".tmp";
+	FILE* file = fopen(tmp.string().c_str(), "wb");
+	if (!file) return;
+	uint32_t header[6] = { atlasMagic, (uint32_t)layout, (uint32_t)width, (uint32_t)height, (uint32_t)layers, (uint32_t)regions.size() };
+	bool ok = fwrite(header, sizeof(header), 1, file) == 1;
+	for (const AtlasRegion& region : regions) {
+		float uv[4] = { region.uvMin.x, region.uvMin.y, region.uvMax.x, region.uvMax.y };
+		int32_t info[3] = { region.layer, region.width, region.height };
+		ok = ok && fwrite(uv, sizeof(uv), 1, file) == 1 && fwrite(info, sizeof(info), 1, file) == 1;
+	}
+	ok = ok && fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+	fclose(file);
+	if (ok) fs::rename(tmp, path, ec);
+	else fs::remove(tmp, ec);
+}
+
+// A kép bemásolása (x, y)-ba, körben padding pixelnyi keretben a szélső pixelek ismétlésével,
+// hogy a lineáris szűrés és a mipmapek ne keverjék bele a szomszéd képeket
+static void blit(unsigned char* atlas, int atlasWidth, int atlasHeight, const unsigned char* image, int w, int h, int x, int y, int padding) {
+	for (int dy = -padding; dy < h + padding; dy++) {
+		int ty = y + dy;
+		if (ty < 0 || ty >= atlasHeight) continue;
+		int sy = dy < 0 ? 0 : dy >= h ? h - 1 : dy;
+		for (int dx = -padding; dx < w + padding; dx++) {
+			int tx = x + dx;
+			if (tx < 0 || tx >= atlasWidth) continue;
+			int sx = dx < 0 ? 0 : dx >= w ? w - 1 : dx;
+			memcpy(&atlas[((size_t)ty * atlasWidth + tx) * 4], &image[((size_t)sy * w + sx) * 4], 4);
+		}
+	}
+}
+
+bool TextureAtlas::pack(std::vector<std::vector<unsigned char>>& images, int maxSize, int padding) {
+	int n = (int)sources.size();
+	int maxWidth = 1, maxHeight = 1;
+	size_t area = 0;
+	for (int i = 0; i < n; i++) {
+		maxWidth = std::max(maxWidth, regions[i].width);
+		maxHeight = std::max(maxHeight, regions[i].height);
+		area += (size_t)(regions[i].width + 2 * padding) * (regions[i].height + 2 * padding);
+	}
+
+	if (layout == ATLAS_ARRAY) {
+		width = maxWidth;
+		height = maxHeight;
+		layers = n;
+		if (width > maxSize || height > maxSize) return false;
+		pixels.assign((size_t)width * height * layers * 4, 0);
+		for (int i = 0; i < n; i++) {
+			AtlasRegion& region = regions[i];
+			region.layer = i;
+			region.uvMin = vec2(0, 0);
+			region.uvMax = vec2((float)region.width / width, (float)region.height / height);
+			// A kép a réteg bal felső sarkába kerül, a maradékot a szélső pixelek töltik ki
+			blit(&pixels[(size_t)width * height * 4 * i], width, height, images[i].data(), region.width, region.height, 0, 0, std::max(width, height));
+		}
+		return true;
+	}
+
+	// Polcos csomagolás: magasság szerint csökkenő sorrendben, balról jobbra, a polc a legmagasabb képhez igazodik
+	std::vector<int> order(n);
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [this](int a, int b) { return regions[a].height > regions[b].height; });
+	width = 64;
+	while (width < maxWidth + 2 * padding || (size_t)width * width < area) width *= 2;
+	if (width > maxSize) return false;
+	std::vector<ivec2> positions(n);
+	int x = 0, y = 0, shelfHeight = 0;
+	for (int i : order) {
+		int w = regions[i].width + 2 * padding, h = regions[i].height + 2 * padding;
+		if (x + w > width) { // új polc
+			y += shelfHeight;
+			x = 0;
+			shelfHeight = 0;
+		}
+		positions[i] = ivec2(x + padding, y + padding);
+		x += w;
+		shelfHeight = std::max(shelfHeight, h);
+	}
+	height = (y + shelfHeight + 3) / 4 * 4;
+	if (height > maxSize) return false;
+	layers = 1;
+	pixels.assign((size_t)width * height * 4, 0);
+	for (int i = 0; i < n; i++) {
+		AtlasRegion& region = regions[i];
+		region.layer = 0;
+		region.uvMin = vec2((float)positions[i].x / width, (float)positions[i].y / height);
+		region.uvMax = vec2((float)(positions[i].x + region.width) / width, (float)(positions[i].y + region.height) / height);
+		blit(pixels.data(), width, height, images[i].data(), region.width, region.height, positions[i].x, positions[i].y, padding);
+	}
+	return true;
+}
+
+void TextureAtlas::upload(int sampling, int flags) {
+	if (textureId == 0) glGenTextures(1, &textureId);
+	GLenum t = target();
+	glBindTexture(t, textureId);
+	if (layout == ATLAS_ARRAY) glTexImage3D(t, 0, GL_RGBA8, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	else glTexImage2D(t, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	memory = (size_t)width * height * layers * 4;
+	int minSampling = sampling;
+	if (flags & TEXTURE_MIPMAPS) {
+		glGenerateMipmap(t);
+		memory += memory / 3;
+		minSampling = sampling == GL_NEAREST ? GL_NEAREST_MIPMAP_NEAREST : GL_LINEAR_MIPMAP_LINEAR;
+	}
+	glTexParameteri(t, GL_TEXTURE_MIN_FILTER, minSampling);
+	glTexParameteri(t, GL_TEXTURE_MAG_FILTER, sampling);
+	glTexParameteri(t, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(t, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	pixels.clear();
+	pixels.shrink_to_fit(); // a CPU oldali másolatra nincs szükség
+}
+
+bool TextureAtlas::build(AtlasLayout _layout, int maxSize, int padding, int sampling, int flags) {
+	TRACE_SCOPE("TextureAtlas::build");
+	layout = _layout;
+	if (sources.empty()) return false;
+	uint64_t key = cacheKey(maxSize, padding);
+	if (loadCache(key)) { // sem dekódolni, sem csomagolni nem kell
+		upload(sampling, flags);
+		printf("Texture atlas: %d images, %dx%dx%d (cached)\n", imageCount(), width, height, layers);
+		return true;
+	}
+
+	// Dekódolás a szálkészleten, képenként egy feladat
+	int n = (int)sources.size();
+	std::vector<std::vector<unsigned char>> images(n);
+	std::vector<unsigned> errors(n, 0);
+	regions.assign(n, AtlasRegion());
+	{
+		ThreadPool decoders;
+		for (int i = 0; i < n; i++) {
+			decoders.submit([this, i, &images, &errors]() {
+				unsigned char* decoded = nullptr;
+				unsigned int w = 0, h = 0;
+				errors[i] = lodepng_decode_file_mapped(&decoded, &w, &h, sources[i].path.string().c_str(), LCT_RGBA, 8);
+				if (!errors[i]) {
+					if (sources[i].transparent) Texture::alphaFromLuminance(decoded, (size_t)w * h);
+					images[i].assign(decoded, decoded + (size_t)w * h * 4);
+					regions[i].width = w;
+					regions[i].height = h;
+				}
+				free(decoded);
+			});
+		}
+		decoders.wait();
+	}
+	for (int i = 0; i < n; i++) {
+		if (errors[i]) {
+			printf("Error while loading %s: %s\n", sources[i].path.string().c_str(), lodepng_error_text(errors[i]));
+			images[i].assign(4, 255); // helyettesítő: egyetlen fehér pixel
+			regions[i].width = regions[i].height = 1;
+		}
+	}
+	if (!pack(images, maxSize, padding)) {
+		printf("Texture atlas: %d images do not fit into %dx%d\n", n, maxSize, maxSize);
+		regions.clear();
+		pixels.clear();
+		return false;
+	}
+	storeCache(key);
+	upload(sampling, flags);
+	printf("Texture atlas: %d images, %dx%dx%d\n", imageCount(), width, height, layers);
+	return true;
+}
+
+const char* const spriteVertexSource = R"(
+	#version 330
+	precision highp float;
+
+	layout(std140) uniform FrameConstants {
+		mat4 view;
+		mat4 projection;
+		mat4 viewProjection;
+		vec4 viewport;
+		float time;
+	};
+
+	layout(location = 0) in vec4 vtx;		// x, y, u, v
+	layout(location = 1) in float layer;
+	out vec3 texCoord;
+
+	void main() {
+		texCoord = vec3(vtx.zw, layer);
+		gl_Position = viewProjection * vec4(vtx.xy, 0, 1);
+	}
+)";
+
+const char* const spriteFragmentSource = R"(
+	#version 330
+	precision highp float;
+
+	uniform sampler2D atlas;
+	uniform vec3 color;
+	in vec3 texCoord;
+	out vec4 fragmentColor;
+
+	void main() {
+		fragmentColor = texture(atlas, texCoord.xy) * vec4(color, 1);
+	}
+)";
+
+const char* const spriteArrayFragmentSource = R"(
+	#version 330
+	precision highp float;
+
+	uniform sampler2DArray atlas;
+	uniform vec3 color;
+	in vec3 texCoord;
+	out vec4 fragmentColor;
+
+	void main() {
+		fragmentColor = texture(atlas, texCoord) * vec4(color, 1);
+	}
+)";
+
+SpriteBatch::SpriteBatch(TextureAtlas* _atlas) : atlas(_atlas) {
+	// A Geometry egyetlen, szorosan pakolt attribútumot állít be; itt kettő van, közös csúcspontban
+	Bind();
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, vtx));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, layer));
+}
+
+void SpriteBatch::add(int image, vec2 min, vec2 max) {
+	const AtlasRegion& r = atlas->region(image);
+	float layer = (float)r.layer;
+	// A kép felső sora (v = uvMin.y) kerül a négyszög tetejére
+	SpriteVertex tl = { vec4(min.x, max.y, r.uvMin.x, r.uvMin.y), layer }, tr = { vec4(max.x, max.y, r.uvMax.x, r.uvMin.y), layer };
+	SpriteVertex bl = { vec4(min.x, min.y, r.uvMin.x, r.uvMax.y), layer }, br = { vec4(max.x, min.y, r.uvMax.x, r.uvMax.y), layer };
+	vtx.push_back(tl); vtx.push_back(bl); vtx.push_back(tr);
+	vtx.push_back(tr); vtx.push_back(bl); vtx.push_back(br);
+}
+
+void SpriteBatch::Draw(GPUProgram* prog, int textureUnit, vec3 tint) {
+	if (vtx.empty()) return;
+	updateGPU();
+	atlas->Bind(textureUnit);
+	prog->setUniform(textureUnit, "atlas");
+	Geometry<SpriteVertex>::Draw(prog, GL_TRIANGLES, tint);
+}
@@ -0,0 +1,249 @@
+//=============================================================================================
+// BC1/BC3 kódoló és a tömörített textúrák lemezes gyorsítótára
+//=============================================================================================
+#include "texturecompress.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// Egy 4x4-es blokk RGBA-ban, a képen kívül eső pixelek helyén a szélső pixelekkel
+static void fetchBlock(const unsigned char* pixels, int width, int height, int channels, int bx, int by, unsigned char block[64]) {
+	for (int y = 0; y < 4; y++) {
+		int sy = by * 4 + y < height ? by * 4 + y : height - 1;
+		for (int x = 0; x < 4; x++) {
+			int sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+			const unsigned char* p = pixels + ((size_t)sy * width + sx) * channels;
+			unsigned char* b = block + (y * 4 + x) * 4;
+			b[0] = p[0]; b[1] = p[1]; b[2] = p[2];
+			b[3] = channels == 4 ? p[3] : 255;
+		}
+	}
+}
+
+static uint16_t pack565(const int c[3]) {
+	return (uint16_t)((((c[0] * 31 + 127) / 255) << 11) | (((c[1] * 63 + 127) / 255) << 5) | ((c[2] * 31 + 127) / 255));
+}
+
+static void unpack565(uint16_t v, int c[3]) {
+	int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+	c[0] = (r << 3) | (r >> 2);
+	c[1] = (g << 2) | (g >> 4);
+	c[2] = (b << 3) | (b >> 2);
+}
+
+static void put16(unsigned char* out, uint32_t v) { out[0] = v & 0xFF; out[1] = (v >> 8) & 0xFF; }
+
+// Színblokk: a végpontok a színek fő tengelyének két szélső pixele (kovariancia, hatványiteráció),
+// a pixelek a négy elemű paletta legközelebbi elemét kapják. Mindig a 4 színű módot használja (c0 > c1).
+static void encodeColorBlock(const unsigned char block[64], unsigned char out[8]) {
+	float mean[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++) for (int c = 0; c < 3; c++) mean[c] += block[i * 4 + c];
+	for (int c = 0; c < 3; c++) mean[c] /= 16;
+	float cov[6] = { 0, 0, 0, 0, 0, 0 }; // rr, rg, rb, gg, gb, bb
+	for (int i = 0; i < 16; i++) {
+		float r = block[i * 4] - mean[0], g = block[i * 4 + 1] - mean[1], b = block[i * 4 + 2] - mean[2];
+		cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+		cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+	}
+	float axis[3] = { 1, 1, 1 };
+	for (int iter = 0; iter < 4; iter++) {
+		float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+		float m = fabsf(x) > fabsf(y) ? fabsf(x) : fabsf(y);
+		if (fabsf(z) > m) m = fabsf(z);
+		if (m < 1e-6f) break; // egyszínű blokk
+		axis[0] = x / m; axis[1] = y / m; axis[2] = z / m;
+	}
+	int minIndex = 0, maxIndex = 0;
+	float minDot = 1e30f, maxDot = -1e30f;
+	for (int i = 0; i < 16; i++) {
+		float d = block[i * 4] * axis[0] + block[i * 4 + 1] * axis[1] + block[i * 4 + 2] * axis[2];
+		if (d < minDot) { minDot = d; minIndex = i; }
+		if (d > maxDot) { maxDot = d; maxIndex = i; }
+	}
+	int c0[3] = { block[maxIndex * 4], block[maxIndex * 4 + 1], block[maxIndex * 4 + 2] };
+	int c1[3] = { block[minIndex * 4], block[minIndex * 4 + 1], block[minIndex * 4 + 2] };
+	uint16_t v0 = pack565(c0), v1 = pack565(c1);
+	if (v0 < v1) { uint16_t t = v0; v0 = v1; v1 = t; }
+	put16(out, v0);
+	put16(out + 2, v1);
+	uint32_t indices = 0;
+	if (v0 != v1) {
+		int palette[4][3];
+		unpack565(v0, palette[0]);
+		unpack565(v1, palette[1]);
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		for (int i = 0; i < 16; i++) {
+			int best = 0, bestError = 1 << 30;
+			for (int p = 0; p < 4; p++) {
+				int dr = block[i * 4] - palette[p][0], dg = block[i * 4 + 1] - palette[p][1], db = block[i * 4 + 2] - palette[p][2];
+				int error = dr * dr + dg * dg + db * db;
+				if (error < bestError) { bestError = error; best = p; }
+			}
+			indices |= (uint32_t)best << (2 * i);
+		}
+	}
+	put16(out + 4, indices & 0xFFFF);
+	put16(out + 6, indices >> 16);
+}
+
+// Alfa blokk: a0 = max, a1 = min, 8 elemű paletta (a0 > a1), 3 bites indexek
+static void encodeAlphaBlock(const unsigned char block[64], unsigned char out[8]) {
+	int a0 = 0, a1 = 255;
+	for (int i = 0; i < 16; i++) {
+		int a = block[i * 4 + 3];
+		if (a > a0) a0 = a;
+		if (a < a1) a1 = a;
+	}
+	out[0] = (unsigned char)a0;
+	out[1] = (unsigned char)a1;
+	uint64_t indices = 0;
+	if (a0 != a1) {
+		int range = a0 - a1;
+		for (int i = 0; i < 16; i++) {
+			int t = ((block[i * 4 + 3] - a1) * 14 + range) / (2 * range); // 0: a1, 7: a0
+			uint64_t index = t == 7 ? 0 : t == 0 ? 1 : 8 - t;
+			indices |= index << (3 * i);
+		}
+	}
+	for (int i = 0; i < 6; i++) out[2 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+void compressBC1(const unsigned char* pixels, int width, int height, int channels, unsigned char* out) {
+	unsigned char block[64];
+	for (int by = 0; by < (height + 3) / 4; by++) {
+		for (int bx = 0; bx < (width + 3) / 4; bx++) {
+			fetchBlock(pixels, width, height, channels, bx, by, block);
+			encodeColorBlock(block, out);
+			out += 8;
+		}
+	}
+}
+
+void compressBC3(const unsigned char* pixels, int width, int height, unsigned char* out) {
+	unsigned char block[64];
+	for (int by = 0; by < (height + 3) / 4; by++) {
+		for (int bx = 0; bx < (width + 3) / 4; bx++) {
+			fetchBlock(pixels, width, height, 4, bx, by, block);
+			encodeAlphaBlock(block, out);
+			encodeColorBlock(block, out + 8);
+			out += 16;
+		}
+	}
+}
+
+std::vector<unsigned char> downsample(const unsigned char* pixels, int width, int height, int channels) {
+	int w = width > 1 ? width / 2 : 1, h = height > 1 ? height / 2 : 1;
+	std::vector<unsigned char> result((size_t)w * h * channels);
+	for (int y = 0; y < h; y++) {
+		int y0 = 2 * y < height ? 2 * y : height - 1, y1 = 2 * y + 1 < height ? 2 * y + 1 : height - 1;
+		for (int x = 0; x < w; x++) {
+			int x0 = 2 * x < width ? 2 * x : width - 1, x1 = 2 * x + 1 < width ? 2 * x + 1 : width - 1;
+			for (int c = 0; c < channels; c++) {
+				int sum = pixels[((size_t)y0 * width + x0) * channels + c] + pixels[((size_t)y0 * width + x1) * channels + c]
+					+ pixels[((size_t)y1 * width + x0) * channels + c] + pixels[((size_t)y1 * width + x1) * channels + c];
+				result[((size_t)y * w + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+	return result;
+}
+
+void compressImage(const unsigned char* pixels, int width, int height, int channels, bool alpha, bool mipmaps, CompressedImage& image) {
+	if (alpha && channels != 4) alpha = false; // nincs mit megőrizni
+	image.format = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	image.width = width;
+	image.height = height;
+	image.levels.clear();
+	size_t blockBytes = alpha ? 16 : 8;
+	std::vector<unsigned char> level;
+	const unsigned char* source = pixels;
+	for (int w = width, h = height; ; ) {
+		std::vector<unsigned char> blocks((size_t)((w + 3) / 4) * ((h + 3) / 4) * blockBytes);
+		if (alpha) compressBC3(source, w, h, blocks.data());
+		else compressBC1(source, w, h, channels, blocks.data());
+		image.levels.push_back(std::move(blocks));
+		if (!mipmaps || (w == 1 && h == 1)) break;
+		level = downsample(source, w, h, channels);
+		source = level.data();
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+	}
+}
+
+uint64_t CompressedTextureCache::key(const std::filesystem::path& file, bool alpha, bool mipmaps) {
+	std::error_code ec;
+	std::filesystem::path canonical = std::filesystem::weakly_canonical(file, ec);
+	std::string id = (ec ? file : canonical).string();
+	uintmax_t size = std::filesystem::file_size(file, ec);
+	long long time = (long long)std::filesystem::last_write_time(file, ec).time_since_epoch().count();
+	char params[96];
+	snprintf(params, sizeof(params), "|%llu|%lld|%d|%d|1", (unsigned long long)size, time, alpha ? 1 : 0, mipmaps ? 1 : 0); // az utolsó szám a kódoló verziója
+	id += params;
+	uint64_t h = 0xcbf29ce484222325ULL; // FNV-1a
+	for (unsigned char c : id) {
+		h ^= c;
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static std::filesystem::path cacheFileName(const std::filesystem::path& directory, uint64_t key) {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.gtc", (unsigned long long)key);
+	return directory / name;
+}
+
+bool CompressedTextureCache::load(uint64_t key, CompressedImage& image) {
+	if (!enabled) return false;
+	std::filesystem::path path = cacheFileName(directory, key);
+	FILE* file = fopen(path.string().c_str(), "rb");
+	if (!file) return false;
+	uint32_t header[5] = { 0, 0, 0, 0, 0 }; // magic, format, width, height, szintek
+	bool ok = fread(header, sizeof(header), 1, file) == 1 && header[0] == magic && header[4] > 0 && header[4] <= 32;
+	if (ok) {
+		image.format = header[1];
+		image.width = (int)header[2];
+		image.height = (int)header[3];
+		image.levels.resize(header[4]);
+		for (auto& level : image.levels) {
+			uint32_t size = 0;
+			ok = fread(&size, sizeof(size), 1, file) == 1 && size > 0 && size <= (1u << 30);
+			if (!ok) break;
+			level.resize(size);
+			ok = fread(level.data(), 1, size, file) == size;
+			if (!ok) break;
+		}
+	}
+	fclose(file);
+	if (!ok) {
+		image.levels.clear();
+		std::error_code ec;
+		std::filesystem::remove(path, ec); // sérült bejegyzés, a következő tömörítés felülírja
+	}
+	return ok;
+}
+
+void CompressedTextureCache::store(uint64_t key, const CompressedImage& image) {
+	if (!enabled || image.levels.empty()) return;
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+	std::filesystem::path path = cacheFileName(directory, key);
+	std::filesystem::path tmp = path;
+	tmp += ".tmp";
+	FILE* file = fopen(tmp.string().c_str(), "wb");
+	if (!file) return;
+	uint32_t header[5] = { magic, (uint32_t)image.format, (uint32_t)image.width, (uint32_t)image.height, (uint32_t)image.levels.size() };
+	bool ok = fwrite(header, sizeof(header), 1, file) == 1;
+	for (const auto& level : image.levels) {
+		uint32_t size = (uint32_t)level.size();
+		ok = ok && fwrite(&size, sizeof(size), 1, file) == 1 && fwrite(level.data(), 1, size, file) == size;
+	}
+	fclose(file);
+	if (ok) std::filesystem::rename(tmp, path, ec); // több szál vagy példány se lásson félkész fájlt
+	else std::filesystem::remove(tmp, ec);
+}
@@ -0,0 +1,178 @@
+//=============================================================================================
+// Aszinkron textúra betöltés
+//=============================================================================================
+#include "textureloader.h"
+#include <string.h>
+
+std::shared_ptr<Texture> TextureLoader::load(const fs::path& path, bool transparent, int sampling, int flags) {
+	std::shared_ptr<Job> job = std::make_shared<Job>();
+	job->texture.reset(new Texture()); // helyettesítő
+	job->path = path;
+	job->transparent = transparent;
+	job->sampling = sampling;
+	job->flags = flags;
+	job->compress = flags & TEXTURE_COMPRESSED && glExt.textureCompressionS3TC; // a GL-t csak itt kérdezhetjük
+	if (!decoders) decoders.reset(new ThreadPool());
+	pending++;
+	decoders->submit([this, job]() {
+		decode(*job);
+		std::lock_guard<std::mutex> lock(mutex);
+		decoded.push_back(job);
+	});
+	return job->texture;
+}
+
+void TextureLoader::decode(Job& job) {
+	TRACE_SCOPE("TextureLoader::decode");
+	uint64_t key = 0;
+	if (job.compress) {
+		key = CompressedTextureCache::key(job.path, job.transparent, job.flags & TEXTURE_MIPMAPS);
+		if (CompressedTextureCache::load(key, job.compressed)) return; // nem kell dekódolni
+	}
+	if (job.transparent) {
+		job.error = lodepng_decode_file_mapped(&job.pixels, &job.width, &job.height, job.path.string().c_str(), LCT_RGBA, 8);
+		if (!job.error) Texture::alphaFromLuminance(job.pixels, (size_t)job.width * job.height);
+	}
+	else {
+		job.error = lodepng_decode_file_mapped(&job.pixels, &job.width, &job.height, job.path.string().c_str(), LCT_RGB, 8);
+	}
+	if (job.compress && !job.error) {
+		compressImage(job.pixels, job.width, job.height, job.transparent ? 4 : 3, job.transparent, job.flags & TEXTURE_MIPMAPS, job.compressed);
+		CompressedTextureCache::store(key, job.compressed);
+		free(job.pixels);
+		job.pixels = nullptr;
+	}
+}
+
+void* TextureLoader::stage(size_t bytes) {
+	if (!pbo) glGenBuffers(1, &pbo);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW); // orphaning: nem várunk az előző adagra
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (!mapped) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); // közvetlen feltöltés marad
+	return mapped;
+}
+
+bool TextureLoader::uploadLevel(Job& job, size_t& budget) {
+	Texture& texture = *job.texture;
+	const CompressedImage& image = job.compressed;
+	glBindTexture(GL_TEXTURE_2D, texture.textureId);
+	// Egy szint nem osztható fel, így egy lépésben legalább egy szint megy
+	while (job.uploadedLevels < image.levels.size() && budget > 0) {
+		size_t level = job.uploadedLevels;
+		int w = image.width >> level, h = image.height >> level;
+		if (w < 1) w = 1;
+		if (h < 1) h = 1;
+		const std::vector<unsigned char>& data = image.levels[level];
+		void* mapped = stage(data.size());
+		if (mapped) {
+			memcpy(mapped, data.data(), data.size());
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, image.format, w, h, 0, (GLsizei)data.size(), mapped ? nullptr : data.data());
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		job.uploadedLevels++;
+		budget = data.size() < budget ? budget - data.size() : 0;
+	}
+	if (job.uploadedLevels < image.levels.size()) return false;
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+	texture.width = image.width;
+	texture.height = image.height;
+	texture.memory = image.bytes();
+	texture.mipmapped = image.levels.size() > 1;
+	texture.setFilters(job.sampling, job.sampling);
+	texture.ready = true;
+	printf("%s, w: %d, h: %d\n", job.path.string().c_str(), texture.width, texture.height);
+	return true;
+}
+
+bool TextureLoader::upload(Job& job, size_t& budget) {
+	if (job.compress) return uploadLevel(job, budget);
+	Texture& texture = *job.texture;
+	GLenum format = job.transparent ? GL_RGBA : GL_RGB;
+	size_t rowBytes = (size_t)job.width * (job.transparent ? 4 : 3);
+	glBindTexture(GL_TEXTURE_2D, texture.textureId);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	if (job.uploadedRows == 0) { // tároló lefoglalása a végleges méretre, a tartalom adagokban jön
+		glTexImage2D(GL_TEXTURE_2D, 0, job.transparent ? GL_RGBA8 : GL_RGB8, job.width, job.height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+	}
+	// Legalább egy sor, hogy a keretnél nagyobb sorok is haladjanak
+	unsigned int rows = (unsigned int)(budget / rowBytes);
+	if (rows == 0) rows = 1;
+	if (rows > job.height - job.uploadedRows) rows = job.height - job.uploadedRows;
+	size_t bytes = rows * rowBytes;
+
+	void* mapped = stage(bytes);
+	if (mapped) {
+		memcpy(mapped, job.pixels + job.uploadedRows * rowBytes, bytes);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, job.uploadedRows, job.width, rows, format, GL_UNSIGNED_BYTE, nullptr); // a PBO-ból
+	}
+	else { // a PBO nem érhető el: közvetlen feltöltés
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, job.uploadedRows, job.width, rows, format, GL_UNSIGNED_BYTE, job.pixels + job.uploadedRows * rowBytes);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	job.uploadedRows += rows;
+	budget = bytes < budget ? budget - bytes : 0;
+	if (job.uploadedRows < job.height) return false;
+
+	texture.width = job.width;
+	texture.height = job.height;
+	texture.memory = (size_t)job.width * job.height * 4;
+	texture.mipmapped = job.flags & TEXTURE_MIPMAPS;
+	if (texture.mipmapped) {
+		glGenerateMipmap(GL_TEXTURE_2D);
+		texture.memory += texture.memory / 3;
+	}
+	texture.setFilters(job.sampling, job.sampling);
+	texture.ready = true;
+	printf("%s, w: %d, h: %d\n", job.path.string().c_str(), texture.width, texture.height);
+	return true;
+}
+
+int TextureLoader::update() {
+	if (pending == 0) return 0;
+	TRACE_SCOPE("TextureLoader::update");
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		while (!decoded.empty()) {
+			uploading.push_back(std::move(decoded.front()));
+			decoded.pop_front();
+		}
+	}
+	int completed = 0;
+	size_t budget = uploadBudget;
+	while (!uploading.empty() && budget > 0) {
+		Job& job = *uploading.front();
+		if (job.error) { // a helyettesítő marad
+			printf("Error while loading %s: %s\n", job.path.string().c_str(), lodepng_error_text(job.error));
+			job.texture->failed = true;
+		}
+		else if (job.texture.use_count() == 1) {
+			// Senki nem tartja már a textúrát: a feltöltés felesleges
+		}
+		else if (!upload(job, budget)) {
+			break; // a keret elfogyott, a következő képkocka folytatja
+		}
+		else {
+			completed++;
+		}
+		uploading.pop_front();
+		pending--;
+	}
+	return completed;
+}
+
+void TextureLoader::finish() {
+	if (decoders) decoders->wait();
+	size_t budget = uploadBudget;
+	uploadBudget = (size_t)-1;
+	while (pending > 0) update();
+	uploadBudget = budget;
+}
+
+TextureLoader::~TextureLoader() {
+	decoders.reset(); // a dekódolók leállítása, mielőtt a sorok megszűnnek
+}
@@ -0,0 +1,62 @@
+//=============================================================================================
+// Textúra gyorsítótár
+//=============================================================================================
+#include "texturemanager.h"
+#include "textureloader.h"
+
+std::string TextureManager::makeKey(const fs::path& path, bool transparent, int sampling, int flags) {
+	std::error_code ec;
+	fs::path canonical = fs::weakly_canonical(path, ec);
+	return (ec ? path : canonical).string() + (transparent ? "|a|" : "|o|") + std::to_string(sampling) + "|" + std::to_string(flags);
+}
+
+std::shared_ptr<Texture> TextureManager::get(const fs::path& path, bool transparent, int sampling, int flags) {
+	std::string key = makeKey(path, transparent, sampling, flags);
+	auto found = index.find(key);
+	if (found != index.end() && found->second->texture->loadFailed()) {
+		// A sikertelen betöltés helyettesítője nem marad a tárban: a fájl azóta javulhatott
+		entries.erase(found->second);
+		index.erase(found);
+		found = index.end();
+	}
+	if (found != index.end()) {
+		hits++;
+		entries.splice(entries.begin(), entries, found->second); // a lista elejére
+		return found->second->texture;
+	}
+	misses++;
+	std::shared_ptr<Texture> texture = async ? textureLoader().load(path, transparent, sampling, flags)
+		: std::make_shared<Texture>(path, transparent, sampling, flags);
+	entries.push_front({ key, texture });
+	index[key] = entries.begin();
+	trim();
+	return texture;
+}
+
+size_t TextureManager::residentBytes() const {
+	size_t bytes = 0;
+	for (const Entry& entry : entries) bytes += entry.texture->gpuBytes();
+	return bytes;
+}
+
+void TextureManager::trim() {
+	size_t bytes = residentBytes();
+	for (auto it = entries.end(); bytes > budget && it != entries.begin(); ) {
+		--it;
+		if (it->texture.use_count() > 1) continue; // használatban van
+		bytes -= it->texture->gpuBytes();
+		index.erase(it->key);
+		it = entries.erase(it);
+	}
+}
+
+void TextureManager::clear() {
+	for (auto it = entries.begin(); it != entries.end(); ) {
+		if (it->texture.use_count() > 1) {
+			++it;
+			continue;
+		}
+		index.erase(it->key);
+		it = entries.erase(it);
+	}
+}
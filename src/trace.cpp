@@ -0,0 +1,73 @@
+//=============================================================================================
+// CPU profilozás: szálankénti gyűrűbufferek és chrome://tracing JSON kiírás
+//=============================================================================================
+#include "trace.h"
+
+#ifdef ENABLE_TRACING
+#include <mutex>
+#include <vector>
+#include <stdio.h>
+
+static std::mutex registryMutex;				// csak regisztrációkor és kiíráskor kell
+static std::vector<TraceBuffer*> registry;		// a bufferek a program végéig élnek
+static const std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+
+uint64_t traceNow() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceEpoch).count();
+}
+
+TraceBuffer& traceThreadBuffer() {
+	thread_local TraceBuffer* buffer = nullptr;
+	if (!buffer) {
+		buffer = new TraceBuffer();
+		std::lock_guard<std::mutex> lock(registryMutex);
+		buffer->threadId = (unsigned int)registry.size() + 1;
+		registry.push_back(buffer);
+	}
+	return *buffer;
+}
+
+static void writeJsonString(FILE* file, const char* s) {
+	fputc('"', file);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\') fputc('\\', file);
+		if ((unsigned char)*s >= 0x20) fputc(*s, file);
+	}
+	fputc('"', file);
+}
+
+bool traceDump(const char* fileName) {
+	FILE* file = fopen(fileName, "w");
+	if (!file) {
+		printf("Error while opening trace file %s!\n", fileName);
+		return false;
+	}
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for (TraceBuffer* buffer : registry) {
+		// Másolat a gyűrűről, utána eldobjuk azt, amit az író szál közben felülírhatott
+		uint64_t end = buffer->written.load(std::memory_order_acquire);
+		uint64_t begin = end > TraceBuffer::capacity ? end - TraceBuffer::capacity : 0;
+		std::vector<TraceEvent> events;
+		events.reserve((size_t)(end - begin));
+		for (uint64_t i = begin; i < end; i++) events.push_back(buffer->events[i & (TraceBuffer::capacity - 1)]);
+		uint64_t after = buffer->written.load(std::memory_order_acquire);
+		uint64_t valid = after > TraceBuffer::capacity ? after - TraceBuffer::capacity : 0;
+		for (uint64_t i = begin; i < end; i++) {
+			if (i < valid) continue;
+			const TraceEvent& e = events[(size_t)(i - begin)];
+			fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+			writeJsonString(file, e.name);
+			fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				buffer->threadId, e.beginNs / 1000.0, (e.endNs - e.beginNs) / 1000.0);
+			first = false;
+		}
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	printf("Trace written to %s\n", fileName);
+	return true;
+}
+
+#endif